@@ -0,0 +1,179 @@
+/* Stored performance baselines and the regression gate for sor_bench.c.
+
+   A baseline file is CSV, one row per (machine, kernel, size, threads):
+
+     machine,kernel,size,threads,median_s,stddev_s,iters,residual
+
+   "machine" is hostname/CPU model/core count, so one file can be shared
+   by several hosts and each only compares against its own rows. Saving
+   replaces the rows of the current machine that were re-measured and
+   keeps everything else.
+
+   A result regresses when its median is slower than the baseline by more
+   than max(min_pct, k * combined relative stddev): on a noisy host the
+   bar rises with the measured noise instead of flagging every jitter.
+
+   Header-only; include from one .c file.
+*/
+
+#ifndef _BENCH_BASELINE_H_
+#define _BENCH_BASELINE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#define BASELINE_HEADER "machine,kernel,size,threads,median_s,stddev_s,iters,residual"
+
+typedef struct {
+    char machine[160];
+    char kernel[64];
+    long int size;
+    int threads;
+    double median;       /* seconds */
+    double stddev;
+    int iters;
+    double residual;
+} baseline_rec;
+
+typedef struct {
+    baseline_rec *rec;
+    int n, cap;
+} baseline_set;
+
+/* hostname/cpu model/ncpu, with commas removed so it stays one CSV field */
+void baseline_machine_key(char *buf, size_t len)
+{
+    char host[64] = "unknown", model[96] = "unknown", line[256];
+    FILE *fp;
+
+    gethostname(host, sizeof(host) - 1);
+    if ((fp = fopen("/proc/cpuinfo", "r"))) {
+        while (fgets(line, sizeof(line), fp)) {
+            char *colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) == 0 && colon) {
+                snprintf(model, sizeof(model), "%s", colon + 2);
+                model[strcspn(model, "\n")] = '\0';
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    snprintf(buf, len, "%s/%s/%ldcpu", host, model, sysconf(_SC_NPROCESSORS_ONLN));
+    for (char *p = buf; *p; p++) {
+        if (*p == ',') *p = ' ';
+    }
+}
+
+/* A missing file is an empty set when saving (must_exist = 0), so the
+   first -S run can create it, and an error when gating: a mistyped path
+   must not turn the gate off. */
+int baseline_load(baseline_set *b, const char *path, int must_exist)
+{
+    char line[512];
+    baseline_rec r;
+    FILE *fp;
+
+    b->rec = NULL;
+    b->n = b->cap = 0;
+    if (!(fp = fopen(path, "r"))) {
+        if (!must_exist) return 1;
+        fprintf(stderr, "baseline: cannot open %s\n", path);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "machine,", 8) == 0) continue;
+        if (sscanf(line, "%159[^,],%63[^,],%ld,%d,%lf,%lf,%d,%lf",
+                   r.machine, r.kernel, &r.size, &r.threads, &r.median,
+                   &r.stddev, &r.iters, &r.residual) != 8) {
+            fprintf(stderr, "baseline: skipping malformed line in %s\n", path);
+            continue;
+        }
+        if (b->n == b->cap) {
+            b->cap = b->cap ? 2 * b->cap : 64;
+            b->rec = (baseline_rec *)realloc(b->rec, b->cap * sizeof(baseline_rec));
+            if (!b->rec) {
+                fclose(fp);
+                return 0;
+            }
+        }
+        b->rec[b->n++] = r;
+    }
+    fclose(fp);
+    return 1;
+}
+
+baseline_rec *baseline_find(baseline_set *b, const char *machine,
+                            const char *kernel, long int size, int threads)
+{
+    for (int i = 0; i < b->n; i++) {
+        baseline_rec *r = &b->rec[i];
+        if (r->size == size && r->threads == threads &&
+            strcmp(r->kernel, kernel) == 0 && strcmp(r->machine, machine) == 0)
+            return r;
+    }
+    return NULL;
+}
+
+/* Replace the matching row, or append */
+void baseline_put(baseline_set *b, const baseline_rec *r)
+{
+    baseline_rec *old = baseline_find(b, r->machine, r->kernel, r->size, r->threads);
+
+    if (old) {
+        *old = *r;
+        return;
+    }
+    if (b->n == b->cap) {
+        b->cap = b->cap ? 2 * b->cap : 64;
+        b->rec = (baseline_rec *)realloc(b->rec, b->cap * sizeof(baseline_rec));
+        if (!b->rec) {
+            fprintf(stderr, "baseline: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    b->rec[b->n++] = *r;
+}
+
+int baseline_save(const baseline_set *b, const char *path)
+{
+    FILE *fp = fopen(path, "w");
+
+    if (!fp) {
+        fprintf(stderr, "baseline: cannot open %s for writing\n", path);
+        return 0;
+    }
+    fprintf(fp, "%s\n", BASELINE_HEADER);
+    for (int i = 0; i < b->n; i++) {
+        const baseline_rec *r = &b->rec[i];
+        fprintf(fp, "%s,%s,%ld,%d,%.9e,%.9e,%d,%.9e\n", r->machine, r->kernel,
+                r->size, r->threads, r->median, r->stddev, r->iters, r->residual);
+    }
+    fclose(fp);
+    return 1;
+}
+
+void baseline_free(baseline_set *b)
+{
+    free(b->rec);
+    b->rec = NULL;
+    b->n = b->cap = 0;
+}
+
+/* Returns 1 if now is a regression against base. *slowdown and *limit
+   get the relative slowdown and the noise-aware threshold (fractions). */
+int baseline_regressed(const baseline_rec *base, const baseline_rec *now,
+                       double min_pct, double k, double *slowdown, double *limit)
+{
+    double rb = base->median > 0 ? base->stddev / base->median : 0.0;
+    double rn = now->median > 0 ? now->stddev / now->median : 0.0;
+    double noise = k * sqrt(rb * rb + rn * rn);
+
+    *slowdown = base->median > 0 ? now->median / base->median - 1.0 : 0.0;
+    *limit = (noise > min_pct / 100.0) ? noise : min_pct / 100.0;
+    return *slowdown > *limit;
+}
+
+#endif /* _BENCH_BASELINE_H_ */
@@ -0,0 +1,266 @@
+/* Shared benchmark timing harness for the SOR / pthreads test drivers.
+
+   A single clock_gettime(CLOCK_REALTIME) pair around one run is too noisy
+   to compare optimizations whose effect is a few percent, so every driver
+   times its kernels through bench_run() instead:
+
+     - CLOCK_MONOTONIC wall time (immune to NTP / settimeofday steps)
+     - TSC cycle counts, with the TSC rate calibrated against the
+       monotonic clock (replaces the hand-edited CPNS constant)
+     - a configurable number of untimed warmup runs followed by a number
+       of timed repeats
+     - median / min / mean / stddev over the repeats, after rejecting
+       samples more than outlier_k scaled MADs away from the median
+
+   Results can be written as CSV or JSON rows with a fixed schema that
+   plots/part1.py .. plots/part3.py read directly.
+
+   The configuration comes from the environment so existing drivers keep
+   their argument-less command lines:
+
+     BENCH_WARMUP=n     untimed runs per measurement     (default 1)
+     BENCH_REPEATS=n    timed runs per measurement       (default 5)
+     BENCH_OUTLIER_K=x  MAD multiple for rejection, 0=off (default 3.0)
+     BENCH_CSV=path     also write results as CSV
+     BENCH_JSON=path    also write results as JSON
+
+   Like apple_pthread_barrier.h this is a header-only module; include it
+   from exactly one translation unit (every driver here is a single file).
+*/
+
+#ifndef _BENCH_HARNESS_H_
+#define _BENCH_HARNESS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+#define BENCH_MAX_REPEATS 1000
+
+typedef struct {
+    int warmup;          /* untimed runs before measuring */
+    int repeats;         /* timed runs */
+    double outlier_k;    /* reject |x - median| > k * 1.4826 * MAD; 0 = off */
+} bench_cfg;
+
+typedef struct {
+    int samples;         /* timed runs kept after outlier rejection */
+    int rejected;        /* timed runs dropped as outliers */
+    double median;       /* seconds */
+    double min;
+    double mean;
+    double stddev;
+    double cycles;       /* median run length in calibrated TSC cycles */
+} bench_stats;
+
+typedef enum { BENCH_FMT_CSV, BENCH_FMT_JSON } bench_fmt;
+
+typedef struct {
+    FILE *fp;
+    bench_fmt fmt;
+    int rows;
+} bench_out;
+
+/* Monotonic wall clock in seconds */
+double bench_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1.0e-9;
+}
+
+/* Raw cycle counter; falls back to monotonic nanoseconds without a TSC */
+uint64_t bench_cycles(void)
+{
+#if BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+#endif
+}
+
+/* Cycles per nanosecond of bench_cycles(), measured once against
+   CLOCK_MONOTONIC over ~50 ms and cached. Drop-in for CPNS. */
+double bench_cpns(void)
+{
+    static double cpns = 0.0;
+    if (cpns == 0.0) {
+        double t0 = bench_now(), t1;
+        uint64_t c0 = bench_cycles(), c1;
+        do {
+            t1 = bench_now();
+        } while (t1 - t0 < 0.05);
+        c1 = bench_cycles();
+        cpns = (double)(c1 - c0) / ((t1 - t0) * 1.0e9);
+    }
+    return cpns;
+}
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double bench_median_sorted(const double *s, int n)
+{
+    return (n & 1) ? s[n / 2] : 0.5 * (s[n / 2 - 1] + s[n / 2]);
+}
+
+/* Summarize n samples (seconds). The array is sorted in place. */
+void bench_summarize(double *s, int n, double outlier_k, bench_stats *st)
+{
+    double dev[BENCH_MAX_REPEATS];
+    double med, mad, sum = 0.0, sq = 0.0;
+    int i, lo = 0, hi = n;
+
+    memset(st, 0, sizeof(*st));
+    if (n <= 0) return;
+    qsort(s, n, sizeof(double), bench_cmp_double);
+    med = bench_median_sorted(s, n);
+
+    /* Samples are sorted, so the kept set is a contiguous range. */
+    if (outlier_k > 0.0 && n >= 3) {
+        for (i = 0; i < n; i++) dev[i] = fabs(s[i] - med);
+        qsort(dev, n, sizeof(double), bench_cmp_double);
+        mad = 1.4826 * bench_median_sorted(dev, n);
+        if (mad > 0.0) {
+            while (lo < n && med - s[lo] > outlier_k * mad) lo++;
+            while (hi > lo && s[hi - 1] - med > outlier_k * mad) hi--;
+        }
+    }
+
+    for (i = lo; i < hi; i++) {
+        sum += s[i];
+        sq += s[i] * s[i];
+    }
+    st->samples = hi - lo;
+    st->rejected = n - st->samples;
+    st->median = bench_median_sorted(s + lo, hi - lo);
+    st->min = s[lo];
+    st->mean = sum / st->samples;
+    st->stddev = st->samples > 1
+        ? sqrt(fmax(0.0, (sq - sum * st->mean) / (st->samples - 1))) : 0.0;
+    st->cycles = st->median * 1.0e9 * bench_cpns();
+}
+
+static int bench_env_int(const char *name, int dflt)
+{
+    const char *s = getenv(name);
+    return (s && *s) ? atoi(s) : dflt;
+}
+
+/* Default configuration, overridable through BENCH_* variables */
+bench_cfg bench_cfg_from_env(void)
+{
+    bench_cfg cfg;
+    const char *k = getenv("BENCH_OUTLIER_K");
+
+    cfg.warmup = bench_env_int("BENCH_WARMUP", 1);
+    cfg.repeats = bench_env_int("BENCH_REPEATS", 5);
+    cfg.outlier_k = (k && *k) ? atof(k) : 3.0;
+    if (cfg.warmup < 0) cfg.warmup = 0;
+    if (cfg.repeats < 1) cfg.repeats = 1;
+    if (cfg.repeats > BENCH_MAX_REPEATS) cfg.repeats = BENCH_MAX_REPEATS;
+    return cfg;
+}
+
+/* Time run(arg) cfg->repeats times after cfg->warmup untimed calls.
+   setup(arg), if non-NULL, runs untimed before every call so kernels that
+   overwrite their input (every SOR variant) start from the same state. */
+void bench_run(const bench_cfg *cfg, void (*setup)(void *),
+               void (*run)(void *), void *arg, bench_stats *st)
+{
+    double samples[BENCH_MAX_REPEATS];
+    double t0;
+    int r;
+
+    for (r = 0; r < cfg->warmup; r++) {
+        if (setup) setup(arg);
+        run(arg);
+    }
+    for (r = 0; r < cfg->repeats; r++) {
+        if (setup) setup(arg);
+        t0 = bench_now();
+        run(arg);
+        samples[r] = bench_now() - t0;
+    }
+    bench_summarize(samples, cfg->repeats, cfg->outlier_k, st);
+}
+
+/************************************/
+/* CSV / JSON result output */
+
+/* Column order shared by every driver and by plots/part*.py */
+#define BENCH_CSV_HEADER \
+    "kernel,size,threads,omega,iters,median_s,min_s,mean_s,stddev_s," \
+    "samples,rejected,median_cycles"
+
+int bench_out_open(bench_out *o, const char *path, bench_fmt fmt)
+{
+    o->fp = NULL;
+    o->fmt = fmt;
+    o->rows = 0;
+    if (!path || !*path) return 0;
+    o->fp = fopen(path, "w");
+    if (!o->fp) {
+        fprintf(stderr, "bench: cannot open %s for writing\n", path);
+        return 0;
+    }
+    if (fmt == BENCH_FMT_CSV)
+        fprintf(o->fp, "%s\n", BENCH_CSV_HEADER);
+    else
+        fprintf(o->fp, "[\n");
+    return 1;
+}
+
+void bench_out_row(bench_out *o, const char *kernel, long size, int threads,
+                   double omega, double iters, const bench_stats *st)
+{
+    if (!o->fp) return;
+    if (o->fmt == BENCH_FMT_CSV) {
+        fprintf(o->fp, "%s,%ld,%d,%.4f,%.1f,%.9e,%.9e,%.9e,%.9e,%d,%d,%.6e\n",
+                kernel, size, threads, omega, iters, st->median, st->min,
+                st->mean, st->stddev, st->samples, st->rejected, st->cycles);
+    } else {
+        fprintf(o->fp,
+                "%s  {\"kernel\": \"%s\", \"size\": %ld, \"threads\": %d, "
+                "\"omega\": %.4f, \"iters\": %.1f, \"median_s\": %.9e, "
+                "\"min_s\": %.9e, \"mean_s\": %.9e, \"stddev_s\": %.9e, "
+                "\"samples\": %d, \"rejected\": %d, \"median_cycles\": %.6e}",
+                o->rows ? ",\n" : "", kernel, size, threads, omega, iters,
+                st->median, st->min, st->mean, st->stddev, st->samples,
+                st->rejected, st->cycles);
+    }
+    o->rows++;
+}
+
+void bench_out_close(bench_out *o)
+{
+    if (!o->fp) return;
+    if (o->fmt == BENCH_FMT_JSON)
+        fprintf(o->fp, "\n]\n");
+    fclose(o->fp);
+    o->fp = NULL;
+}
+
+/* Opens whichever of BENCH_CSV / BENCH_JSON are set */
+void bench_out_from_env(bench_out *csv, bench_out *json)
+{
+    bench_out_open(csv, getenv("BENCH_CSV"), BENCH_FMT_CSV);
+    bench_out_open(json, getenv("BENCH_JSON"), BENCH_FMT_JSON);
+}
+
+#endif /* _BENCH_HARNESS_H_ */
@@ -0,0 +1,109 @@
+/* Host cache sizes and core counts, for drivers that size their grids by
+   cache level instead of by hard-coded row lengths.
+
+     cache_info_probe()   L1d, L2 and L3 bytes, logical CPUs online and
+                          physical cores (logical CPUs that are the first
+                          of their SMT sibling list)
+
+   Sizes come from sysconf(_SC_LEVEL*_CACHE_SIZE) where glibc knows them,
+   else from /sys/devices/system/cpu/cpu0/cache, else CACHE_DEFAULT_*. A
+   missing L3 is taken to be the L2, so a "DRAM" grid sized from it still
+   misses every level.
+
+   Header-only; include from one .c file.
+*/
+
+#ifndef _CACHE_INFO_H_
+#define _CACHE_INFO_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CACHE_DEFAULT_L1 (32L * 1024)
+#define CACHE_DEFAULT_L2 (1024L * 1024)
+#define CACHE_DEFAULT_L3 (8L * 1024 * 1024)
+
+typedef struct {
+    long int l1, l2, l3;        /* data / unified cache bytes per level */
+    int cpus;                   /* logical CPUs online, SMT siblings included */
+    int cores;                  /* physical cores among them */
+} cache_info;
+
+/* Bytes of cpu0's level `level` data or unified cache from sysfs; 0 if absent */
+static long int cache_sysfs_size(int level)
+{
+    char path[96], buf[32];
+    long int size = 0;
+
+    for (int idx = 0; idx < 8; idx++) {
+        FILE *fp;
+        int lv = 0;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", idx);
+        if (!(fp = fopen(path, "r"))) break;
+        if (fscanf(fp, "%d", &lv) != 1) lv = 0;
+        fclose(fp);
+        if (lv != level) continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", idx);
+        if (!(fp = fopen(path, "r"))) continue;
+        if (!fgets(buf, sizeof(buf), fp)) buf[0] = 0;
+        fclose(fp);
+        if (strncmp(buf, "Instruction", 11) == 0) continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", idx);
+        if (!(fp = fopen(path, "r"))) continue;
+        if (fscanf(fp, "%ld%31s", &size, buf) < 1) size = 0;
+        else if (buf[0] == 'K') size *= 1024;
+        else if (buf[0] == 'M') size *= 1024 * 1024;
+        fclose(fp);
+        break;
+    }
+    return size;
+}
+
+/* Logical CPUs that head their thread_siblings_list; 0 if unknown */
+static int cache_sysfs_cores(int cpus)
+{
+    int cores = 0;
+
+    for (int c = 0; c < cpus; c++) {
+        char path[96];
+        FILE *fp;
+        int first;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+        if (!(fp = fopen(path, "r"))) return 0;
+        if (fscanf(fp, "%d", &first) != 1) first = -1;
+        fclose(fp);
+        if (first == c) cores++;
+    }
+    return cores;
+}
+
+void cache_info_probe(cache_info *ci)
+{
+    long int sz[4] = {0, 0, 0, 0};
+    long int dflt[4] = {0, CACHE_DEFAULT_L1, CACHE_DEFAULT_L2, CACHE_DEFAULT_L3};
+
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    sz[1] = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    sz[2] = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    sz[3] = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    for (int l = 1; l <= 3; l++) {
+        if (sz[l] <= 0) sz[l] = cache_sysfs_size(l);
+        if (sz[l] <= 0) sz[l] = (l == 3 && sz[2] > 0) ? sz[2] : dflt[l];
+    }
+    ci->l1 = sz[1];
+    ci->l2 = sz[2];
+    ci->l3 = sz[3];
+    ci->cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ci->cpus < 1) ci->cpus = 1;
+    ci->cores = cache_sysfs_cores(ci->cpus);
+    if (ci->cores < 1 || ci->cores > ci->cpus) ci->cores = ci->cpus;
+}
+
+#endif /* _CACHE_INFO_H_ */
@@ -0,0 +1,77 @@
+/* Runtime CPU-feature dispatch for the hot kernels.
+
+   The build lines carry no -march, so without this every kernel is
+   compiled for baseline x86-64 (SSE2). KERNEL_CLONES marks a function
+   for GCC/clang function multiversioning: the compiler emits a default
+   (scalar SSE2), an SSE4.2, an AVX2 and an AVX-512 body, and an ifunc
+   resolver picks one from cpuid when the program is loaded. Callers,
+   function pointers (pthread workers) and the build line are unchanged.
+
+   Only x86-64 Linux has the ifunc support this needs. Elsewhere, or
+   when built with -DNO_KERNEL_CLONES, KERNEL_CLONES expands to nothing
+   and there is only the default body.
+
+   Cloned: every sweep loop, meaning the serial kernels, SOR_residual()
+   and the pthread workers in sor.h, sor_mt.h, sor_ctx.h, sor_line.h and
+   sor_sparse.h. Also SOR_batch(), Jacobi_row(), the SOR3d*() kernels
+   and the slab worker, SOR_stencil() (its constant-coefficient sweeps
+   inline into each body) with the general sweep and stencil_residual(),
+   and PCG's thread body and red/black sweeps. dd_update() and
+   task_run() are cloned, and so is the SOR_async() worker, which
+   inlines async_row(). So are crng_fill_range(), pt_cb_base() and
+   cb_work(), and roof_peak_v4(), the roofline peak probe, which adds an
+   avx512f-only 512-bit body so the compute roof matches the kernels' ISA.
+   Left out on purpose: setup, packing and halo copies (batch_load(),
+   dd_edge(), grid_to_csr(), ...), which are memcpy-like or run once per
+   solve. Jacobi_row() is cloned, but its main loop is SSE2 intrinsics,
+   so the wider bodies only re-encode it (VEX) and widen the edges.
+
+   cpu_dispatch_path() names the body the resolver picks. It checks the
+   clones in the resolver's priority order. cpu_dispatch_report() logs
+   that name with the features seen.
+
+   Header-only; included by sor.h, pt_cb.h and roofline.h.
+*/
+
+#ifndef _CPU_DISPATCH_H_
+#define _CPU_DISPATCH_H_
+
+#include <stdio.h>
+
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(NO_KERNEL_CLONES)
+#define KERNEL_CLONES __attribute__((target_clones("default", "sse4.2", "avx2", "avx512f")))
+#define KERNEL_CLONES_ON 1
+#else
+#define KERNEL_CLONES
+#define KERNEL_CLONES_ON 0
+#endif
+
+/* Name of the kernel bodies in use */
+static inline const char *cpu_dispatch_path(void)
+{
+#if KERNEL_CLONES_ON
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return "avx512f";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("sse4.2")) return "sse4.2";
+    return "default";
+#else
+    return "default (no multiversioning)";
+#endif
+}
+
+/* One line: chosen path and the features it was chosen from */
+static inline void cpu_dispatch_report(FILE *fp)
+{
+#if KERNEL_CLONES_ON
+    __builtin_cpu_init();
+    fprintf(fp, "kernel dispatch: %s (sse4.2 %s, avx2 %s, avx512f %s)\n", cpu_dispatch_path(),
+            __builtin_cpu_supports("sse4.2") ? "yes" : "no",
+            __builtin_cpu_supports("avx2") ? "yes" : "no",
+            __builtin_cpu_supports("avx512f") ? "yes" : "no");
+#else
+    fprintf(fp, "kernel dispatch: %s\n", cpu_dispatch_path());
+#endif
+}
+
+#endif /* _CPU_DISPATCH_H_ */
@@ -0,0 +1,162 @@
+/* Counter-based random numbers for parallel, reproducible initialisation.
+
+   random() and rand() carry one hidden state through every call, so a
+   grid has to be filled serially, in order, and rand() is not even
+   thread-safe. Here the value at element index i of a fill is a pure
+   function of (seed, i): SplitMix64's output function applied to
+   key + (i + 1) * gamma, where key is the mixed seed. Any thread can
+   fill any range of indices, and the grid comes out identical whatever
+   the thread count. crng_fill_range() computes eight indices per step in
+   vector types under KERNEL_CLONES, with bitwise the scalar formula's
+   values, so the SSE2, AVX2 and AVX-512 bodies fill identical grids.
+
+   crng_fill_rows() covers the grid layouts in this repo: nrows rows of
+   rowlen values, row r at base + (r / plane_rows) * plane_pitch +
+   (r % plane_rows) * row_pitch. A 2D grid is one plane; an arr3_rec is
+   ny rows per plane with its pitches. Index i is r * rowlen + column, so
+   padding never shifts the values.
+
+   Rows are split across CRNG_THREADS threads (0 = one per online CPU)
+   once the fill is at least CRNG_PAR_MIN values.
+
+   Header-only; include from one .c file (sor.h and pt_cb.h include it).
+*/
+
+#ifndef _CRNG_H_
+#define _CRNG_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cpu_dispatch.h"
+
+#define CRNG_MAX_THREADS 64
+#define CRNG_GAMMA 0x9e3779b97f4a7c15ULL
+
+int CRNG_THREADS = 0;               /* 0 = sysconf(_SC_NPROCESSORS_ONLN) */
+long int CRNG_PAR_MIN = 1L << 18;   /* smaller fills stay on the caller */
+
+/* SplitMix64 output function */
+static inline uint64_t crng_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Value i of stream seed, uniform in [0, 1) with 53 random bits */
+static inline double crng_uniform(uint64_t seed, uint64_t i)
+{
+    return (double)(crng_mix(crng_mix(seed) + (i + 1) * CRNG_GAMMA) >> 11) * 0x1.0p-53;
+}
+
+typedef struct {
+    double *base;
+    long int row0, row1, rowlen, row_pitch, plane_rows, plane_pitch;
+    uint64_t key;
+    double lo, scale;
+} crng_job;
+
+/* Eight indices at a time in GCC vector types, which every clone lowers
+   to its widest registers. The 53-bit integer becomes a double without a
+   64-bit convert (AVX-512DQ only): its top 52 bits and its low bit each
+   go in a double's mantissa under the exponent of 2^52, both exact, so
+   the value is bitwise the scalar (double)x. The scale and the offset are
+   separate statements and fp-contract is off, so no clone fuses them. */
+typedef uint64_t crng_u64x8 __attribute__((vector_size(64)));
+typedef double crng_f64x8 __attribute__((vector_size(64)));
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define CRNG_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define CRNG_NO_CONTRACT
+#endif
+
+KERNEL_CLONES CRNG_NO_CONTRACT
+static void crng_fill_range(const crng_job *jb)
+{
+    const long int rowlen = jb->rowlen;
+    const uint64_t key = jb->key;
+    const double lo = jb->lo, scale = jb->scale;
+    const crng_u64x8 lane = {0, 1, 2, 3, 4, 5, 6, 7};
+    const crng_u64x8 exp52 = lane * 0 + 0x4330000000000000ULL;
+
+    for (long int r = jb->row0; r < jb->row1; r++) {
+        double *row = jb->base + (r / jb->plane_rows) * jb->plane_pitch +
+                      (r % jb->plane_rows) * jb->row_pitch;
+        const uint64_t ctr = key + (uint64_t)(r * rowlen + 1) * CRNG_GAMMA;
+        long int i = 0;
+
+        for (; i + 8 <= rowlen; i += 8) {
+            crng_u64x8 z = ctr + (lane + (uint64_t)i) * CRNG_GAMMA;
+            crng_f64x8 hi, odd, v;
+
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            z = (z ^ (z >> 31)) >> 11;
+            hi = (crng_f64x8)((z >> 1) | exp52) - 0x1.0p52;
+            odd = (crng_f64x8)((z & 1) | exp52) - 0x1.0p52;
+            v = (2.0 * hi + odd) * 0x1.0p-53;
+            v = scale * v;
+            v = lo + v;
+            __builtin_memcpy(row + i, &v, sizeof(v));
+        }
+        for (; i < rowlen; i++) {
+            double v = (double)(crng_mix(ctr + (uint64_t)i * CRNG_GAMMA) >> 11) * 0x1.0p-53;
+            v = scale * v;
+            row[i] = lo + v;
+        }
+    }
+}
+
+static void *crng_worker(void *arg)
+{
+    crng_fill_range((const crng_job *)arg);
+    return NULL;
+}
+
+/* Fill nrows x rowlen values uniform in [lo, hi) from stream seed */
+void crng_fill_rows(double *base, long int nrows, long int rowlen, long int row_pitch,
+                    long int plane_rows, long int plane_pitch, uint64_t seed,
+                    double lo, double hi)
+{
+    pthread_t threads[CRNG_MAX_THREADS];
+    crng_job jobs[CRNG_MAX_THREADS];
+    int nt = CRNG_THREADS > 0 ? CRNG_THREADS : (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (nt < 1) nt = 1;
+    if (nt > CRNG_MAX_THREADS) nt = CRNG_MAX_THREADS;
+    if (nt > nrows) nt = (int)nrows;
+    if (nrows * rowlen < CRNG_PAR_MIN) nt = 1;
+    for (int t = 0; t < nt; t++) {
+        jobs[t].base = base;
+        jobs[t].row0 = (t * nrows) / nt;
+        jobs[t].row1 = ((t + 1) * nrows) / nt;
+        jobs[t].rowlen = rowlen;
+        jobs[t].row_pitch = row_pitch;
+        jobs[t].plane_rows = plane_rows;
+        jobs[t].plane_pitch = plane_pitch;
+        jobs[t].key = crng_mix(seed);
+        jobs[t].lo = lo;
+        jobs[t].scale = hi - lo;
+    }
+    for (int t = 1; t < nt; t++) {
+        if (pthread_create(&threads[t], NULL, crng_worker, &jobs[t])) {
+            fprintf(stderr, "crng_fill_rows: could not create thread %d\n", t);
+            exit(-1);
+        }
+    }
+    if (nt > 0) crng_fill_range(&jobs[0]);
+    for (int t = 1; t < nt; t++) pthread_join(threads[t], NULL);
+}
+
+/* n x n contiguous values uniform in [lo, hi) */
+void crng_fill_square(double *data, long int n, uint64_t seed, double lo, double hi)
+{
+    crng_fill_rows(data, n, n, n, n, 0, seed, lo, hi);
+}
+
+#endif /* _CRNG_H_ */
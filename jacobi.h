@@ -0,0 +1,153 @@
+/* Double-buffered, threaded weighted Jacobi.
+
+   Every sweep reads only the source grid and writes only the destination
+   grid, so there are no dependences inside a sweep: the rows split across
+   threads with no ordering constraints. The inner loop is written with
+   SSE2 intrinsics, two points per step with |change| summed in two
+   lanes: without -ffast-math the compiler will not vectorize the fabs()
+   reduction of a plain loop.
+   The update has the same form as SOR's,
+
+       change = u - 0.25*(N + S + E + W)
+       u'     = u - JACOBI_WEIGHT * change
+
+   and the residual sum of |change| is accumulated in the same pass, with
+   the same convergence test as the SOR kernels, so iteration counts and
+   time-to-TOL compare directly. Jacobi needs more sweeps than SOR with a
+   good omega, but each one scales perfectly; test_SOR_mt.c reports where
+   that wins.
+
+   When the two grids exceed JACOBI_STREAM_BYTES the destination is
+   written with non-temporal (streaming) stores: the next sweep will not
+   find it in cache anyway, and streaming skips the read-for-ownership.
+   Smaller grids use ordinary stores so the destination stays cached.
+
+   JACOBI_MAX_SWEEPS > 0 stops after that many sweeps even if TOL is not
+   met, for measuring per-sweep cost on grids Jacobi would take hours to
+   converge.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _JACOBI_H_
+#define _JACOBI_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sor_mt.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JACOBI_HAVE_STREAM 1
+#else
+#define JACOBI_HAVE_STREAM 0
+#endif
+
+double JACOBI_WEIGHT = 1.0;     /* 1.0 is plain Jacobi */
+int JACOBI_STREAM = -1;         /* 1 always stream, 0 never, -1 by size */
+int JACOBI_MAX_SWEEPS = 0;      /* sweep budget, 0 = run to TOL */
+#define JACOBI_STREAM_BYTES (8L * 1024 * 1024)  /* ~ a last-level cache */
+
+void *Jacobi_thread(void *arg);
+void Jacobi_threaded(arr_ptr v, int num_threads, int *iterations);
+
+/* One row of src -> dst; returns the row's sum of |change| */
+KERNEL_CLONES
+static double Jacobi_row(const data_t *restrict src, data_t *restrict dst,
+                         long int rowlen, long int i, double w, int stream)
+{
+    const data_t *c = src + i * rowlen;
+    const data_t *n = c - rowlen, *s = c + rowlen;
+    data_t *o = dst + i * rowlen;
+    double change, total_change = 0;
+    long int j = 1, end = rowlen - 1;
+
+#if JACOBI_HAVE_STREAM
+    const __m128d quarter = _mm_set1_pd(0.25), wv = _mm_set1_pd(w);
+    const __m128d absmask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    __m128d acc = _mm_setzero_pd();
+    double lanes[2];
+
+    /* _mm_stream_pd needs 16-byte aligned destinations */
+    for (; stream && j < end && ((uintptr_t)(o + j) & 15); j++) {
+        change = c[j] - 0.25 * (n[j] + s[j] + c[j + 1] + c[j - 1]);
+        o[j] = c[j] - w * change;
+        total_change += fabs(change);
+    }
+    for (; j + 1 < end; j += 2) {
+        __m128d cc = _mm_loadu_pd(c + j);
+        __m128d sum = _mm_add_pd(_mm_add_pd(_mm_loadu_pd(n + j), _mm_loadu_pd(s + j)),
+                                 _mm_add_pd(_mm_loadu_pd(c + j + 1), _mm_loadu_pd(c + j - 1)));
+        __m128d ch = _mm_sub_pd(cc, _mm_mul_pd(quarter, sum));
+        __m128d out = _mm_sub_pd(cc, _mm_mul_pd(wv, ch));
+
+        if (stream) _mm_stream_pd(o + j, out);
+        else _mm_storeu_pd(o + j, out);
+        acc = _mm_add_pd(acc, _mm_and_pd(ch, absmask));
+    }
+    _mm_storeu_pd(lanes, acc);
+    total_change += lanes[0] + lanes[1];
+#endif
+    for (; j < end; j++) {
+        change = c[j] - 0.25 * (n[j] + s[j] + c[j + 1] + c[j - 1]);
+        o[j] = c[j] - w * change;
+        total_change += fabs(change);
+    }
+    return total_change;
+}
+
+/* Worker: rows [start_row, end_row) of both buffers, swapping each sweep */
+void *Jacobi_thread(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    long int rowlen = data->v->rowlen;
+    data_t *src = data->v->data, *dst = data->buf, *tmp;
+    const double w = JACOBI_WEIGHT, tol = TOL;
+    const int max_sweeps = JACOBI_MAX_SWEEPS;
+    int stream = JACOBI_STREAM >= 0 ? JACOBI_STREAM
+               : 2 * rowlen * rowlen * (long int)sizeof(data_t) > JACOBI_STREAM_BYTES;
+    double total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        for (long int i = data->start_row; i < data->end_row; i++) {
+            total_change += Jacobi_row(src, dst, rowlen, i, w, stream);
+        }
+#if JACOBI_HAVE_STREAM
+        if (stream) _mm_sfence();   /* streamed rows visible before the barrier */
+#endif
+        total_change = SOR_reduce_change(data, total_change);
+        tmp = src; src = dst; dst = tmp;
+    } while ((total_change / (rowlen * rowlen)) > tol && (max_sweeps <= 0 || iters < max_sweeps));
+
+    /* After an odd number of sweeps the answer is in buf */
+    if (iters & 1) {
+        for (long int i = data->start_row; i < data->end_row; i++) {
+            memcpy(data->v->data + i * rowlen + 1, data->buf + i * rowlen + 1,
+                   (rowlen - 2) * sizeof(data_t));
+        }
+    }
+    data->iterations = iters;
+    pthread_exit(NULL);
+}
+
+/* Jacobi on v with num_threads threads; the second buffer carries v's
+   ghost rows/columns so boundary values are the same on both sides. */
+void Jacobi_threaded(arr_ptr v, int num_threads, int *iterations) {
+    long int rowlen = v->rowlen;
+    size_t bytes = rowlen * rowlen * sizeof(data_t);
+    data_t *buf;
+
+    /* 64-byte aligned so streamed rows start on full cache lines more often */
+    if (posix_memalign((void **)&buf, 64, bytes)) {
+        fprintf(stderr, "Jacobi_threaded: could not allocate %zu bytes\n", bytes);
+        exit(-1);
+    }
+    memcpy(buf, v->data, bytes);
+    SOR_launch(v, num_threads, Jacobi_thread, buf, iterations);
+    free(buf);
+}
+
+#endif /* _JACOBI_H_ */
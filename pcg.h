@@ -0,0 +1,211 @@
+/* Matrix-free preconditioned conjugate gradient for the 5-point Laplacian
+   on an arr_rec grid.
+
+   The interior points are the unknowns and the ghost ring supplies the
+   Dirichlet values, exactly as in the SOR kernels; A is applied straight
+   from the stencil (A u = 4u - N - S - E - W), never stored. The SOR
+   convergence test uses change = u - 0.25*(N+S+E+W) = -r/4, so PCG stops
+   when sum|r| / (4 rowlen^2) <= TOL: the same criterion, and iteration
+   counts and time-to-TOL compare directly (one PCG iteration costs a few
+   SOR sweeps, but the count grows like rowlen rather than rowlen^2).
+
+   Threads own the same interior strips as SOR_thread_strip() and meet at
+   barriers between phases. Dot products and the residual norm use
+   SOR_reduce_change(): per-thread partials summed in thread order, so a
+   run is bitwise reproducible for a given thread count.
+
+   Preconditioners (PCG_PRECOND):
+     PCG_NONE    plain CG
+     PCG_SSOR    one symmetric SOR sweep per thread strip (block SSOR,
+                 no coupling between strips, so no extra barriers)
+     PCG_RBSOR   symmetric red/black SOR: red, black, black, red half
+                 sweeps over the whole grid, barrier between colours
+   Both use PCG_OMEGA; the result is symmetric positive definite, as CG
+   requires.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _PCG_H_
+#define _PCG_H_
+
+#include <string.h>
+
+#include "sor_mt.h"
+
+#define PCG_NONE  0
+#define PCG_SSOR  1
+#define PCG_RBSOR 2
+
+int PCG_PRECOND = PCG_RBSOR;
+double PCG_OMEGA = 1.5;
+int PCG_MAX_ITERS = 100000;     /* guard against a non-SPD setup; hitting it is reported */
+
+void *PCG_thread(void *arg);
+void PCG_threaded(arr_ptr v, int num_threads, int precond, int *iterations);
+
+/* Points of one colour in row i: j = first, first+2, ... */
+KERNEL_CLONES
+static void PCG_color_sweep(const data_t *r, data_t *z, long int rowlen,
+                            long int i0, long int i1, int color, int reverse,
+                            double w)
+{
+    for (long int ii = 0; ii < i1 - i0; ii++) {
+        long int i = reverse ? i1 - 1 - ii : i0 + ii;
+        long int first = 1 + ((i + color) & 1);
+        for (long int j = first; j < rowlen - 1; j += 2) {
+            long int p = i * rowlen + j;
+            z[p] += w * ((r[p] + z[p - rowlen] + z[p + rowlen] + z[p - 1] + z[p + 1]) * 0.25 - z[p]);
+        }
+    }
+}
+
+/* z = M^-1 r on rows [i0, i1) */
+KERNEL_CLONES
+static void PCG_precondition(thread_data_t *data, const data_t *r, data_t *z)
+{
+    long int rowlen = data->v->rowlen;
+    long int i0 = data->start_row, i1 = data->end_row;
+    const double w = PCG_OMEGA;
+
+    if (PCG_PRECOND == PCG_NONE) {
+        for (long int i = i0; i < i1; i++)
+            memcpy(z + i * rowlen + 1, r + i * rowlen + 1, (rowlen - 2) * sizeof(data_t));
+        return;
+    }
+
+    for (long int i = i0; i < i1; i++)
+        memset(z + i * rowlen + 1, 0, (rowlen - 2) * sizeof(data_t));
+
+    if (PCG_PRECOND == PCG_SSOR) {
+        /* Forward then backward Gauss-Seidel on this strip only; rows
+           outside it read as 0 (they are another block's unknowns) */
+        for (int reverse = 0; reverse < 2; reverse++) {
+            for (long int ii = 0; ii < i1 - i0; ii++) {
+                long int i = reverse ? i1 - 1 - ii : i0 + ii;
+                for (long int jj = 1; jj < rowlen - 1; jj++) {
+                    long int j = reverse ? rowlen - 1 - jj : jj;
+                    long int p = i * rowlen + j;
+                    double n = (i > i0) ? z[p - rowlen] : 0.0;
+                    double s = (i < i1 - 1) ? z[p + rowlen] : 0.0;
+                    z[p] += w * ((r[p] + n + s + z[p - 1] + z[p + 1]) * 0.25 - z[p]);
+                }
+            }
+        }
+        return;
+    }
+
+    /* PCG_RBSOR: red, black | black, red; a barrier before each colour so
+       strip edges see their neighbours' values for the other colour */
+    pthread_barrier_wait(&barrier);
+    PCG_color_sweep(r, z, rowlen, i0, i1, 0, 0, w);
+    pthread_barrier_wait(&barrier);
+    PCG_color_sweep(r, z, rowlen, i0, i1, 1, 0, w);
+    pthread_barrier_wait(&barrier);
+    PCG_color_sweep(r, z, rowlen, i0, i1, 1, 1, w);
+    pthread_barrier_wait(&barrier);
+    PCG_color_sweep(r, z, rowlen, i0, i1, 0, 1, w);
+}
+
+/* Worker. buf holds r, z, p, q, each rowlen^2 with a zero ghost ring. */
+KERNEL_CLONES
+void *PCG_thread(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    long int rowlen = data->v->rowlen, N = rowlen * rowlen;
+    long int i0 = data->start_row, i1 = data->end_row;
+    data_t *x = data->v->data;
+    data_t *r = data->buf, *z = r + N, *p = z + N, *q = p + N;
+    const double tol = TOL * 4.0 * N;   /* sum|r| <= 4 rowlen^2 TOL */
+    double rz, rz_new, pq, alpha, beta, l1 = 1.0e10;
+    int iters = 0;
+
+    /* r = b - A x, with the boundary values inside x */
+    for (long int i = i0; i < i1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            long int k = i * rowlen + j;
+            r[k] = x[k - rowlen] + x[k + rowlen] + x[k - 1] + x[k + 1] - 4.0 * x[k];
+        }
+    }
+    PCG_precondition(data, r, z);
+    rz = 0;
+    for (long int i = i0; i < i1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            long int k = i * rowlen + j;
+            p[k] = z[k];
+            rz += r[k] * z[k];
+        }
+    }
+    rz = SOR_reduce_change(data, rz);
+
+    while (iters < PCG_MAX_ITERS) {
+        iters++;
+
+        /* q = A p; p's ghost ring is zero */
+        pq = 0;
+        for (long int i = i0; i < i1; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                long int k = i * rowlen + j;
+                q[k] = 4.0 * p[k] - (p[k - rowlen] + p[k + rowlen] + p[k - 1] + p[k + 1]);
+                pq += p[k] * q[k];
+            }
+        }
+        pq = SOR_reduce_change(data, pq);
+        alpha = rz / pq;
+
+        l1 = 0;
+        for (long int i = i0; i < i1; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                long int k = i * rowlen + j;
+                x[k] += alpha * p[k];
+                r[k] -= alpha * q[k];
+                l1 += fabs(r[k]);
+            }
+        }
+        l1 = SOR_reduce_change(data, l1);
+        if (l1 <= tol) break;
+
+        PCG_precondition(data, r, z);
+        rz_new = 0;
+        for (long int i = i0; i < i1; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                long int k = i * rowlen + j;
+                rz_new += r[k] * z[k];
+            }
+        }
+        rz_new = SOR_reduce_change(data, rz_new);
+        beta = rz_new / rz;
+        rz = rz_new;
+        for (long int i = i0; i < i1; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                long int k = i * rowlen + j;
+                p[k] = z[k] + beta * p[k];
+            }
+        }
+        /* Next A p reads neighbouring strips' p */
+        pthread_barrier_wait(&barrier);
+    }
+
+    /* l1 is the reduced sum, the same on every thread */
+    if (l1 > tol && data->thread_id == 0) {
+        printf("PCG_threaded: NOT CONVERGED after %d iters, residual %g > TOL\n", iters,
+               l1 / (4.0 * N));
+    }
+    data->iterations = iters;
+    pthread_exit(NULL);
+}
+
+/* PCG on v with num_threads threads and the given PCG_* preconditioner */
+void PCG_threaded(arr_ptr v, int num_threads, int precond, int *iterations) {
+    long int N = v->rowlen * v->rowlen;
+    data_t *buf = (data_t *)calloc(4 * N, sizeof(data_t));
+
+    if (!buf) {
+        fprintf(stderr, "PCG_threaded: could not allocate work vectors\n");
+        exit(-1);
+    }
+    PCG_PRECOND = precond;
+    SOR_launch(v, num_threads, PCG_thread, buf, iterations);
+    free(buf);
+}
+
+#endif /* _PCG_H_ */
@@ -0,0 +1,37 @@
+import csv
+import json
+import sys
+
+
+def load_results(path=None):
+    """Load rows written by bench_harness.h (BENCH_CSV / BENCH_JSON).
+
+    With no path, uses sys.argv[1] if present; returns None when there is
+    nothing to load so the caller can fall back to its built-in data.
+    """
+    if path is None:
+        if len(sys.argv) < 2:
+            return None
+        path = sys.argv[1]
+    with open(path) as f:
+        if path.endswith(".json"):
+            rows = json.load(f)
+        else:
+            rows = list(csv.DictReader(f))
+    for r in rows:
+        r["size"] = int(r["size"])
+        r["threads"] = int(r["threads"])
+        for key in ("omega", "iters", "median_s", "min_s", "mean_s",
+                    "stddev_s", "median_cycles"):
+            r[key] = float(r[key])
+    return rows
+
+
+def series(rows, key, x, y, **match):
+    """Group rows by rows[key], returning {group: (xs, ys)} sorted by x."""
+    out = {}
+    for r in rows:
+        if any(r[k] != v for k, v in match.items()):
+            continue
+        out.setdefault(r[key], []).append((r[x], r[y]))
+    return {k: tuple(zip(*sorted(v))) for k, v in out.items()}
@@ -1,5 +1,6 @@
 import numpy as np
 import matplotlib.pyplot as plt
+from bench_results import load_results, series
 
 # Data from the output
 grid_sizes = np.array([34, 58, 98, 154, 226])
@@ -21,12 +22,24 @@ redblack_time_per_iter = redblack_times / (redblack_iters * grid_sizes**2)
 reversed_time_per_iter = reversed_times / (reversed_iters * grid_sizes**2)
 blocked_time_per_iter = blocked_times / (blocked_iters * grid_sizes**2)
 
+curves = {"Standard SOR": (grid_sizes, sor_time_per_iter),
+          "Red/Black SOR": (grid_sizes, redblack_time_per_iter),
+          "Reversed SOR": (grid_sizes, reversed_time_per_iter),
+          "Blocked SOR": (grid_sizes, blocked_time_per_iter)}
+
+# Usage: python3 part2.py [results.csv|results.json] from BENCH_CSV=... ./test_SOR
+rows = load_results()
+if rows:
+    curves = {}
+    for r in rows:
+        r["ns_per_point"] = r["median_s"] * 1e9 / (r["iters"] * r["size"] ** 2)
+    for kernel, (sizes, ns) in series(rows, "kernel", "size", "ns_per_point").items():
+        curves[kernel] = (np.array(sizes), np.array(ns))
+
 # Plot the results
 plt.figure(figsize=(8, 5))
-plt.plot(grid_sizes, sor_time_per_iter, marker='o', linestyle='-', label="Standard SOR")
-plt.plot(grid_sizes, redblack_time_per_iter, marker='s', linestyle='--', label="Red/Black SOR")
-plt.plot(grid_sizes, reversed_time_per_iter, marker='d', linestyle='-.', label="Reversed SOR")
-plt.plot(grid_sizes, blocked_time_per_iter, marker='x', linestyle=':', label="Blocked SOR")
+for (label, (sizes, t)), marker, style in zip(curves.items(), "osdx^v", ["-", "--", "-.", ":"] * 2):
+    plt.plot(sizes, t, marker=marker, linestyle=style, label=label)
 
 plt.xlabel("Grid Size")
 plt.ylabel("Time per Iteration (ns)")
@@ -1,5 +1,6 @@
 import matplotlib.pyplot as plt
 import numpy as np
+from bench_results import load_results, series
 
 # Data from execution results
 row_lengths = np.array([10, 12, 16, 22, 30, 40, 52, 66, 82, 100])
@@ -7,11 +8,19 @@ time_1_thread = np.array([26000, 26000, 48000, 92000, 168000, 296000, 502000, 81
 time_2_threads = np.array([188000, 182000, 156000, 196000, 248000, 274000, 400000, 546000, 742000, 1118000])
 time_4_threads = np.array([450000, 226000, 254000, 242000, 308000, 290000, 372000, 494000, 688000, 788000])
 
+curves = {1: (row_lengths, time_1_thread),
+          2: (row_lengths, time_2_threads),
+          4: (row_lengths, time_4_threads)}
+
+# Usage: python3 part3.py [results.csv|results.json] from BENCH_CSV=... ./test_pt
+rows = load_results()
+if rows:
+    curves = series(rows, "threads", "size", "median_cycles")
+
 # Plot execution times
 plt.figure(figsize=(8, 5))
-plt.plot(row_lengths, time_1_thread, 'o-', label="1 Thread")
-plt.plot(row_lengths, time_2_threads, 's-', label="2 Threads")
-plt.plot(row_lengths, time_4_threads, 'x-', label="4 Threads")
+for (threads, (n, t)), style in zip(sorted(curves.items()), ["o-", "s-", "x-", "d-", "^-"]):
+    plt.plot(n, t, style, label=f"{threads} Thread" + ("s" if threads > 1 else ""))
 
 plt.xlabel("Row Length (Array Size)")
 plt.ylabel("Execution Time (Cycles)")
@@ -0,0 +1,44 @@
+import matplotlib.pyplot as plt
+from bench_results import load_results
+
+# Usage: python3 scaling.py results.csv|results.json from BENCH_CSV=... ./test_scaling
+rows = load_results()
+if not rows:
+    raise SystemExit("usage: python3 scaling.py results.csv|results.json")
+
+# kernel names are <kernel>_<strong|weak>_<level>
+runs = {}
+for r in rows:
+    kernel, mode, level = r["kernel"].rsplit("_", 2)
+    runs.setdefault((mode, f"{kernel} {level}"), []).append((r["threads"], r["median_s"]))
+
+fig, (ax_speedup, ax_strong, ax_weak) = plt.subplots(1, 3, figsize=(15, 5))
+max_threads = max(r["threads"] for r in rows)
+ax_speedup.plot([1, max_threads], [1, max_threads], "k--", label="Ideal")
+for ax in (ax_strong, ax_weak):
+    ax.axhline(1.0, color="k", linestyle="--", label="Ideal")
+
+for ((mode, label), points), marker in zip(sorted(runs.items()), "os^dvx*+" * 2):
+    threads, secs = zip(*sorted(points))
+    if threads[0] != 1:
+        continue
+    t1 = secs[0]
+    if mode == "strong":
+        speedup = [t1 / s for s in secs]
+        ax_speedup.plot(threads, speedup, marker=marker, label=label)
+        ax_strong.plot(threads, [sp / t for sp, t in zip(speedup, threads)], marker=marker, label=label)
+    else:
+        ax_weak.plot(threads, [t1 / s for s in secs], marker=marker, label=label)
+
+ax_speedup.set_title("Strong Scaling Speedup")
+ax_speedup.set_ylabel("T(1) / T(t)")
+ax_strong.set_title("Strong Scaling Efficiency")
+ax_strong.set_ylabel("Speedup / t")
+ax_weak.set_title("Weak Scaling Efficiency")
+ax_weak.set_ylabel("T(1) / T(t), same work per thread")
+for ax in (ax_speedup, ax_strong, ax_weak):
+    ax.set_xlabel("Threads")
+    ax.grid(True)
+    ax.legend()
+plt.tight_layout()
+plt.show()
@@ -0,0 +1,269 @@
+/* Matrix type and the CPU-bound pt_cb_*() kernels from test_pt.c, shared
+   with sor_bench.c.
+
+   With TRACE set (trace.h) each cb_work() thread records its work as a
+   sweep, and the wait from its end to pt_cb_pthr()'s join as a barrier;
+   every pt_cb_pthr() call is one iteration.
+
+   Header-only; include from one .c file.
+*/
+
+#ifndef _PT_CB_H_
+#define _PT_CB_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <math.h>
+
+#include "crng.h"
+#include "cpu_dispatch.h"
+#include "trace.h"
+
+#ifndef IDENT
+#define IDENT 0
+#endif
+
+#ifndef INIT_LOW
+#define INIT_LOW -10.0
+#define INIT_HIGH 10.0
+#endif
+
+typedef double data_t;
+
+/* Create abstract data type for matrix */
+typedef struct {
+  long int rowlen;
+  data_t *data;
+} matrix_rec, *matrix_ptr;
+
+int NUM_THREADS = 4;
+
+/* used to pass parameters to worker threads */
+struct thread_data{
+  int thread_id;
+  matrix_ptr a;
+  matrix_ptr b;
+  matrix_ptr c;
+  matrix_ptr d;
+  int iter;
+};
+
+/* prototypes */
+matrix_ptr new_matrix(long int row_len);
+int set_matrix_rowlen(matrix_ptr m, long int index);
+long int get_matrix_rowlen(matrix_ptr m);
+int init_matrix(matrix_ptr m, long int row_len);
+int init_matrix_rand(matrix_ptr m, long int row_len);
+int init_matrix_rand_grad(matrix_ptr m, long int row_len);
+int zero_matrix(matrix_ptr m, long int len);
+void pt_cb_base(matrix_ptr a, matrix_ptr b, matrix_ptr c);
+void pt_cb_pthr(matrix_ptr a, matrix_ptr b, matrix_ptr c);
+void pt_mb(matrix_ptr a, matrix_ptr b, matrix_ptr c, matrix_ptr d);
+void pt_ob(matrix_ptr a, matrix_ptr b, matrix_ptr c);
+
+/**********************************************/
+/* Create matrix of specified row length */
+matrix_ptr new_matrix(long int row_len)
+{
+  long int i;
+
+  /* Allocate and declare header structure */
+  matrix_ptr result = (matrix_ptr) malloc(sizeof(matrix_rec));
+  if (!result) {
+    return NULL;  /* Couldn't allocate storage */
+  }
+  result->rowlen = row_len;
+
+  /* Allocate and declare array */
+  if (row_len > 0) {
+    data_t *data = (data_t *) calloc(row_len*row_len, sizeof(data_t));
+    if (!data) {
+	  free((void *) result);
+	  printf("COULDN'T ALLOCATE %ld bytes STORAGE \n",
+                                            row_len*row_len*sizeof(data_t));
+	  return NULL;  /* Couldn't allocate storage */
+	}
+	result->data = data;
+  }
+  else result->data = NULL;
+
+  return result;
+}
+
+/* Set row length of matrix */
+int set_matrix_rowlen(matrix_ptr m, long int row_len)
+{
+  m->rowlen = row_len;
+  return 1;
+}
+
+/* Return row length of matrix */
+long int get_matrix_rowlen(matrix_ptr m)
+{
+  return m->rowlen;
+}
+
+/* initialize matrix to consecutive numbers starting with 0 */
+int init_matrix(matrix_ptr m, long int row_len)
+{
+  long int i;
+
+  if (row_len > 0) {
+    m->rowlen = row_len;
+    for (i = 0; i < row_len*row_len; i++)
+      m->data[i] = (data_t)(i);
+    return 1;
+  }
+  else return 0;
+}
+
+/* crng.h streams are keyed by row_len, as init_array_rand()'s are, so a
+   test case gets the same matrix whatever ran before it; the gradient
+   fill uses its own range of seeds */
+#define MATRIX_GRAD_SEED (1ULL << 32)
+
+/* initialize matrix to random values in [INIT_LOW, INIT_HIGH] */
+int init_matrix_rand(matrix_ptr m, long int row_len)
+{
+  if (row_len > 0) {
+    m->rowlen = row_len;
+    crng_fill_square(m->data, row_len, (uint64_t)row_len, INIT_LOW, INIT_HIGH);
+    return 1;
+  }
+  else return 0;
+}
+
+/* initialize matrix to random values bounded by a "gradient" envelope */
+int init_matrix_rand_grad(matrix_ptr m, long int row_len)
+{
+  long int i;
+
+  if (row_len > 0) {
+    m->rowlen = row_len;
+    crng_fill_square(m->data, row_len, MATRIX_GRAD_SEED + (uint64_t)row_len, 0.0, 1.0);
+    for (i = 0; i < row_len*row_len; i++)
+      m->data[i] *= (data_t)(i);
+    return 1;
+  }
+  else return 0;
+}
+
+/* initialize matrix */
+int zero_matrix(matrix_ptr m, long int row_len)
+{
+  long int i,j;
+
+  if (row_len > 0) {
+    m->rowlen = row_len;
+    for (i = 0; i < row_len*row_len; i++)
+      m->data[i] = (data_t)(IDENT);
+    return 1;
+  }
+  else return 0;
+}
+
+data_t *get_matrix_start(matrix_ptr m)
+{
+  return m->data;
+}
+
+/* print matrix */
+int print_matrix(matrix_ptr v)
+{
+  long int i, j, row_len;
+
+  row_len = v->rowlen;
+  for (i = 0; i < row_len; i++) {
+    printf("\n");
+    for (j = 0; j < row_len; j++)
+      printf("%.4f ", (data_t)(v->data[i*row_len+j]));
+  }
+}
+
+/*************************************************/
+/* CPU bound baseline - perform transcendental function on all elements */
+KERNEL_CLONES
+void pt_cb_base(matrix_ptr a, matrix_ptr b, matrix_ptr c)
+{
+  long int i, j, k;
+  long int rowlen = get_matrix_rowlen(a);
+  data_t *a0 = get_matrix_start(a);
+  data_t *b0 = get_matrix_start(b);
+  data_t *c0 = get_matrix_start(c);
+
+  for (i = 0; i < rowlen*rowlen; i++) {
+    c0[i] = (data_t)(cosh(tan(sqrt(cos(exp((double)(a0[i])))))));
+    //c0[i] = a0[i];
+  }
+}
+
+/***************************************************************************/
+/* CPU bound multithreaded code. Here we use pthreads to do the same thing */
+/* as pt_cb_base().  first, the worker thread function                     */
+KERNEL_CLONES
+void *cb_work(void *threadarg)
+{
+  long int i, j, k, low, high;
+  struct thread_data *my_data;
+  my_data = (struct thread_data *) threadarg;
+  int taskid = my_data->thread_id;
+  matrix_ptr a0 = my_data->a;
+  matrix_ptr b0 = my_data->b;
+  matrix_ptr c0 = my_data->c;
+  long int rowlen = get_matrix_rowlen(a0);
+  data_t *aM = get_matrix_start(a0);
+  data_t *bM = get_matrix_start(b0);
+  data_t *cM = get_matrix_start(c0);
+
+  low = (taskid * rowlen * rowlen)/NUM_THREADS;
+  high = ((taskid+1)* rowlen * rowlen)/NUM_THREADS;
+
+  TRACE_EVENT(taskid, TRACE_SWEEP_BEGIN, my_data->iter);
+  for (i = low; i < high; i++) {
+    cM[i] = (data_t)(cosh(tan(sqrt(cos(exp((double)(aM[i])))))));
+    //cM[i] = aM[i];
+  }
+  TRACE_EVENT(taskid, TRACE_SWEEP_END, my_data->iter);
+  TRACE_EVENT(taskid, TRACE_BARRIER_ARRIVE, my_data->iter);
+
+  pthread_exit(NULL);
+} /* End of cb_work */
+
+/* Now, the pthread calling function */
+void pt_cb_pthr(matrix_ptr a, matrix_ptr b, matrix_ptr c)
+{
+  long int i, j, k;
+  pthread_t threads[NUM_THREADS];
+  struct thread_data thread_data_array[NUM_THREADS];
+  int rc;
+  long t;
+  static int calls = 0;
+
+  calls++;
+  for (t = 0; t < NUM_THREADS; t++) {
+    thread_data_array[t].thread_id = t;
+    thread_data_array[t].a = a;
+    thread_data_array[t].b = b;
+    thread_data_array[t].c = c;
+    thread_data_array[t].d = 0;
+    thread_data_array[t].iter = calls;
+    rc = pthread_create(&threads[t], NULL, cb_work,
+			(void*) &thread_data_array[t]);
+    if (rc) {
+      printf("ERROR; return code from pthread_create() is %d\n", rc);
+      exit(-1);
+    }
+  }
+
+  for (t = 0; t < NUM_THREADS; t++) {
+    if (pthread_join(threads[t],NULL)){ 
+      printf("ERROR; code on return from join is %d\n", rc);
+      exit(-1);
+    }
+  }
+  /* The workers are gone, so their rings are ours to write */
+  for (t = 0; t < NUM_THREADS; t++) TRACE_EVENT(t, TRACE_BARRIER_RELEASE, calls);
+}
+
+#endif /* _PT_CB_H_ */
@@ -0,0 +1,309 @@
+/* Roofline model support for sor_bench.c.
+
+   Per-point work counts for the kernels, plus two host probes:
+
+     roof_stream_gbs(t)    STREAM-style triad a[i] = b[i] + s*c[i] on t
+                           threads, arrays well beyond last-level cache;
+                           counted as 24 bytes/element like STREAM does
+     roof_peak_gflops(t)   independent multiply-add chains on t threads,
+                           i.e. the FP peak reachable by *this* build:
+                           the probe runs the ISA cpu_dispatch_path()
+                           picked for the kernels, with FMA where that
+                           body has it (avx512f)
+
+   A run with arithmetic intensity AI = flops/bytes is bounded by
+   min(peak, AI * bandwidth); roof_fraction() reports achieved/bound.
+
+   Header-only; include from one .c file.
+*/
+
+#ifndef _ROOFLINE_H_
+#define _ROOFLINE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef __APPLE__
+#include "apple_pthread_barrier.h"
+#endif /* __APPLE__ */
+
+#include "bench_harness.h"
+#include "cpu_dispatch.h"
+
+/* Point SOR update, per interior point per sweep:
+     change = c - 0.25*(n + s + e + w)    3 add, 1 mul, 1 sub
+     c -= change * omega                  1 mul, 1 sub
+     total_change += fabs(change)         1 add
+   Bytes are the compulsory traffic of one streaming pass (read + write
+   of the point; neighbours come from cache). Red/black makes two passes
+   over the grid per full sweep, so it moves twice that. A kernel with a
+   cache-hostile order (SOR_ji) keeps the same count and simply lands
+   further below the roof. */
+#define SOR_FLOPS_PER_POINT 8
+#define SOR_BYTES_PER_POINT 16
+#define SOR_RB_BYTES_PER_POINT 32
+
+/* 7-point SOR3d*() update: 5 adds, 1 mul, 1 sub for change, then the
+   same 3 flops as 2D. Bytes are the same compulsory 16 (32 red/black),
+   but only if three planes stay cached; see sor3d.h. */
+#define SOR3D_FLOPS_PER_POINT 10
+
+/* SOR_stencil(): a source term adds 1 mul + 1 add and streams f (8
+   bytes). The 9-point constant update adds 3 adds, 1 mul and 1 add for
+   the corners. The variable-coefficient path does a mul-add per
+   neighbour, a divide and the f add, and streams the four weights and
+   diag as well. */
+#define STENCIL_F_FLOPS_PER_POINT 2
+#define STENCIL_F_BYTES_PER_POINT 8
+#define STENCIL9_FLOPS_PER_POINT 13
+#define STENCIL_VAR_FLOPS_PER_POINT 14
+#define STENCIL_VAR_BYTES_PER_POINT 64
+
+/* PCG iteration, per interior point: q = A p (6), p.q (2), x and r
+   updates (4), |r| (1), r.z (2), p = z + beta p (2). Bytes: each of
+   those passes streams its vectors once (~15 doubles). A symmetric
+   SOR preconditioner adds two sweeps of 6 flops / ~3 doubles each. */
+#define PCG_FLOPS_PER_POINT 17
+#define PCG_BYTES_PER_POINT 120
+#define PCG_PRECOND_FLOPS_PER_POINT 12
+#define PCG_PRECOND_BYTES_PER_POINT 48
+
+/* Zebra line SOR (sor_line.h), per point: right-hand side 1 add,
+   forward 1 add + 1 mul, back 1 mul + 1 add, relax 1 sub + 1 mul +
+   1 add, residual 1 add. The grid traffic is SOR's; the tridiagonal
+   scratch stays in L1. */
+#define LINE_FLOPS_PER_POINT 9
+
+/* Sparse SOR (sor_sparse.h) on the 5-point grid, per point: 4 mul + 4
+   sub for the row sum, then 1 mul + 1 sub for change, 1 mul + 1 sub for
+   x and 1 add. Bytes per row: the 4 off-diagonal values (32) and int
+   columns (16), 1/a_ii and rhs (16), the row index from the colour list
+   or SELL lane (8) and CSR's rowptr (8), plus red/black's 32 for x. */
+#define SPARSE_FLOPS_PER_POINT 13
+#define CSR_BYTES_PER_POINT 112
+#define SELL_BYTES_PER_POINT 104
+
+/* cb_work(): cosh(tan(sqrt(cos(exp(a))))) per element. libm calls are
+   not countable flops; we charge ~20 flop-equivalents each (polynomial
+   plus range reduction). Reads a[i], writes c[i]. */
+#define CB_FLOPS_PER_ELEMENT 100
+#define CB_BYTES_PER_ELEMENT 16
+
+#define ROOF_MAX_THREADS 256
+#define ROOF_STREAM_N (8L * 1024 * 1024)  /* doubles per array: 64 MB */
+#define ROOF_REPS 5
+
+typedef struct {
+    int id, nthreads;
+    double *a, *b, *c;
+    long int n;
+    double result;            /* per-thread flops (peak probe) */
+    int first_touch;          /* triad probe: only initialise the slice */
+    double start, end;        /* triad probe: bench_now() around the reps */
+} roof_arg;
+
+pthread_barrier_t roof_barrier;
+
+static void roof_launch(int nthreads, void *(*fn)(void *), roof_arg *args)
+{
+    pthread_t threads[nthreads];
+
+    pthread_barrier_init(&roof_barrier, NULL, nthreads);
+    for (int t = 0; t < nthreads; t++) {
+        args[t].id = t;
+        args[t].nthreads = nthreads;
+        if (pthread_create(&threads[t], NULL, fn, &args[t])) {
+            printf("ERROR; roofline probe could not create thread %d\n", t);
+            exit(-1);
+        }
+    }
+    for (int t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+    pthread_barrier_destroy(&roof_barrier);
+}
+
+/* Each thread first-touches its own slice (first_touch run), or triads
+   it ROOF_REPS times, timing from the barrier before the first rep to
+   the end of its last */
+static void *roof_triad_work(void *arg)
+{
+    roof_arg *ra = (roof_arg *)arg;
+    long int lo = ra->id * ra->n / ra->nthreads;
+    long int hi = (ra->id + 1) * ra->n / ra->nthreads;
+    double *a = ra->a, *b = ra->b, *c = ra->c;
+    const double s = 3.0;
+
+    if (ra->first_touch) {
+        for (long int i = lo; i < hi; i++) {
+            a[i] = 0.0; b[i] = 1.0; c[i] = 2.0;
+        }
+        return NULL;
+    }
+    pthread_barrier_wait(&roof_barrier);
+    ra->start = bench_now();
+    for (int r = 0; r < ROOF_REPS; r++) {
+        if (r) pthread_barrier_wait(&roof_barrier);
+        for (long int i = lo; i < hi; i++) a[i] = b[i] + s * c[i];
+    }
+    ra->end = bench_now();
+    return NULL;
+}
+
+/* Eight independent accumulator chains a = a * m + add, so the adds and
+   multiplies pipeline; returns their sum to keep them live. Named
+   variables, not an array: GCC does not unroll an accumulator array at
+   -O2 and keeps it on the stack. The vector type sets the width. */
+#define ROOF_PEAK_CHAINS(vec, lanes, loops, out)                                    \
+    do {                                                                            \
+        vec m_, add_, a0, a1, a2, a3, a4, a5, a6, a7, sum_;                         \
+        for (int l_ = 0; l_ < (lanes); l_++) {                                      \
+            m_[l_] = 0.999999;                                                      \
+            add_[l_] = 1.0e-7;                                                      \
+            a0[l_] = l_;                                                            \
+        }                                                                           \
+        a1 = a0 + 1; a2 = a0 + 2; a3 = a0 + 3; a4 = a0 + 4;                         \
+        a5 = a0 + 5; a6 = a0 + 6; a7 = a0 + 7;                                      \
+        for (long int i_ = 0; i_ < (loops); i_++) {                                 \
+            a0 = a0 * m_ + add_; a1 = a1 * m_ + add_; a2 = a2 * m_ + add_;          \
+            a3 = a3 * m_ + add_; a4 = a4 * m_ + add_; a5 = a5 * m_ + add_;          \
+            a6 = a6 * m_ + add_; a7 = a7 * m_ + add_;                               \
+        }                                                                           \
+        sum_ = a0 + a1 + a2 + a3 + a4 + a5 + a6 + a7;                               \
+        (out) = 0.0;                                                                \
+        for (int l_ = 0; l_ < (lanes); l_++) (out) += sum_[l_];                     \
+    } while (0)
+
+typedef double roof_v4 __attribute__((vector_size(32)));
+typedef double roof_v8 __attribute__((vector_size(64)));
+
+/* 256-bit chains, cloned like the kernels: two xmm per vector in the
+   default and sse4.2 bodies, one ymm in avx2. No FMA in any of them,
+   and none in the kernels' clones either. */
+KERNEL_CLONES
+static double roof_peak_v4(long int loops)
+{
+    double sink;
+
+    ROOF_PEAK_CHAINS(roof_v4, 4, loops, sink);
+    return sink;
+}
+
+#if KERNEL_CLONES_ON
+/* The avx512f kernels' peak: one zmm per chain, contracted to FMA.
+   avx512f has FMA only at 512 bits (and scalar), and GCC lowers a
+   64-byte vector through memory in the narrower bodies, so this is a
+   separate function rather than a fourth clone of roof_peak_v4(). */
+__attribute__((target("avx512f")))
+static double roof_peak_v8(long int loops)
+{
+    double sink;
+
+    ROOF_PEAK_CHAINS(roof_v8, 8, loops, sink);
+    return sink;
+}
+#endif
+
+/* Runs the body cpu_dispatch_path() reports for the kernels */
+static void *roof_peak_work(void *arg)
+{
+    roof_arg *ra = (roof_arg *)arg;
+    const long int loops = 20L * 1000 * 1000;
+    int lanes = 4;
+
+#if KERNEL_CLONES_ON
+    if (strcmp(cpu_dispatch_path(), "avx512f") == 0) lanes = 8;
+#endif
+    pthread_barrier_wait(&roof_barrier);
+#if KERNEL_CLONES_ON
+    if (lanes == 8) {
+        ra->a[ra->id] = roof_peak_v8(loops);
+    } else
+#endif
+        ra->a[ra->id] = roof_peak_v4(loops);
+    ra->result = (double)loops * 8 * lanes * 2;
+    return NULL;
+}
+
+/* Best-of-ROOF_REPS triad bandwidth, GB/s; cached per thread count */
+double roof_stream_gbs(int nthreads)
+{
+    static double cache[ROOF_MAX_THREADS + 1];
+    roof_arg args[ROOF_MAX_THREADS];
+    double best = 0.0;
+
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > ROOF_MAX_THREADS) nthreads = ROOF_MAX_THREADS;
+    if (cache[nthreads] > 0.0) return cache[nthreads];
+
+    double *a = (double *)malloc(3 * ROOF_STREAM_N * sizeof(double));
+    if (!a) return 0.0;
+    for (int t = 0; t < nthreads; t++) {
+        args[t].a = a;
+        args[t].b = a + ROOF_STREAM_N;
+        args[t].c = a + 2 * ROOF_STREAM_N;
+        args[t].n = ROOF_STREAM_N;
+        args[t].first_touch = 1;
+    }
+    /* Untimed: the pages land with the threads that will stream them */
+    roof_launch(nthreads, roof_triad_work, args);
+    for (int t = 0; t < nthreads; t++) args[t].first_touch = 0;
+
+    /* Only the reps are timed, first start to last end; keep the best run */
+    for (int r = 0; r < 3; r++) {
+        double t0, t1;
+
+        roof_launch(nthreads, roof_triad_work, args);
+        t0 = args[0].start;
+        t1 = args[0].end;
+        for (int t = 1; t < nthreads; t++) {
+            if (args[t].start < t0) t0 = args[t].start;
+            if (args[t].end > t1) t1 = args[t].end;
+        }
+        double gbs = 24.0 * ROOF_STREAM_N * ROOF_REPS / (t1 - t0) * 1.0e-9;
+        if (gbs > best) best = gbs;
+    }
+    free(a);
+    return cache[nthreads] = best;
+}
+
+/* Multiply-add throughput, GFLOP/s; cached per thread count */
+double roof_peak_gflops(int nthreads)
+{
+    static double cache[ROOF_MAX_THREADS + 1];
+    roof_arg args[ROOF_MAX_THREADS];
+    double sink[ROOF_MAX_THREADS];
+    double best = 0.0, flops, t0, t1;
+
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > ROOF_MAX_THREADS) nthreads = ROOF_MAX_THREADS;
+    if (cache[nthreads] > 0.0) return cache[nthreads];
+
+    for (int t = 0; t < nthreads; t++) args[t].a = sink;
+    for (int r = 0; r < 3; r++) {
+        t0 = bench_now();
+        roof_launch(nthreads, roof_peak_work, args);
+        t1 = bench_now();
+        flops = 0.0;
+        for (int t = 0; t < nthreads; t++) flops += args[t].result;
+        if (flops / (t1 - t0) * 1.0e-9 > best) best = flops / (t1 - t0) * 1.0e-9;
+    }
+    return cache[nthreads] = best;
+}
+
+/* Attainable GFLOP/s at arithmetic intensity ai (flops/byte) */
+double roof_bound_gflops(double ai, int nthreads)
+{
+    double mem = ai * roof_stream_gbs(nthreads);
+    double peak = roof_peak_gflops(nthreads);
+    return mem < peak ? mem : peak;
+}
+
+/* Achieved fraction of the roofline bound */
+double roof_fraction(double gflops, double ai, int nthreads)
+{
+    double bound = roof_bound_gflops(ai, nthreads);
+    return bound > 0.0 ? gflops / bound : 0.0;
+}
+
+#endif /* _ROOFLINE_H_ */
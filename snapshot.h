@@ -0,0 +1,230 @@
+/* Background snapshot writer: intermediate grids on disk without slowing
+   the solve.
+
+   print_array() printf()s every value from the solving thread. Here a
+   kernel that calls SOR_HOOK (sor.h) every sweep hands the grid to
+   snap_offer(), which, every `every` sweeps, memcpy()s it into one of
+   SNAP_BUFFERS preallocated buffers and queues it for an I/O thread. The
+   solver never waits: if all buffers are queued or being written, the
+   snapshot is dropped and counted. Nothing is allocated after
+   snap_open().
+
+   Formats, one file per snapshot, <prefix>_<label>_<iter>.<ext>:
+
+     SNAP_RAW   "SORSNAP1", int64 rowlen, int64 iteration, then rowlen^2
+                float32 values in row order, host byte order (.snap)
+     SNAP_PGM   8-bit binary PGM, box-averaged down to at most
+                SNAP_PGM_SIDE pixels a side, MINVAL..MAXVAL -> 0..255 (.pgm)
+
+   Files are written under a temporary name and renamed, so a viewer
+   polling the directory never sees a partial one.
+
+   Header-only; include after sor.h from one .c file.
+*/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sor.h"
+
+#define SNAP_BUFFERS 4      /* grids in flight; the queue never holds more */
+#define SNAP_RAW 0
+#define SNAP_PGM 1
+#define SNAP_PATH 256
+
+long int SNAP_PGM_SIDE = 512;   /* largest PGM edge in pixels */
+
+typedef struct {
+    data_t *grid;
+    long int rowlen;
+    int iter;
+    char path[SNAP_PATH];
+} snap_buf;
+
+typedef struct {
+    const char *prefix;
+    char label[64];             /* set with snap_label() before each run */
+    int format, every;
+    long int max_rowlen;
+    snap_buf buf[SNAP_BUFFERS];
+    int free_list[SNAP_BUFFERS], num_free;
+    int queue[SNAP_BUFFERS], q_head, q_len;     /* FIFO of buffers to write */
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_t io;
+    int closing;
+    long int offered, written, dropped, failed;
+} snap_writer;
+
+int snap_open(snap_writer *w, const char *prefix, int format, int every, long int max_rowlen);
+void snap_label(snap_writer *w, const char *label);
+void snap_offer(void *arg, arr_ptr v, int iter);
+void snap_report(snap_writer *w, FILE *fp);
+void snap_close(snap_writer *w);
+
+/* Write one buffer; 0 on an I/O error */
+static int snap_write(const snap_writer *w, const snap_buf *b)
+{
+    char tmp[SNAP_PATH + 8];
+    long int n = b->rowlen;
+    FILE *fp;
+    int ok = 1;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", b->path);
+    if (!(fp = fopen(tmp, "wb"))) return 0;
+    if (w->format == SNAP_PGM) {
+        long int f = (n + SNAP_PGM_SIDE - 1) / SNAP_PGM_SIDE, side = (n + f - 1) / f;
+        unsigned char row[SNAP_PGM_SIDE];
+
+        fprintf(fp, "P5\n# iteration %d\n%ld %ld\n255\n", b->iter, side, side);
+        for (long int pi = 0; pi < side; pi++) {
+            for (long int pj = 0; pj < side; pj++) {
+                double sum = 0;
+                long int cnt = 0;
+                for (long int i = pi * f; i < n && i < (pi + 1) * f; i++) {
+                    for (long int j = pj * f; j < n && j < (pj + 1) * f; j++) {
+                        sum += b->grid[i * n + j];
+                        cnt++;
+                    }
+                }
+                double x = (sum / cnt - MINVAL) / (MAXVAL - MINVAL);
+                row[pj] = (unsigned char)(x <= 0 ? 0 : x >= 1 ? 255 : x * 255.0 + 0.5);
+            }
+            if (fwrite(row, 1, side, fp) != (size_t)side) ok = 0;
+        }
+    } else {
+        int64_t hdr[2] = {n, b->iter};
+        float row[n];
+
+        if (fwrite("SORSNAP1", 1, 8, fp) != 8 || fwrite(hdr, sizeof(hdr), 1, fp) != 1) ok = 0;
+        for (long int i = 0; ok && i < n; i++) {
+            for (long int j = 0; j < n; j++) row[j] = (float)b->grid[i * n + j];
+            if (fwrite(row, sizeof(float), n, fp) != (size_t)n) ok = 0;
+        }
+    }
+    if (fclose(fp)) ok = 0;
+    if (ok && rename(tmp, b->path)) ok = 0;
+    if (!ok) remove(tmp);
+    return ok;
+}
+
+/* I/O thread: write queued buffers in order until closed and drained */
+static void *snap_io_main(void *arg)
+{
+    snap_writer *w = (snap_writer *)arg;
+    int b, ok;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->q_len && !w->closing) pthread_cond_wait(&w->ready, &w->lock);
+        if (!w->q_len) break;
+        b = w->queue[w->q_head];
+        w->q_head = (w->q_head + 1) % SNAP_BUFFERS;
+        w->q_len--;
+        pthread_mutex_unlock(&w->lock);
+
+        ok = snap_write(w, &w->buf[b]);
+
+        pthread_mutex_lock(&w->lock);
+        if (ok) w->written++;
+        else w->failed++;
+        w->free_list[w->num_free++] = b;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* Allocate the pool for grids up to max_rowlen and start the I/O thread;
+   0 on failure */
+int snap_open(snap_writer *w, const char *prefix, int format, int every, long int max_rowlen)
+{
+    memset(w, 0, sizeof(*w));
+    if (every < 1 || (format != SNAP_RAW && format != SNAP_PGM) || SNAP_PGM_SIDE < 1) return 0;
+    w->prefix = prefix;
+    w->format = format;
+    w->every = every;
+    w->max_rowlen = max_rowlen;
+    for (int b = 0; b < SNAP_BUFFERS; b++) {
+        if (!(w->buf[b].grid = (data_t *)malloc(max_rowlen * max_rowlen * sizeof(data_t)))) {
+            while (b--) free(w->buf[b].grid);
+            return 0;
+        }
+        w->free_list[w->num_free++] = b;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->ready, NULL);
+    if (pthread_create(&w->io, NULL, snap_io_main, w)) {
+        fprintf(stderr, "snap_open: could not create the I/O thread\n");
+        exit(-1);
+    }
+    return 1;
+}
+
+/* Name part identifying the run, e.g. kernel and size */
+void snap_label(snap_writer *w, const char *label)
+{
+    snprintf(w->label, sizeof(w->label), "%s", label);
+}
+
+/* SOR_HOOK: snapshot v after sweep iter if due and a buffer is free */
+void snap_offer(void *arg, arr_ptr v, int iter)
+{
+    snap_writer *w = (snap_writer *)arg;
+    long int rowlen = get_arr_rowlen(v);
+    snap_buf *b;
+    int idx;
+
+    if (iter % w->every) return;
+    pthread_mutex_lock(&w->lock);
+    w->offered++;
+    if (!w->num_free || rowlen > w->max_rowlen) {
+        w->dropped++;
+        pthread_mutex_unlock(&w->lock);
+        return;
+    }
+    idx = w->free_list[--w->num_free];
+    pthread_mutex_unlock(&w->lock);
+
+    /* The buffer is ours until queued; copy outside the lock */
+    b = &w->buf[idx];
+    memcpy(b->grid, get_array_start(v), rowlen * rowlen * sizeof(data_t));
+    b->rowlen = rowlen;
+    b->iter = iter;
+    snprintf(b->path, SNAP_PATH, "%s_%s_%06d.%s", w->prefix, w->label, iter,
+             w->format == SNAP_PGM ? "pgm" : "snap");
+
+    pthread_mutex_lock(&w->lock);
+    w->queue[(w->q_head + w->q_len) % SNAP_BUFFERS] = idx;
+    w->q_len++;
+    pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* One line: snapshots offered, written, dropped since the last report */
+void snap_report(snap_writer *w, FILE *fp)
+{
+    pthread_mutex_lock(&w->lock);
+    fprintf(fp, "  snapshots: %ld offered, %ld written, %ld dropped, %ld failed, %d queued\n",
+            w->offered, w->written, w->dropped, w->failed, w->q_len);
+    w->offered = w->written = w->dropped = w->failed = 0;
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* Write everything still queued, stop the I/O thread, free the pool */
+void snap_close(snap_writer *w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->closing = 1;
+    pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->io, NULL);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->ready);
+    for (int b = 0; b < SNAP_BUFFERS; b++) free(w->buf[b].grid);
+}
+
+#endif /* _SNAPSHOT_H_ */
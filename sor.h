@@ -0,0 +1,676 @@
+/* Grid type and serial SOR kernels shared by test_SOR.c, test_SOR_mt.c and
+   sor_bench.c.
+
+   OMEGA, TOL and the SOR_blocked() tile shape used to be compile-time
+   #defines in each driver; they are runtime globals here (as OMEGA already
+   is in test_SOR_OMEGA.c) so the unified driver can sweep them. Kernels
+   copy them into locals on entry, so the inner loops see constants.
+
+   Header-only, like apple_pthread_barrier.h: include from one .c file.
+*/
+
+#ifndef _SOR_H_
+#define _SOR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "crng.h"
+#include "cpu_dispatch.h"
+
+#ifndef GHOST
+#define GHOST 2     /* Extra rows/columns for "ghost zone" */
+#endif
+#ifndef MINVAL
+#define MINVAL 0.0
+#endif
+#ifndef MAXVAL
+#define MAXVAL 10.0
+#endif
+
+typedef double data_t;
+
+typedef struct {
+    long int rowlen;
+    data_t *data;
+} arr_rec, *arr_ptr;
+
+/* Runtime parameters */
+double OMEGA = 1.75;        /* Best performing relaxation parameter from Part 1 */
+double TOL = 0.00001;
+long int BLOCK_ROWS = 8;    /* SOR_blocked() tile shape; 8x8 was the best */
+long int BLOCK_COLS = 8;    /* square tile determined experimentally */
+
+/* Called by the serial kernels after every full sweep with the grid and
+   the sweep count, e.g. snap_offer() from snapshot.h; NULL = off */
+void (*SOR_HOOK)(void *arg, arr_ptr v, int iter) = NULL;
+void *SOR_HOOK_ARG = NULL;
+
+/* SOR_deferred() / SOR_blocked_deferred(): measure the residual every
+   RESID_EVERY sweeps, or 0 to pick the interval from the observed
+   convergence rate, never more than RESID_MAX_EVERY apart */
+int RESID_EVERY = 0;
+int RESID_MAX_EVERY = 32;
+
+/* SOR_blocked_active(): a tile sleeps once its mean |change| is below
+   ACTIVE_FRAC * TOL; every ACTIVE_FULL_EVERY sweeps all tiles run */
+double ACTIVE_FRAC = 0.1;
+int ACTIVE_FULL_EVERY = 16;
+
+/* Function Prototypes */
+arr_ptr new_array(long int row_len);
+void free_array(arr_ptr v);
+int set_arr_rowlen(arr_ptr v, long int index);
+long int get_arr_rowlen(arr_ptr v);
+int init_array_rand(arr_ptr v, long int row_len);
+data_t *get_array_start(arr_ptr v);
+double SOR_residual(arr_ptr v);
+void SOR(arr_ptr v, int *iterations);
+void SOR_redblack(arr_ptr v, int *iterations);
+void SOR_ji(arr_ptr v, int *iterations);
+void SOR_blocked(arr_ptr v, int *iterations);
+void SOR_deferred(arr_ptr v, int *iterations);
+void SOR_blocked_deferred(arr_ptr v, int *iterations);
+void SOR_blocked_active(arr_ptr v, int *iterations);
+void SOR_oblivious(arr_ptr v, int *iterations);
+
+/* Function Definitions */
+arr_ptr new_array(long int row_len)
+{
+    arr_ptr result = (arr_ptr)malloc(sizeof(arr_rec));
+    if (!result) return NULL;
+    result->rowlen = row_len;
+    result->data = (data_t *)calloc(row_len * row_len, sizeof(data_t));
+    if (!result->data) {
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+void free_array(arr_ptr v)
+{
+    if (!v) return;
+    free(v->data);
+    free(v);
+}
+
+int set_arr_rowlen(arr_ptr v, long int row_len) { v->rowlen = row_len; return 1; }
+long int get_arr_rowlen(arr_ptr v) { return v->rowlen; }
+data_t *get_array_start(arr_ptr v) { return v->data; }
+
+/* Random grid in [MINVAL, MAXVAL], reproducible per row_len and the same
+   for any number of filling threads (crng.h) */
+int init_array_rand(arr_ptr v, long int row_len)
+{
+    crng_fill_square(v->data, row_len, (uint64_t)row_len, MINVAL, MAXVAL);
+    return 1;
+}
+
+/* Mean |change| one more SOR() sweep would make, in the same units as the
+   convergence test, without modifying the grid */
+KERNEL_CLONES
+double SOR_residual(arr_ptr v)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    double total_change = 0;
+
+    for (long int i = 1; i < rowlen - 1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            total_change += fabs(data[i * rowlen + j] - 0.25 * (data[(i - 1) * rowlen + j] +
+                                                                data[(i + 1) * rowlen + j] +
+                                                                data[i * rowlen + j + 1] +
+                                                                data[i * rowlen + j - 1]));
+        }
+    }
+    return total_change / (double)(rowlen * rowlen);
+}
+
+/************************************/
+
+/* Standard SOR */
+KERNEL_CLONES
+void SOR(arr_ptr v, int *iterations) {
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    const double omega = OMEGA, tol = TOL;
+    double change, total_change = 1.0e10;
+    int iters = 0;
+
+    while ((total_change / (rowlen * rowlen)) > tol) {
+        iters++;
+        total_change = 0;
+        for (long int i = 1; i < rowlen - 1; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                change = data[i * rowlen + j] - 0.25 * (data[(i - 1) * rowlen + j] +
+                                                        data[(i + 1) * rowlen + j] +
+                                                        data[i * rowlen + j + 1] +
+                                                        data[i * rowlen + j - 1]);
+                data[i * rowlen + j] -= change * omega;
+                total_change += fabs(change);
+            }
+        }
+        if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+    }
+    *iterations = iters;
+}
+
+/* SOR red/black */
+KERNEL_CLONES
+void SOR_redblack(arr_ptr v, int *iterations)
+{
+  int i, j, redblack;
+  long int ti;
+  long int rowlen = get_arr_rowlen(v);
+  data_t *data = get_array_start(v);
+  const double omega = OMEGA, tol = TOL;
+  double change, total_change = 1.0e10;   /* start w/ something big */
+  int iters = 0;
+
+  ti = 0;
+  redblack = 0;
+  /* The while condition here tests the tolerance limit *only* when
+     redblack is 0, which ensures we exit only after having done a
+     full update (red + black) */
+  while ((redblack == 1)
+        || ((total_change/(double)(rowlen*rowlen)) > tol) )
+  {
+    /* Reset sum of total change only when starting a black scan. */
+    if (redblack == 0) {
+      total_change = 0;
+    }
+    for (i = 1; i < rowlen-1; i++) {
+      /* The j loop needs to start at j=1 on row 0 and all even rows,
+         and start at j=2 on odd rows; but when redblack is true it does
+         just the opposite; and it always increments by 2. */
+      for (j = 1 + ((i^redblack)&1); j < rowlen-1; j+=2) {
+        change = data[i*rowlen+j] - .25 * (data[(i-1)*rowlen+j] +
+                                          data[(i+1)*rowlen+j] +
+                                          data[i*rowlen+j+1] +
+                                          data[i*rowlen+j-1]);
+        data[i*rowlen+j] -= change * omega;
+        if (change < 0) {
+          change = -change;
+        }
+        total_change += change;
+        ti++;
+      }
+    }
+    if (abs(data[(rowlen-2)*(rowlen-2)]) > 10.0*(MAXVAL - MINVAL)) {
+      printf("SOR: SUSPECT DIVERGENCE iter = %d\n", iters);
+      break;
+    }
+    redblack ^= 1;
+    iters++;
+    if (SOR_HOOK && redblack == 0) SOR_HOOK(SOR_HOOK_ARG, v, iters / 2);
+  }
+  /* A "red scan" only updates half of the array, and likewise for a
+     "black scan"; so we need to divide iters by 2 to convert our count of
+     "reds+blacks" to a count of "full scans" */
+  iters /= 2;
+  *iterations = iters;
+  printf("    SOR_redblack() done after %d iters\n", iters);
+  /* printf("ti == %ld, per iter %ld\n", ti, ti/iters); */
+} /* End of SOR_redblack */
+
+/* SOR with reversed indices */
+KERNEL_CLONES
+void SOR_ji(arr_ptr v, int *iterations)
+{
+  long int i, j;
+  long int rowlen = get_arr_rowlen(v);
+  data_t *data = get_array_start(v);
+  const double omega = OMEGA, tol = TOL;
+  double change, total_change = 1.0e10;   /* start w/ something big */
+  int iters = 0;
+
+  while ((total_change/(double)(rowlen*rowlen)) > tol) {
+    iters++;
+    total_change = 0;
+    for (j = 1; j < rowlen-1; j++) {
+      for (i = 1; i < rowlen-1; i++) {
+        change = data[i*rowlen+j] - .25 * (data[(i-1)*rowlen+j] +
+                                          data[(i+1)*rowlen+j] +
+                                          data[i*rowlen+j+1] +
+                                          data[i*rowlen+j-1]);
+        data[i*rowlen+j] -= change * omega;
+        if (change < 0){
+          change = -change;
+        }
+        total_change += change;
+      }
+    }
+    if (abs(data[(rowlen-2)*(rowlen-2)]) > 10.0*(MAXVAL - MINVAL)) {
+      printf("SOR_ji: SUSPECT DIVERGENCE iter = %d\n", iters);
+      break;
+    }
+    if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+  }
+  *iterations = iters;
+  printf("    SOR_ji() done after %d iters\n", iters);
+}
+
+/* SOR w/ blocking. Tiles are BLOCK_ROWS x BLOCK_COLS; the last tile in
+   each direction is clipped when the interior is not a multiple. */
+KERNEL_CLONES
+void SOR_blocked(arr_ptr v, int *iterations)
+{
+  long int i, j, ii, jj, iend, jend;
+  long int rowlen = get_arr_rowlen(v);
+  data_t *data = get_array_start(v);
+  const long int brows = BLOCK_ROWS, bcols = BLOCK_COLS;
+  const double omega = OMEGA, tol = TOL;
+  double change, total_change = 1.0e10;
+  int iters = 0;
+
+  if (brows < 1 || bcols < 1) {
+    fprintf(stderr, "SOR_blocked: block shape %ldx%ld is invalid\n",
+            brows, bcols);
+    exit(-1);
+  }
+
+  while ((total_change/(double)(rowlen*rowlen)) > tol) {
+    iters++;
+    total_change = 0;
+    for (ii = 1; ii < rowlen-1; ii+=brows) {
+      iend = (ii+brows < rowlen-1) ? ii+brows : rowlen-1;
+      for (jj = 1; jj < rowlen-1; jj+=bcols) {
+        jend = (jj+bcols < rowlen-1) ? jj+bcols : rowlen-1;
+        for (i = ii; i < iend; i++) {
+          for (j = jj; j < jend; j++) {
+            change = data[i*rowlen+j] - .25 * (data[(i-1)*rowlen+j] +
+                                              data[(i+1)*rowlen+j] +
+                                              data[i*rowlen+j+1] +
+                                              data[i*rowlen+j-1]);
+            data[i*rowlen+j] -= change * omega;
+            if (change < 0){
+              change = -change;
+            }
+            total_change += change;
+          }
+        }
+      }
+    }
+    if (abs(data[(rowlen-2)*(rowlen-2)]) > 10.0*(MAXVAL - MINVAL)) {
+      printf("SOR_blocked: SUSPECT DIVERGENCE iter = %d\n", iters);
+      break;
+    }
+    if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+  }
+  *iterations = iters;
+  printf("    SOR_blocked() done after %d iters\n", iters);
+} /* End of SOR_blocked */
+
+/* Deferred residual. Accumulating |change| into total_change adds a
+   serial fabs-add chain to every point of every sweep. Most sweeps below
+   are pure updates; every k-th one is a measured sweep with SOR()'s
+   convergence test, so the kernels stop at the first measured sweep that
+   SOR() would also have stopped at. The update order is unchanged, so
+   the grid after N sweeps is the same as SOR()'s (SOR_blocked()'s).
+
+   Adaptive k: two measured sweeps k apart give a per-sweep contraction
+   rate rho = (r / r_prev)^(1/k); the next measurement is placed where r
+   rho^k reaches the tolerance, capped at RESID_MAX_EVERY. While the
+   residual is not yet falling (SOR's early transient) k stays 1. The
+   cost is at most a few sweeps past SOR()'s count when rho speeds up. */
+
+/* One lexicographic sweep; measure is a literal at every call site */
+static inline __attribute__((always_inline))
+double SOR_sweep_lex(data_t *data, long int rowlen, double omega, int measure)
+{
+    double change, total_change = 0;
+
+    for (long int i = 1; i < rowlen - 1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            change = data[i * rowlen + j] - 0.25 * (data[(i - 1) * rowlen + j] +
+                                                    data[(i + 1) * rowlen + j] +
+                                                    data[i * rowlen + j + 1] +
+                                                    data[i * rowlen + j - 1]);
+            data[i * rowlen + j] -= change * omega;
+            if (measure) total_change += fabs(change);
+        }
+    }
+    return total_change;
+}
+
+/* One SOR_blocked() sweep; measure is a literal at every call site */
+static inline __attribute__((always_inline))
+double SOR_sweep_tiles(data_t *data, long int rowlen, long int brows, long int bcols,
+                       double omega, int measure)
+{
+    double change, total_change = 0;
+
+    for (long int ii = 1; ii < rowlen - 1; ii += brows) {
+        long int iend = (ii + brows < rowlen - 1) ? ii + brows : rowlen - 1;
+        for (long int jj = 1; jj < rowlen - 1; jj += bcols) {
+            long int jend = (jj + bcols < rowlen - 1) ? jj + bcols : rowlen - 1;
+            for (long int i = ii; i < iend; i++) {
+                for (long int j = jj; j < jend; j++) {
+                    change = data[i * rowlen + j] - .25 * (data[(i - 1) * rowlen + j] +
+                                                           data[(i + 1) * rowlen + j] +
+                                                           data[i * rowlen + j + 1] +
+                                                           data[i * rowlen + j - 1]);
+                    data[i * rowlen + j] -= change * omega;
+                    if (measure) total_change += fabs(change);
+                }
+            }
+        }
+    }
+    return total_change;
+}
+
+/* Sweeps until the next measured one, from residuals k sweeps apart */
+static int SOR_resid_interval(double prev, double cur, int k, double bound)
+{
+    double rho, m;
+
+    if (RESID_EVERY > 0) return RESID_EVERY;
+    if (prev <= 0 || cur >= prev) return 1;
+    rho = pow(cur / prev, 1.0 / k);
+    m = log(bound / cur) / log(rho);
+    if (m < 1) return 1;
+    return m > RESID_MAX_EVERY ? RESID_MAX_EVERY : (int)m;
+}
+
+/* SOR() with the residual measured every k sweeps */
+KERNEL_CLONES
+void SOR_deferred(arr_ptr v, int *iterations)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    const double omega = OMEGA, tol = TOL, bound = tol * (rowlen * rowlen);
+    double total_change = 1.0e10, prev = 0;
+    int iters = 0, measured = 0, k = 1;
+
+    if (RESID_EVERY < 0 || RESID_MAX_EVERY < 1) {
+        fprintf(stderr, "SOR_deferred: residual interval %d (max %d) is invalid\n",
+                RESID_EVERY, RESID_MAX_EVERY);
+        exit(-1);
+    }
+    for (;;) {
+        for (int s = 1; s < k; s++) {
+            SOR_sweep_lex(data, rowlen, omega, 0);
+            if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters + s);
+        }
+        total_change = SOR_sweep_lex(data, rowlen, omega, 1);
+        iters += k;
+        measured++;
+        if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+        if (total_change / (rowlen * rowlen) <= tol) break;
+        if (fabs(data[(rowlen - 2) * (rowlen - 2)]) > 10.0 * (MAXVAL - MINVAL)) {
+            printf("SOR_deferred: SUSPECT DIVERGENCE iter = %d\n", iters);
+            break;
+        }
+        k = SOR_resid_interval(prev, total_change, k, bound);
+        prev = total_change;
+    }
+    *iterations = iters;
+    printf("    SOR_deferred() done after %d iters, %d measured\n", iters, measured);
+}
+
+/* SOR_blocked() with the residual measured every k sweeps */
+KERNEL_CLONES
+void SOR_blocked_deferred(arr_ptr v, int *iterations)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    const long int brows = BLOCK_ROWS, bcols = BLOCK_COLS;
+    const double omega = OMEGA, tol = TOL, bound = tol * (rowlen * rowlen);
+    double total_change = 1.0e10, prev = 0;
+    int iters = 0, measured = 0, k = 1;
+
+    if (brows < 1 || bcols < 1 || RESID_EVERY < 0 || RESID_MAX_EVERY < 1) {
+        fprintf(stderr, "SOR_blocked_deferred: block %ldx%ld, residual interval %d (max %d) "
+                "is invalid\n", brows, bcols, RESID_EVERY, RESID_MAX_EVERY);
+        exit(-1);
+    }
+    for (;;) {
+        for (int s = 1; s < k; s++) {
+            SOR_sweep_tiles(data, rowlen, brows, bcols, omega, 0);
+            if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters + s);
+        }
+        total_change = SOR_sweep_tiles(data, rowlen, brows, bcols, omega, 1);
+        iters += k;
+        measured++;
+        if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+        if (total_change / (rowlen * rowlen) <= tol) break;
+        if (fabs(data[(rowlen - 2) * (rowlen - 2)]) > 10.0 * (MAXVAL - MINVAL)) {
+            printf("SOR_blocked_deferred: SUSPECT DIVERGENCE iter = %d\n", iters);
+            break;
+        }
+        k = SOR_resid_interval(prev, total_change, k, bound);
+        prev = total_change;
+    }
+    *iterations = iters;
+    printf("    SOR_blocked_deferred() done after %d iters, %d measured\n", iters, measured);
+}
+
+/* One SOR_blocked_active() point update; returns |change| */
+static inline __attribute__((always_inline))
+double active_point(data_t *data, long int rowlen, long int p, double omega)
+{
+    double change = data[p] - .25 * (data[p - rowlen] + data[p + rowlen] + data[p + 1] + data[p - 1]);
+
+    data[p] -= change * omega;
+    return fabs(change);
+}
+
+/* SOR_blocked() with an active set of tiles. A tile whose mean |change|
+   falls below ACTIVE_FRAC * TOL is put to sleep and skipped. A neighbour
+   reads only the tile's edge row or column on its side, so each of the
+   four edges keeps its own largest |change|, and only an edge above that
+   threshold wakes the neighbour across it. Skipped tiles count with the
+   sum|change| of their last update, so far from a disturbance a sweep
+   costs only the active area.
+
+   A full sweep over every tile runs every ACTIVE_FULL_EVERY sweeps, and
+   as soon as the estimated residual meets TOL. Only a full sweep can end
+   the solve, with SOR_blocked()'s test on an exact residual. */
+KERNEL_CLONES
+void SOR_blocked_active(arr_ptr v, int *iterations)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    const long int brows = BLOCK_ROWS, bcols = BLOCK_COLS;
+    const double omega = OMEGA, tol = TOL, eps = ACTIVE_FRAC * TOL;
+    const int full_every = ACTIVE_FULL_EVERY;
+    long int nti, ntj, updates = 0;
+    unsigned char *active;
+    double *last;                   /* each tile's sum|change| at its last update */
+    double estimate;
+    int iters = 0, full = 1, since_full = 0;
+
+    if (brows < 1 || bcols < 1 || full_every < 1) {
+        fprintf(stderr, "SOR_blocked_active: block %ldx%ld, full sweep every %d is invalid\n",
+                brows, bcols, full_every);
+        exit(-1);
+    }
+    nti = (rowlen - 2 + brows - 1) / brows;
+    ntj = (rowlen - 2 + bcols - 1) / bcols;
+    active = (unsigned char *)calloc(nti * ntj, 1);
+    last = (double *)calloc(nti * ntj, sizeof(double));
+    if (!active || !last) {
+        fprintf(stderr, "SOR_blocked_active: could not allocate %ld tiles\n", nti * ntj);
+        exit(-1);
+    }
+
+    for (;;) {
+        iters++;
+        estimate = 0;
+        for (long int ti = 0; ti < nti; ti++) {
+            long int ii = 1 + ti * brows, iend = (ii + brows < rowlen - 1) ? ii + brows : rowlen - 1;
+            for (long int tj = 0; tj < ntj; tj++) {
+                long int t = ti * ntj + tj;
+                long int jj = 1 + tj * bcols, jend = (jj + bcols < rowlen - 1) ? jj + bcols : rowlen - 1;
+                double sum = 0, north = 0, south = 0, west = 0, east = 0;
+
+                if (!full && !active[t]) {
+                    estimate += last[t];
+                    continue;
+                }
+                for (long int i = ii; i < iend; i++) {
+                    /* The first and last columns are peeled to track the
+                       west and east edges without a test per point */
+                    double c = active_point(data, rowlen, i * rowlen + jj, omega), rmax = c;
+
+                    sum += c;
+                    west = c > west ? c : west;
+                    for (long int j = jj + 1; j < jend - 1; j++) {
+                        c = active_point(data, rowlen, i * rowlen + j, omega);
+                        sum += c;
+                        rmax = c > rmax ? c : rmax;
+                    }
+                    if (jend - 1 > jj) {
+                        c = active_point(data, rowlen, i * rowlen + jend - 1, omega);
+                        sum += c;
+                        rmax = c > rmax ? c : rmax;
+                    }
+                    east = c > east ? c : east;
+                    if (i == ii) north = rmax;
+                    if (i == iend - 1) south = rmax;
+                }
+                updates++;
+                last[t] = sum;
+                estimate += sum;
+                active[t] = sum >= eps * (double)((iend - ii) * (jend - jj));
+                if (north > eps && ti > 0) active[t - ntj] = 1;
+                if (south > eps && ti < nti - 1) active[t + ntj] = 1;
+                if (west > eps && tj > 0) active[t - 1] = 1;
+                if (east > eps && tj < ntj - 1) active[t + 1] = 1;
+            }
+        }
+        if (fabs(data[(rowlen - 2) * (rowlen - 2)]) > 10.0 * (MAXVAL - MINVAL)) {
+            printf("SOR_blocked_active: SUSPECT DIVERGENCE iter = %d\n", iters);
+            break;
+        }
+        if (full) {
+            if (estimate / (double)(rowlen * rowlen) <= tol) break;
+            full = 0;
+            since_full = 0;
+        } else if (estimate / (double)(rowlen * rowlen) <= tol || ++since_full >= full_every) {
+            full = 1;
+        }
+        if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+    }
+    *iterations = iters;
+    printf("    SOR_blocked_active() done after %d iters, %.1f%% of tile updates\n",
+           iters, 100.0 * updates / ((double)iters * nti * ntj));
+    free(active);
+    free(last);
+}
+
+/* Cache-oblivious space-time SOR: SOR()'s exact update order over many
+   sweeps at once, with no block size.
+
+   In skewed coordinates i' = i + t, j' = j + t (t = sweep) every point
+   depends only on points whose i', j' and t are all no larger: the new
+   north and west values (same t), the old south and east values and its
+   own old value (t - 1), and the overwritten old value must have been
+   read by the north and west points first. So any box in (i', j', t)
+   space can be cut in half along any axis and the low half done first.
+   SOR_oblivious_box() does that recursively, cutting the longest side,
+   down to leaves of about SOR_CO_LEAF points; whatever the cache sizes,
+   some level of the recursion has boxes that fit each of them, and a
+   box is reused across all the sweeps it spans. Rows stay unit-stride,
+   so the row axis is only cut once it is twice the others.
+
+   Each chunk runs k sweeps, with every sweep's sum|change| accumulated
+   exactly. k comes from SOR_resid_interval() (RESID_EVERY /
+   RESID_MAX_EVERY), fed with the last two sweeps. Sweeps of a chunk are
+   interleaved, so the solve stops at the end of the chunk that contains
+   the first sweep meeting TOL: up to k - 1 sweeps more than SOR(), never
+   fewer. SOR_HOOK sees the grid once per chunk. */
+#define SOR_CO_LEAF 2048
+
+KERNEL_CLONES
+static void SOR_oblivious_leaf(data_t *data, long int rowlen, double omega, double *sweep_change,
+                               long int i0, long int i1, long int j0, long int j1, int t0, int t1)
+{
+    double change;
+
+    for (int t = t0; t < t1; t++) {
+        long int ilo = i0 - t > 1 ? i0 - t : 1, ihi = i1 - t < rowlen - 1 ? i1 - t : rowlen - 1;
+        long int jlo = j0 - t > 1 ? j0 - t : 1, jhi = j1 - t < rowlen - 1 ? j1 - t : rowlen - 1;
+        double total_change = 0;
+
+        for (long int i = ilo; i < ihi; i++) {
+            for (long int j = jlo; j < jhi; j++) {
+                change = data[i * rowlen + j] - .25 * (data[(i - 1) * rowlen + j] +
+                                                       data[(i + 1) * rowlen + j] +
+                                                       data[i * rowlen + j + 1] +
+                                                       data[i * rowlen + j - 1]);
+                data[i * rowlen + j] -= change * omega;
+                total_change += fabs(change);
+            }
+        }
+        sweep_change[t] += total_change;
+    }
+}
+
+/* Sweeps t0..t1-1 over skewed rows i0..i1-1, columns j0..j1-1 */
+static void SOR_oblivious_box(data_t *data, long int rowlen, double omega, double *sweep_change,
+                              long int i0, long int i1, long int j0, long int j1, int t0, int t1)
+{
+    long int di = i1 - i0, dj = j1 - j0, dt = t1 - t0;
+
+    /* Sweeps for which the box holds interior points: i, j in [1, rowlen - 1) */
+    long int lo = t0, hi = t1;
+    if (i0 - (rowlen - 2) > lo) lo = i0 - (rowlen - 2);
+    if (j0 - (rowlen - 2) > lo) lo = j0 - (rowlen - 2);
+    if (i1 - 1 < hi) hi = i1 - 1;
+    if (j1 - 1 < hi) hi = j1 - 1;
+    if (lo >= hi) return;
+
+    if (di * dj * dt <= SOR_CO_LEAF) {
+        SOR_oblivious_leaf(data, rowlen, omega, sweep_change, i0, i1, j0, j1, t0, t1);
+    } else if (dj >= 2 * di && dj >= 2 * dt) {
+        SOR_oblivious_box(data, rowlen, omega, sweep_change, i0, i1, j0, j0 + dj / 2, t0, t1);
+        SOR_oblivious_box(data, rowlen, omega, sweep_change, i0, i1, j0 + dj / 2, j1, t0, t1);
+    } else if (di >= dt) {
+        SOR_oblivious_box(data, rowlen, omega, sweep_change, i0, i0 + di / 2, j0, j1, t0, t1);
+        SOR_oblivious_box(data, rowlen, omega, sweep_change, i0 + di / 2, i1, j0, j1, t0, t1);
+    } else {
+        SOR_oblivious_box(data, rowlen, omega, sweep_change, i0, i1, j0, j1, t0, t0 + dt / 2);
+        SOR_oblivious_box(data, rowlen, omega, sweep_change, i0, i1, j0, j1, t0 + dt / 2, t1);
+    }
+}
+
+void SOR_oblivious(arr_ptr v, int *iterations)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    const double omega = OMEGA, tol = TOL, bound = tol * (rowlen * rowlen);
+    double sweep_change[RESID_MAX_EVERY + 1], prev, last = 0;
+    int iters = 0, chunks = 0, first_met = 0, k = 1;
+
+    if (RESID_EVERY < 0 || RESID_MAX_EVERY < 1 || RESID_EVERY > RESID_MAX_EVERY) {
+        fprintf(stderr, "SOR_oblivious: residual interval %d (max %d) is invalid\n",
+                RESID_EVERY, RESID_MAX_EVERY);
+        exit(-1);
+    }
+    for (;;) {
+        for (int t = 0; t < k; t++) sweep_change[t] = 0;
+        SOR_oblivious_box(data, rowlen, omega, sweep_change, 1, rowlen - 1 + k - 1,
+                          1, rowlen - 1 + k - 1, 0, k);
+        chunks++;
+        for (int t = 0; t < k && !first_met; t++)
+            if (sweep_change[t] / (rowlen * rowlen) <= tol) first_met = iters + t + 1;
+        iters += k;
+        if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+        if (first_met) break;
+        if (fabs(data[(rowlen - 2) * (rowlen - 2)]) > 10.0 * (MAXVAL - MINVAL)) {
+            printf("SOR_oblivious: SUSPECT DIVERGENCE iter = %d\n", iters);
+            break;
+        }
+        prev = k > 1 ? sweep_change[k - 2] : last;
+        last = sweep_change[k - 1];
+        k = SOR_resid_interval(prev, last, 1, bound);
+    }
+    *iterations = iters;
+    printf("    SOR_oblivious() done after %d iters in %d chunks, TOL met at %d\n",
+           iters, chunks, first_met);
+}
+
+#endif /* _SOR_H_ */
@@ -0,0 +1,281 @@
+/* 3D grid type and 7-point SOR kernels.
+
+   The 3D analogue of arr_rec: nx, ny, nz points per dimension including
+   the ghost layer (GHOST/2 on each face), point (i,j,k) at
+
+       data[k*pitch_z + j*pitch_y + i]
+
+   pitch_y rounds rows up to whole cache lines, and pitch_z is bumped by a
+   line when a plane would be a multiple of 4 KB, so the six neighbours of
+   a point do not all map to the same cache sets.
+
+   Update and convergence test follow SOR() with six neighbours:
+
+       change = u - (1/6)(W + E + S + N + D + U)
+       u     -= change * OMEGA
+       stop when sum|change| / (nx*ny*nz) <= TOL
+
+   A 3D sweep has three live planes where 2D had three live rows, so a
+   plane (not a row) is what has to stay in cache; once nx*ny no longer
+   fits, SOR3d_blocked() tiles the (j,i) plane into BLOCK3_Y x BLOCK3_X
+   columns and walks k inside each column, keeping 3 tile-planes hot.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _SOR3D_H_
+#define _SOR3D_H_
+
+#include <string.h>
+
+#include "sor_mt.h"
+
+typedef struct {
+    long int nx, ny, nz;       /* points per dimension, ghosts included */
+    long int pitch_y;          /* elements between (i,j,k) and (i,j+1,k) */
+    long int pitch_z;          /* elements between (i,j,k) and (i,j,k+1) */
+    data_t *data;
+} arr3_rec, *arr3_ptr;
+
+long int BLOCK3_Y = 16;        /* SOR3d_blocked() column shape: 3 planes */
+long int BLOCK3_X = 64;        /* of 16x64 doubles = 24 KB, L1/L2 sized */
+
+arr3_ptr new_array3(long int nx, long int ny, long int nz);
+void free_array3(arr3_ptr v);
+int set_arr3_dims(arr3_ptr v, long int nx, long int ny, long int nz);
+int init_array3_rand(arr3_ptr v, long int n);
+double SOR3d_residual(arr3_ptr v);
+void SOR3d(arr3_ptr v, int *iterations);
+void SOR3d_redblack(arr3_ptr v, int *iterations);
+void SOR3d_blocked(arr3_ptr v, int *iterations);
+void SOR3d_threaded(arr3_ptr v, int num_threads, int *iterations);
+
+static long int arr3_pitch_y(long int nx) { return (nx + 7) & ~7L; }
+
+static long int arr3_pitch_z(long int nx, long int ny)
+{
+    long int pz = arr3_pitch_y(nx) * ny;
+    if ((pz * (long int)sizeof(data_t)) % 4096 == 0) pz += 8;
+    return pz;
+}
+
+/* Capacity for nx*ny*nz; set_arr3_dims() may later shrink the dims */
+arr3_ptr new_array3(long int nx, long int ny, long int nz)
+{
+    arr3_ptr result = (arr3_ptr)malloc(sizeof(arr3_rec));
+    if (!result) return NULL;
+    set_arr3_dims(result, nx, ny, nz);
+    result->data = (data_t *)calloc(result->pitch_z * nz, sizeof(data_t));
+    if (!result->data) {
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+void free_array3(arr3_ptr v)
+{
+    if (!v) return;
+    free(v->data);
+    free(v);
+}
+
+int set_arr3_dims(arr3_ptr v, long int nx, long int ny, long int nz)
+{
+    v->nx = nx;
+    v->ny = ny;
+    v->nz = nz;
+    v->pitch_y = arr3_pitch_y(nx);
+    v->pitch_z = arr3_pitch_z(nx, ny);
+    return 1;
+}
+
+/* n^3 grid of random values in [MINVAL, MAXVAL], reproducible per n */
+int init_array3_rand(arr3_ptr v, long int n)
+{
+    set_arr3_dims(v, n, n, n);
+    crng_fill_rows(v->data, n * n, n, v->pitch_y, n, v->pitch_z, (uint64_t)n, MINVAL, MAXVAL);
+    return 1;
+}
+
+/* One point update; returns |change| */
+static inline double SOR3d_point(data_t *p, long int py, long int pz, double omega)
+{
+    double change = *p - (1.0 / 6.0) * (p[-1] + p[1] + p[-py] + p[py] + p[-pz] + p[pz]);
+    *p -= change * omega;
+    return fabs(change);
+}
+
+/* Mean |change| of a further sweep, without modifying the grid */
+KERNEL_CLONES
+double SOR3d_residual(arr3_ptr v)
+{
+    long int py = v->pitch_y, pz = v->pitch_z;
+    double total_change = 0;
+
+    for (long int k = 1; k < v->nz - 1; k++) {
+        for (long int j = 1; j < v->ny - 1; j++) {
+            data_t *p = v->data + k * pz + j * py;
+            for (long int i = 1; i < v->nx - 1; i++) {
+                total_change += fabs(p[i] - (1.0 / 6.0) * (p[i - 1] + p[i + 1] + p[i - py] +
+                                                          p[i + py] + p[i - pz] + p[i + pz]));
+            }
+        }
+    }
+    return total_change / (double)(v->nx * v->ny * v->nz);
+}
+
+/* Standard 3D SOR, lexicographic k, j, i order */
+KERNEL_CLONES
+void SOR3d(arr3_ptr v, int *iterations)
+{
+    long int py = v->pitch_y, pz = v->pitch_z;
+    double points = (double)(v->nx * v->ny * v->nz);
+    const double omega = OMEGA, tol = TOL;
+    double total_change = 1.0e10;
+    int iters = 0;
+
+    while ((total_change / points) > tol) {
+        iters++;
+        total_change = 0;
+        for (long int k = 1; k < v->nz - 1; k++) {
+            for (long int j = 1; j < v->ny - 1; j++) {
+                data_t *p = v->data + k * pz + j * py;
+                for (long int i = 1; i < v->nx - 1; i++) {
+                    total_change += SOR3d_point(p + i, py, pz, omega);
+                }
+            }
+        }
+    }
+    *iterations = iters;
+}
+
+/* 3D red/black: colour is the parity of i+j+k; full sweep = red + black */
+KERNEL_CLONES
+void SOR3d_redblack(arr3_ptr v, int *iterations)
+{
+    long int py = v->pitch_y, pz = v->pitch_z;
+    double points = (double)(v->nx * v->ny * v->nz);
+    const double omega = OMEGA, tol = TOL;
+    double total_change = 1.0e10;
+    int iters = 0;
+
+    while ((total_change / points) > tol) {
+        iters++;
+        total_change = 0;
+        for (int redblack = 0; redblack < 2; redblack++) {
+            for (long int k = 1; k < v->nz - 1; k++) {
+                for (long int j = 1; j < v->ny - 1; j++) {
+                    data_t *p = v->data + k * pz + j * py;
+                    for (long int i = 1 + ((j + k + redblack) & 1); i < v->nx - 1; i += 2) {
+                        total_change += SOR3d_point(p + i, py, pz, omega);
+                    }
+                }
+            }
+        }
+    }
+    *iterations = iters;
+}
+
+/* 3D SOR tiled in (j,i), streaming k inside each tile column */
+KERNEL_CLONES
+void SOR3d_blocked(arr3_ptr v, int *iterations)
+{
+    long int py = v->pitch_y, pz = v->pitch_z;
+    long int nx = v->nx, ny = v->ny, nz = v->nz;
+    const long int by = BLOCK3_Y, bx = BLOCK3_X;
+    double points = (double)(nx * ny * nz);
+    const double omega = OMEGA, tol = TOL;
+    double total_change = 1.0e10;
+    int iters = 0;
+
+    if (by < 1 || bx < 1) {
+        fprintf(stderr, "SOR3d_blocked: block shape %ldx%ld is invalid\n", by, bx);
+        exit(-1);
+    }
+
+    while ((total_change / points) > tol) {
+        iters++;
+        total_change = 0;
+        for (long int jj = 1; jj < ny - 1; jj += by) {
+            long int jend = (jj + by < ny - 1) ? jj + by : ny - 1;
+            for (long int ii = 1; ii < nx - 1; ii += bx) {
+                long int iend = (ii + bx < nx - 1) ? ii + bx : nx - 1;
+                for (long int k = 1; k < nz - 1; k++) {
+                    for (long int j = jj; j < jend; j++) {
+                        data_t *p = v->data + k * pz + j * py;
+                        for (long int i = ii; i < iend; i++) {
+                            total_change += SOR3d_point(p + i, py, pz, omega);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    *iterations = iters;
+}
+
+/* Threaded 3D SOR: each thread owns a slab of interior planes */
+typedef struct {
+    thread_data_t td;          /* td.start_row/end_row are plane indices */
+    arr3_ptr g;
+} thread3_data_t;
+
+KERNEL_CLONES
+static void *SOR3d_thread_slab(void *arg)
+{
+    thread3_data_t *data = (thread3_data_t *)arg;
+    arr3_ptr v = data->g;
+    long int py = v->pitch_y, pz = v->pitch_z;
+    double points = (double)(v->nx * v->ny * v->nz);
+    const double omega = OMEGA, tol = TOL;
+    double total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        for (long int k = data->td.start_row; k < data->td.end_row; k++) {
+            for (long int j = 1; j < v->ny - 1; j++) {
+                data_t *p = v->data + k * pz + j * py;
+                for (long int i = 1; i < v->nx - 1; i++) {
+                    total_change += SOR3d_point(p + i, py, pz, omega);
+                }
+            }
+        }
+        total_change = SOR_reduce_change(&data->td, total_change);
+    } while ((total_change / points) > tol);
+
+    data->td.iterations = iters;
+    pthread_exit(NULL);
+}
+
+void SOR3d_threaded(arr3_ptr v, int num_threads, int *iterations)
+{
+    long int interior = v->nz - 2;
+    pthread_t threads[num_threads];
+    thread3_data_t thread_data[num_threads];
+    double partial_change[num_threads];
+
+    pthread_barrier_init(&barrier, NULL, num_threads);
+    for (int t = 0; t < num_threads; t++) {
+        memset(&thread_data[t], 0, sizeof(thread_data[t]));
+        thread_data[t].td.thread_id = t;
+        thread_data[t].td.num_threads = num_threads;
+        thread_data[t].td.start_row = 1 + (t * interior) / num_threads;
+        thread_data[t].td.end_row = 1 + ((t + 1) * interior) / num_threads;
+        thread_data[t].td.partial_change = partial_change;
+        thread_data[t].g = v;
+        if (pthread_create(&threads[t], NULL, SOR3d_thread_slab, &thread_data[t])) {
+            printf("ERROR; SOR3d_threaded could not create thread %d\n", t);
+            exit(-1);
+        }
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    *iterations = thread_data[0].td.iterations;
+}
+
+#endif /* _SOR3D_H_ */
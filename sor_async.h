@@ -0,0 +1,255 @@
+/* Asynchronous ("chaotic") relaxation: strip SOR without per-sweep
+   barriers.
+
+   SOR_thread_strip() meets at a barrier every sweep, so the slowest core
+   (or a descheduled thread on an oversubscribed machine) paces all of
+   them. Here every thread sweeps its strip again as soon as it finishes,
+   using whatever values its neighbours' edge rows hold at that moment.
+   Chaotic relaxation of the Laplace system converges for these strip
+   updates, usually in a similar number of sweeps per thread. Halo rows
+   are the only data two threads share; they are read, and a strip's
+   first and last rows are written, with relaxed atomics, so the races
+   are defined behaviour and cost nothing on x86.
+
+   Termination is detected without a barrier. After each sweep a thread
+   publishes its completed sweep count and its strip's sum|change|, then
+   runs a two-wave check over all the published slots:
+
+     candidate   the published residuals add up to at most TOL rowlen^2;
+                 remember every thread's sweep count
+     confirm     every thread has finished a sweep since the candidate,
+                 so all residuals are re-measured, and the sum still
+                 meets the bound; set the shared stop flag
+
+   If the sum goes over the bound again, the candidate is dropped. Any
+   thread can confirm, so there is no coordinator. A thread whose own
+   strip is already under its share of the bound yields after its sweep,
+   handing the core to threads that still have work.
+
+   Staleness is bounded: a thread more than ASYNC_MAX_LAG sweeps ahead of
+   a neighbour yields until the neighbour catches up. Sweeping again on
+   a halo that has not changed is wasted work. On an oversubscribed core
+   this is what the thread would otherwise do for a whole timeslice. The
+   thread with the fewest sweeps never waits, so this cannot deadlock.
+
+   Per-thread sweep counts and halo staleness (how many sweeps a
+   neighbour was ahead of or behind this thread when its edge row was read)
+   are kept in sor_async_stats after each run.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _SOR_ASYNC_H_
+#define _SOR_ASYNC_H_
+
+#include <sched.h>
+#include <string.h>
+
+#include "sor_mt.h"
+
+#define ASYNC_MAX_THREADS 64
+
+int ASYNC_MAX_SWEEPS = 1000000;     /* guard against a diverging setup */
+int ASYNC_MAX_LAG = 4;              /* sweeps ahead of a neighbour before yielding; 0 = unbounded */
+
+typedef struct {
+    int threads;
+    int sweeps[ASYNC_MAX_THREADS];
+    double stale_mean[ASYNC_MAX_THREADS];   /* mean |sweep lag| of halo reads */
+    int stale_max[ASYNC_MAX_THREADS];
+} async_stats;
+
+async_stats sor_async_stats;        /* filled by the last SOR_async() */
+
+void SOR_async(arr_ptr v, int num_threads, int *iterations);
+void SOR_async_report(FILE *fp);
+
+/* Published per thread; one cache line each */
+typedef struct {
+    int sweeps;                     /* completed sweeps */
+    double change;                  /* sum|change| of the last one */
+} __attribute__((aligned(64))) async_slot;
+
+typedef struct {
+    thread_data_t td;
+    async_slot *slots;
+    int *stop;
+    double stale_sum;
+    long int stale_n;
+    int stale_max;
+} async_data_t;
+
+static inline double async_load(const data_t *p)
+{
+    data_t x;
+    __atomic_load(p, &x, __ATOMIC_RELAXED);
+    return x;
+}
+
+static inline void async_store(data_t *p, data_t x)
+{
+    __atomic_store(p, &x, __ATOMIC_RELAXED);
+}
+
+/* Row i of the strip. halo_n / halo_s: the row above / below belongs to
+   another thread; shared: this row is another thread's halo. The flags
+   are literals at the call sites. */
+static inline __attribute__((always_inline))
+double async_row(data_t *data, long int rowlen, long int i, double omega,
+                 int halo_n, int halo_s, int shared)
+{
+    data_t *c = data + i * rowlen, *n = c - rowlen, *s = c + rowlen;
+    double change, total_change = 0;
+
+    for (long int j = 1; j < rowlen - 1; j++) {
+        double nv = halo_n ? async_load(n + j) : n[j];
+        double sv = halo_s ? async_load(s + j) : s[j];
+        change = c[j] - 0.25 * (nv + sv + c[j + 1] + c[j - 1]);
+        if (shared) async_store(c + j, c[j] - change * omega);
+        else c[j] -= change * omega;
+        total_change += fabs(change);
+    }
+    return total_change;
+}
+
+/* Yield while neighbour t is more than max_lag sweeps behind */
+static void async_throttle(async_data_t *data, int t, int mine, int max_lag)
+{
+    if (max_lag <= 0 || t < 0 || t >= data->td.num_threads) return;
+    while (mine - __atomic_load_n(&data->slots[t].sweeps, __ATOMIC_ACQUIRE) > max_lag &&
+           !__atomic_load_n(data->stop, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+/* Staleness sample: sweeps between us and neighbour t */
+static void async_sample(async_data_t *data, int t, int mine)
+{
+    int lag;
+
+    if (t < 0 || t >= data->td.num_threads) return;
+    lag = mine - __atomic_load_n(&data->slots[t].sweeps, __ATOMIC_RELAXED);
+    if (lag < 0) lag = -lag;
+    data->stale_sum += lag;
+    data->stale_n++;
+    if (lag > data->stale_max) data->stale_max = lag;
+}
+
+KERNEL_CLONES
+static void *SOR_async_thread(void *arg)
+{
+    async_data_t *data = (async_data_t *)arg;
+    int me = data->td.thread_id, nt = data->td.num_threads;
+    long int rowlen = data->td.v->rowlen;
+    long int i0 = data->td.start_row, i1 = data->td.end_row;
+    data_t *u = data->td.v->data;
+    const double omega = OMEGA, bound = TOL * rowlen * rowlen;
+    const int max_lag = ASYNC_MAX_LAG;
+    int snapshot[ASYNC_MAX_THREADS], candidate = 0;
+    double change;
+    int iters = 0;
+
+    while (!__atomic_load_n(data->stop, __ATOMIC_ACQUIRE)) {
+        async_throttle(data, me - 1, iters, max_lag);
+        async_throttle(data, me + 1, iters, max_lag);
+        async_sample(data, me - 1, iters);
+        async_sample(data, me + 1, iters);
+        change = async_row(u, rowlen, i0, omega, 1, i1 - i0 == 1, 1);
+        for (long int i = i0 + 1; i < i1 - 1; i++)
+            change += async_row(u, rowlen, i, omega, 0, 0, 0);
+        if (i1 - i0 > 1) change += async_row(u, rowlen, i1 - 1, omega, 0, 1, 1);
+        iters++;
+
+        async_store(&data->slots[me].change, change);
+        __atomic_store_n(&data->slots[me].sweeps, iters, __ATOMIC_RELEASE);
+
+        /* Two-wave termination check over the published slots */
+        double sum = 0;
+        int sweeps[ASYNC_MAX_THREADS], fresh = 1;
+        for (int t = 0; t < nt; t++) {
+            sweeps[t] = __atomic_load_n(&data->slots[t].sweeps, __ATOMIC_ACQUIRE);
+            sum += async_load(&data->slots[t].change);
+            if (sweeps[t] == 0 || (candidate && sweeps[t] <= snapshot[t])) fresh = 0;
+        }
+        if (sum > bound) {
+            candidate = 0;
+        } else if (!candidate) {
+            memcpy(snapshot, sweeps, nt * sizeof(int));
+            candidate = 1;
+        } else if (fresh) {
+            __atomic_store_n(data->stop, 1, __ATOMIC_RELEASE);
+        }
+        if (iters >= ASYNC_MAX_SWEEPS) __atomic_store_n(data->stop, 1, __ATOMIC_RELEASE);
+        if (change * nt <= bound) sched_yield();
+    }
+
+    data->td.iterations = iters;
+    pthread_exit(NULL);
+}
+
+/* Asynchronous SOR on v; *iterations is the mean sweep count per thread */
+void SOR_async(arr_ptr v, int num_threads, int *iterations)
+{
+    long int interior = v->rowlen - 2;
+    pthread_t threads[ASYNC_MAX_THREADS];
+    async_data_t thread_data[ASYNC_MAX_THREADS];
+    async_slot *slots;
+    int stop = 0;
+    long int total = 0;
+
+    if (num_threads < 1 || num_threads > ASYNC_MAX_THREADS || num_threads > interior) {
+        fprintf(stderr, "SOR_async: %d threads for %ld rows is invalid\n", num_threads, interior);
+        exit(-1);
+    }
+    if (posix_memalign((void **)&slots, 64, num_threads * sizeof(async_slot))) {
+        fprintf(stderr, "SOR_async: could not allocate thread slots\n");
+        exit(-1);
+    }
+    memset(slots, 0, num_threads * sizeof(async_slot));
+
+    for (int t = 0; t < num_threads; t++) {
+        memset(&thread_data[t], 0, sizeof(thread_data[t]));
+        thread_data[t].td.thread_id = t;
+        thread_data[t].td.num_threads = num_threads;
+        thread_data[t].td.v = v;
+        thread_data[t].td.start_row = 1 + (t * interior) / num_threads;
+        thread_data[t].td.end_row = 1 + ((t + 1) * interior) / num_threads;
+        thread_data[t].slots = slots;
+        thread_data[t].stop = &stop;
+        if (pthread_create(&threads[t], NULL, SOR_async_thread, &thread_data[t])) {
+            printf("ERROR; SOR_async could not create thread %d\n", t);
+            exit(-1);
+        }
+    }
+    sor_async_stats.threads = num_threads;
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+        sor_async_stats.sweeps[t] = thread_data[t].td.iterations;
+        sor_async_stats.stale_mean[t] = thread_data[t].stale_n
+            ? thread_data[t].stale_sum / thread_data[t].stale_n : 0.0;
+        sor_async_stats.stale_max[t] = thread_data[t].stale_max;
+        total += thread_data[t].td.iterations;
+    }
+    free(slots);
+    *iterations = (int)(total / num_threads);
+}
+
+/* One line: sweeps per thread and halo staleness of the last run */
+void SOR_async_report(FILE *fp)
+{
+    const async_stats *st = &sor_async_stats;
+    int lo = st->sweeps[0], hi = st->sweeps[0], stale_max = 0;
+    double stale = 0;
+
+    for (int t = 0; t < st->threads; t++) {
+        if (st->sweeps[t] < lo) lo = st->sweeps[t];
+        if (st->sweeps[t] > hi) hi = st->sweeps[t];
+        if (st->stale_max[t] > stale_max) stale_max = st->stale_max[t];
+        stale += st->stale_mean[t] / st->threads;
+    }
+    fprintf(fp, "  async: sweeps per thread");
+    for (int t = 0; t < st->threads; t++) fprintf(fp, " %d", st->sweeps[t]);
+    fprintf(fp, " (min %d, max %d); staleness mean %.2f, max %d sweeps\n",
+            lo, hi, stale, stale_max);
+}
+
+#endif /* _SOR_ASYNC_H_ */
@@ -0,0 +1,138 @@
+/* Batched SOR: SOR_BATCH_LANES independent grids of the same size solved
+   together, one grid per SIMD lane.
+
+   Small grids (32..256) are too small to thread and their row loops too
+   short to vectorize well, but a batch of them is not. The grids are
+   interleaved structure-of-arrays style, point (i,j) of lane l at
+
+       data[(i*rowlen + j)*SOR_BATCH_LANES + l]
+
+   so the innermost loop runs across lanes with unit stride, every lane
+   doing exactly the SOR() update in the same order. Each lane has its own
+   omega (an OMEGA sweep can put one omega value per lane) and its own
+   convergence test; a converged lane gets a zero relaxation weight so it
+   stops changing while the others finish. Per-lane results are bitwise
+   identical to running SOR() on each grid.
+
+   Header-only; include after sor.h from one .c file.
+*/
+
+#ifndef _SOR_BATCH_H_
+#define _SOR_BATCH_H_
+
+#include "sor.h"
+
+#define SOR_BATCH_LANES 8   /* one AVX-512 vector, two AVX2 / four SSE2 */
+
+/* All lanes of a point; each KERNEL_CLONES body lowers the operations to
+   its widest registers (the lane loop written out does not vectorize at
+   -O2) */
+typedef double batch_vec __attribute__((vector_size(SOR_BATCH_LANES * sizeof(double))));
+typedef uint64_t batch_bits __attribute__((vector_size(SOR_BATCH_LANES * sizeof(double))));
+
+typedef struct {
+    long int rowlen;
+    double omega[SOR_BATCH_LANES];   /* per-lane relaxation parameter */
+    data_t *data;
+} batch_rec, *batch_ptr;
+
+batch_ptr new_batch(long int row_len);
+void free_batch(batch_ptr b);
+void batch_load(batch_ptr b, int lane, arr_ptr v);
+void batch_store(batch_ptr b, int lane, arr_ptr v);
+void SOR_batch(batch_ptr b, int *iterations);
+
+/* Capacity is row_len^2 points per lane; rowlen may later be lowered */
+batch_ptr new_batch(long int row_len)
+{
+    batch_ptr result = (batch_ptr)malloc(sizeof(batch_rec));
+    if (!result) return NULL;
+    result->rowlen = row_len;
+    for (int l = 0; l < SOR_BATCH_LANES; l++) result->omega[l] = OMEGA;
+    result->data = (data_t *)calloc(row_len * row_len * SOR_BATCH_LANES, sizeof(data_t));
+    if (!result->data) {
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+void free_batch(batch_ptr b)
+{
+    if (!b) return;
+    free(b->data);
+    free(b);
+}
+
+/* Copy grid v into lane (sets the batch rowlen to v's) */
+void batch_load(batch_ptr b, int lane, arr_ptr v)
+{
+    long int n = get_arr_rowlen(v) * get_arr_rowlen(v);
+    data_t *src = get_array_start(v);
+
+    b->rowlen = get_arr_rowlen(v);
+    for (long int p = 0; p < n; p++) b->data[p * SOR_BATCH_LANES + lane] = src[p];
+}
+
+/* Copy lane back out into grid v */
+void batch_store(batch_ptr b, int lane, arr_ptr v)
+{
+    long int n = b->rowlen * b->rowlen;
+    data_t *dst = get_array_start(v);
+
+    set_arr_rowlen(v, b->rowlen);
+    for (long int p = 0; p < n; p++) dst[p] = b->data[p * SOR_BATCH_LANES + lane];
+}
+
+/* SOR on every lane; iterations[l] gets lane l's sweep count */
+KERNEL_CLONES
+void SOR_batch(batch_ptr b, int *iterations)
+{
+    const int L = SOR_BATCH_LANES;
+    long int rowlen = b->rowlen;
+    long int rowL = rowlen * L;
+    data_t *data = b->data;
+    const double tol = TOL;
+    const batch_bits absmask = (batch_bits){0} + 0x7fffffffffffffffULL;
+    batch_vec weight;                      /* omega while active, else 0 */
+    batch_vec total_change;
+    int done[SOR_BATCH_LANES];
+    int active = L, iters = 0;
+
+    for (int l = 0; l < L; l++) {
+        weight[l] = b->omega[l];
+        done[l] = 0;
+        iterations[l] = 0;
+    }
+
+    while (active) {
+        iters++;
+        total_change = (batch_vec){0};
+        for (long int i = 1; i < rowlen - 1; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                data_t *p = data + (i * rowlen + j) * L;
+                batch_vec c, n, s, e, w, change;
+
+                __builtin_memcpy(&c, p, sizeof(c));
+                __builtin_memcpy(&n, p - rowL, sizeof(n));
+                __builtin_memcpy(&s, p + rowL, sizeof(s));
+                __builtin_memcpy(&e, p + L, sizeof(e));
+                __builtin_memcpy(&w, p - L, sizeof(w));
+                change = c - 0.25 * (n + s + e + w);
+                c -= change * weight;
+                __builtin_memcpy(p, &c, sizeof(c));
+                total_change += (batch_vec)((batch_bits)change & absmask);
+            }
+        }
+        for (int l = 0; l < L; l++) {
+            if (!done[l] && total_change[l] / (rowlen * rowlen) <= tol) {
+                weight[l] = 0.0;
+                done[l] = 1;
+                iterations[l] = iters;
+                active--;
+            }
+        }
+    }
+}
+
+#endif /* _SOR_BATCH_H_ */
@@ -0,0 +1,809 @@
+/****************************************************************************
+   Compilation Command:
+   gcc -pthread -O2 -std=gnu11 sor_bench.c -lm -lrt -o sor_bench
+
+   Unified benchmark driver: runs any registered kernel over a list of grid
+   sizes and thread counts chosen on the command line, so scaling sweeps do
+   not need a recompile.
+
+     sor_bench [options]
+       -k list    kernels, comma separated, or "all"   (default SOR)
+       -n list    interior grid sizes n; the grid is n+GHOST square for
+                  SOR kernels and n square for pt_cb_*  (default 32,56,96,152,224)
+       -N list    interior sizes for SOR3d*, grid n+GHOST cubed; -n does
+                  not change these                      (default 14,30,46,62,94,126)
+       -t list    thread counts for threaded kernels    (default 4);
+                  process counts for SOR_dd
+       -w omega   relaxation parameter                  (default 1.75)
+       -e tol     convergence tolerance                 (default 1e-5)
+       -b RxC     SOR_blocked() tile shape              (default 8x8)
+       -B YxX     SOR3d_blocked() tile shape (j by i)   (default 16x64)
+       -d k       SOR*_deferred() residual every k sweeps, 0 = adaptive (default 0)
+       -c n       SOR_thread_cyclic() chunk height in rows (default 8)
+       -D n       SOR_tasks() iterations in flight      (default 3)
+       -J w       Jacobi weight                         (default 1.0)
+       -P w       PCG SSOR/red-black preconditioner omega (default 1.5)
+       -L w       SOR_line*() omega, 0 = optimal for the size (default 0)
+       -C n       SOR_sell*() sorting window sigma, rows; 1 = no sort,
+                  else rounded up to a multiple of 8    (default 256)
+       -r n       timed repeats                         (default BENCH_REPEATS or 5)
+       -W n       untimed warmup runs                   (default BENCH_WARMUP or 1)
+       -o path    write CSV results (see bench_harness.h)
+       -j path    write JSON results
+       -R         roofline report: GFLOP/s, GB/s and fraction of the
+                  host roofline bound (runs the probes in roofline.h)
+       -S path    save results as this machine's baseline in path; a
+                  missing file is created
+       -G path    regression gate: compare against the baseline in path and
+                  exit non-zero if anything is slower than allowed; the
+                  file must exist (run -S first), and a result with no
+                  row for this machine key is a failure too
+       -T pct     minimum slowdown that counts as a regression (default 10)
+       -K k       noise multiplier on the combined stddev     (default 3)
+       -I frac    allowed relative iteration-count difference from SOR()
+                  for the numerics check                      (default 0.5)
+       -s n       snapshot the grid every n sweeps (serial 2D SOR kernels)
+                  from a background writer, see snapshot.h
+       -F fmt     snapshot format, raw or pgm           (default raw)
+       -p prefix  snapshot file prefix                  (default snap)
+       -x prefix  trace each threaded run's last repeat (trace.h): write
+                  <prefix>_<kernel>_<size>_t<threads>.json (Chrome trace)
+                  and _iters.csv, and print the imbalance summary
+       -l         list kernels and exit
+
+   With -S or -G every SOR kernel result is also checked against SOR()
+   (SOR3d() for 3D) on the same starting grid: its iteration count must be
+   within -I of SOR's (SOR-type kernels only; Jacobi, PCG and the red/black
+   SOR_dd and SOR3d_redblack count differently) and its final residual no
+   worse than 10x SOR's (or TOL). A kernel that fails the check is a
+   failure and is never saved as a baseline.
+
+   The Stencil* kernels run SOR_stencil() (stencil.h). Stencil5 solves the
+   same Laplace problem as SOR() and must match SOR_blocked(). The
+   others add a smooth source term, and Stencil5_var also adds a
+   variable conductivity. Their numerics check compares against the same
+   problem solved with the general per-point path (STENCIL_FAST = 0).
+
+   The *_local kernels start from a localized disturbance instead of a
+   random grid (local_fill()): an already solved constant field with a
+   random patch an eighth of the side in the middle. SOR_blocked_local is
+   the reference there for SOR_blocked_active_local.
+
+   The SOR_csr* and SOR_sell* kernels solve the same grid through
+   sor_sparse.h: grid_to_csr() and its red/black colouring (plus the
+   SELL copy) are built in the untimed setup, so the timings compare the
+   sparse formats with SOR_redblack() directly.
+
+   The default 3D sizes step the working set through the cache levels:
+   three 16^2 planes fit L1, 48^2..96^2 planes only L2, and 128^3 is past
+   a typical last-level cache.
+
+   Example:  ./sor_bench -k SOR_blocked,SOR_thread_strip -n 510,2046 -t 1,2,4,8
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_harness.h"
+#include "sor_mt.h"
+#include "sor3d.h"
+#include "sor_dd.h"
+#include "sor_async.h"
+#include "sor_tasks.h"
+#include "sor_batch.h"
+#include "sor_line.h"
+#include "sor_sparse.h"
+#include "stencil.h"
+#include "snapshot.h"
+#include "jacobi.h"
+#include "pcg.h"
+#include "pt_cb.h"
+#include "roofline.h"
+#include "bench_baseline.h"
+
+#define MAX_LIST 64  /* Max entries in a -n / -t / -k list */
+#define RESID_FACTOR 10.0  /* Allowed final residual vs. SOR()'s */
+
+/* Everything a kernel needs for one run */
+typedef struct {
+    arr_ptr v;               /* SOR grid, rowlen n+GHOST */
+    batch_ptr batch;         /* SOR_batch() lanes, same rowlen as v */
+    arr3_ptr v3;             /* SOR3d*() grid, n+GHOST cubed */
+    data_t *aux;             /* Stencil*: f, conductivity k, 5 coefficient arrays */
+    stencil_rec st;          /* Stencil*: the system last solved */
+    matrix_ptr a, b, c;      /* pt_cb_*() operands, rowlen n */
+    csr_ptr csr;             /* SOR_csr*() / SOR_sell*(): v as a sparse system */
+    colour_ptr colours;
+    sell_ptr sell;
+    long int n;
+    int threads;
+    int iters;
+} sor_job;
+
+typedef struct {
+    const char *name;
+    int threaded;            /* sweeps over the -t thread counts */
+    int uses_grid;           /* pt_cb matrices (0), 2D grid (1), 3D grid (2),
+                                2D grid plus stencil source/coefficients (3),
+                                2D grid with a local disturbance (4),
+                                2D grid as a sparse system (5) */
+    int sor_iters;           /* iteration count comparable to SOR()'s */
+    double flops_per_point;  /* per interior point per sweep, see roofline.h */
+    double bytes_per_point;
+    void (*run)(sor_job *job);
+} kernel_desc;
+
+void run_SOR(sor_job *job) { SOR(job->v, &job->iters); }
+void run_SOR_redblack(sor_job *job) { SOR_redblack(job->v, &job->iters); }
+void run_SOR_ji(sor_job *job) { SOR_ji(job->v, &job->iters); }
+void run_SOR_blocked(sor_job *job) { SOR_blocked(job->v, &job->iters); }
+void run_SOR_deferred(sor_job *job) { SOR_deferred(job->v, &job->iters); }
+void run_SOR_blocked_deferred(sor_job *job) { SOR_blocked_deferred(job->v, &job->iters); }
+void run_SOR_blocked_active(sor_job *job) { SOR_blocked_active(job->v, &job->iters); }
+void run_SOR_oblivious(sor_job *job) { SOR_oblivious(job->v, &job->iters); }
+void run_SOR_line(sor_job *job) { SOR_line(job->v, &job->iters); }
+void run_SOR_line_threaded(sor_job *job) { SOR_line_threaded(job->v, job->threads, &job->iters); }
+
+/* The sparse system's unknowns are the grid points, updated in place */
+void run_SOR_csr(sor_job *job) { SOR_csr(job->csr, job->colours, job->v->data, &job->iters); }
+void run_SOR_sell(sor_job *job) { SOR_sell(job->sell, job->v->data, &job->iters); }
+
+void run_SOR_csr_threaded(sor_job *job)
+{
+    SOR_csr_threaded(job->csr, job->colours, job->v->data, job->threads, &job->iters);
+}
+
+void run_SOR_sell_threaded(sor_job *job)
+{
+    SOR_sell_threaded(job->sell, job->v->data, job->threads, &job->iters);
+}
+
+/* Packs SOR_BATCH_LANES copies of the grid (packing is timed, as it would
+   be in production) and solves them together. Reports the per-lane mean
+   iteration count; work and time cover all lanes, see kernels[]. */
+void run_SOR_batch(sor_job *job)
+{
+    int lane_iters[SOR_BATCH_LANES];
+    long int sum = 0;
+
+    for (int l = 0; l < SOR_BATCH_LANES; l++) {
+        batch_load(job->batch, l, job->v);
+        job->batch->omega[l] = OMEGA;
+    }
+    SOR_batch(job->batch, lane_iters);
+    for (int l = 0; l < SOR_BATCH_LANES; l++) sum += lane_iters[l];
+    job->iters = (int)(sum / SOR_BATCH_LANES);
+    batch_store(job->batch, 0, job->v);
+}
+
+/* Stencil* problems; aux is filled by bench_case_setup() */
+void run_Stencil5(sor_job *job)
+{
+    stencil_laplace5(&job->st);
+    SOR_stencil(job->v, &job->st, &job->iters);
+}
+
+void run_Stencil5_f(sor_job *job)
+{
+    stencil_laplace5(&job->st);
+    stencil_set_source(&job->st, job->aux);
+    SOR_stencil(job->v, &job->st, &job->iters);
+}
+
+void run_Stencil9(sor_job *job)
+{
+    stencil_laplace9(&job->st);
+    stencil_set_source(&job->st, job->aux);
+    SOR_stencil(job->v, &job->st, &job->iters);
+}
+
+/* Building the face weights from k is timed, as it would be in production */
+void run_Stencil5_var(sor_job *job)
+{
+    long int rowlen = get_arr_rowlen(job->v), N = rowlen * rowlen;
+
+    stencil_set_diffusion(&job->st, job->aux + N, rowlen, job->aux + 2 * N);
+    stencil_set_source(&job->st, job->aux);
+    SOR_stencil(job->v, &job->st, &job->iters);
+}
+
+void run_SOR3d(sor_job *job) { SOR3d(job->v3, &job->iters); }
+void run_SOR3d_redblack(sor_job *job) { SOR3d_redblack(job->v3, &job->iters); }
+void run_SOR3d_blocked(sor_job *job) { SOR3d_blocked(job->v3, &job->iters); }
+
+void run_SOR3d_threaded(sor_job *job)
+{
+    SOR3d_threaded(job->v3, job->threads, &job->iters);
+}
+
+void run_SOR_thread_strip(sor_job *job)
+{
+    SOR_threaded(job->v, job->threads, SOR_thread_strip, &job->iters);
+}
+
+void run_SOR_thread_interleaved(sor_job *job)
+{
+    SOR_threaded(job->v, job->threads, SOR_thread_interleaved, &job->iters);
+}
+
+void run_SOR_thread_cyclic(sor_job *job)
+{
+    SOR_threaded(job->v, job->threads, SOR_thread_cyclic, &job->iters);
+}
+
+void run_SOR_tasks(sor_job *job)
+{
+    SOR_tasks(job->v, job->threads, &job->iters);
+}
+
+void run_SOR_async(sor_job *job)
+{
+    SOR_async(job->v, job->threads, &job->iters);
+}
+
+/* -t is the process count */
+void run_SOR_dd(sor_job *job)
+{
+    SOR_dd(job->v, job->threads, &job->iters);
+}
+
+void run_Jacobi(sor_job *job)
+{
+    Jacobi_threaded(job->v, job->threads, &job->iters);
+}
+
+void run_PCG(sor_job *job)
+{
+    PCG_threaded(job->v, job->threads, PCG_NONE, &job->iters);
+}
+
+void run_PCG_ssor(sor_job *job)
+{
+    PCG_threaded(job->v, job->threads, PCG_SSOR, &job->iters);
+}
+
+void run_PCG_rbsor(sor_job *job)
+{
+    PCG_threaded(job->v, job->threads, PCG_RBSOR, &job->iters);
+}
+
+void run_pt_cb_base(sor_job *job)
+{
+    pt_cb_base(job->a, job->b, job->c);
+    job->iters = 1;
+}
+
+void run_pt_cb_pthr(sor_job *job)
+{
+    NUM_THREADS = job->threads;
+    pt_cb_pthr(job->a, job->b, job->c);
+    job->iters = 1;
+}
+
+/* Kernel registry; add new kernels here */
+kernel_desc kernels[] = {
+    {"SOR",                    0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR},
+    {"SOR_redblack",           0, 1, 1, SOR_FLOPS_PER_POINT, SOR_RB_BYTES_PER_POINT, run_SOR_redblack},
+    {"SOR_ji",                 0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_ji},
+    {"SOR_blocked",            0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_blocked},
+    {"SOR_deferred",           0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_deferred},
+    {"SOR_blocked_deferred",   0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_blocked_deferred},
+    /* Skips converged tiles; the roofline rates count every tile */
+    {"SOR_blocked_active",     0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_blocked_active},
+    {"SOR_oblivious",          0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_oblivious},
+    /* Zebra line SOR needs a fraction of SOR()'s sweeps */
+    {"SOR_line",               0, 1, 0, LINE_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_line},
+    {"SOR_line_threaded",      1, 1, 0, LINE_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_line_threaded},
+    /* Red/black through the sparse formats: SOR_redblack()'s sweeps */
+    {"SOR_csr",                0, 5, 0, SPARSE_FLOPS_PER_POINT, CSR_BYTES_PER_POINT, run_SOR_csr},
+    {"SOR_sell",               0, 5, 0, SPARSE_FLOPS_PER_POINT, SELL_BYTES_PER_POINT, run_SOR_sell},
+    {"SOR_csr_threaded",       1, 5, 0, SPARSE_FLOPS_PER_POINT, CSR_BYTES_PER_POINT, run_SOR_csr_threaded},
+    {"SOR_sell_threaded",      1, 5, 0, SPARSE_FLOPS_PER_POINT, SELL_BYTES_PER_POINT, run_SOR_sell_threaded},
+    {"SOR_blocked_local",      0, 4, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_blocked},
+    {"SOR_blocked_active_local", 0, 4, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_blocked_active},
+    {"SOR_batch",              0, 1, 1, SOR_FLOPS_PER_POINT * SOR_BATCH_LANES,
+                                        SOR_BYTES_PER_POINT * SOR_BATCH_LANES, run_SOR_batch},
+    {"SOR_thread_strip",       1, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_thread_strip},
+    /* Rows dealt out one or a chunk at a time are swept as a multicolour
+       ordering when threads share a core, which can need ~2x SOR()'s sweeps */
+    {"SOR_thread_interleaved", 1, 1, 0, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_thread_interleaved},
+    {"SOR_thread_cyclic",      1, 1, 0, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_thread_cyclic},
+    {"SOR_tasks",              1, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_tasks},
+    {"SOR_async",              1, 1, 0, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR_async},
+    /* Red/black: same sweeps as SOR_redblack(), which can be >1.5x SOR()'s */
+    {"SOR_dd",                 1, 1, 0, SOR_FLOPS_PER_POINT, SOR_RB_BYTES_PER_POINT, run_SOR_dd},
+    {"Jacobi",                 1, 1, 0, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_Jacobi},
+    {"PCG",                    1, 1, 0, PCG_FLOPS_PER_POINT, PCG_BYTES_PER_POINT, run_PCG},
+    {"PCG_ssor",               1, 1, 0, PCG_FLOPS_PER_POINT + PCG_PRECOND_FLOPS_PER_POINT,
+                                        PCG_BYTES_PER_POINT + PCG_PRECOND_BYTES_PER_POINT, run_PCG_ssor},
+    {"PCG_rbsor",              1, 1, 0, PCG_FLOPS_PER_POINT + PCG_PRECOND_FLOPS_PER_POINT,
+                                        PCG_BYTES_PER_POINT + PCG_PRECOND_BYTES_PER_POINT, run_PCG_rbsor},
+    {"Stencil5",               0, 1, 1, SOR_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_Stencil5},
+    {"Stencil5_f",             0, 3, 0, SOR_FLOPS_PER_POINT + STENCIL_F_FLOPS_PER_POINT,
+                                        SOR_BYTES_PER_POINT + STENCIL_F_BYTES_PER_POINT, run_Stencil5_f},
+    {"Stencil9",               0, 3, 0, STENCIL9_FLOPS_PER_POINT + STENCIL_F_FLOPS_PER_POINT,
+                                        SOR_BYTES_PER_POINT + STENCIL_F_BYTES_PER_POINT, run_Stencil9},
+    {"Stencil5_var",           0, 3, 0, STENCIL_VAR_FLOPS_PER_POINT, STENCIL_VAR_BYTES_PER_POINT,
+                                        run_Stencil5_var},
+    {"SOR3d",                  0, 2, 1, SOR3D_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR3d},
+    /* 3D red/black sweeps differ from SOR3d()'s at the same omega: 0.85-2.2x
+       over the default sizes, so the count is not compared */
+    {"SOR3d_redblack",         0, 2, 0, SOR3D_FLOPS_PER_POINT, SOR_RB_BYTES_PER_POINT, run_SOR3d_redblack},
+    {"SOR3d_blocked",          0, 2, 1, SOR3D_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR3d_blocked},
+    {"SOR3d_threaded",         1, 2, 1, SOR3D_FLOPS_PER_POINT, SOR_BYTES_PER_POINT, run_SOR3d_threaded},
+    {"pt_cb_base",             0, 0, 0, CB_FLOPS_PER_ELEMENT, CB_BYTES_PER_ELEMENT, run_pt_cb_base},
+    {"pt_cb_pthr",             1, 0, 0, CB_FLOPS_PER_ELEMENT, CB_BYTES_PER_ELEMENT, run_pt_cb_pthr},
+};
+#define NUM_KERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+/* Stencil* data on a rowlen^2 grid over the unit square: source
+   f = h^2 2 pi^2 MAXVAL sin(pi x) sin(pi y), whose Laplace solution is
+   on the scale of the random starting grid, and conductivity
+   k = 1 + 0.5 sin(2 pi x) cos(2 pi y), in [0.5, 1.5] */
+void stencil_fill(data_t *aux, long int rowlen)
+{
+    long int N = rowlen * rowlen;
+    double h = 1.0 / (rowlen - 1);
+
+    for (long int i = 0; i < rowlen; i++) {
+        for (long int j = 0; j < rowlen; j++) {
+            double x = j * h, y = i * h;
+            aux[i * rowlen + j] = h * h * 2.0 * M_PI * M_PI * MAXVAL * sin(M_PI * x) * sin(M_PI * y);
+            aux[N + i * rowlen + j] = 1.0 + 0.5 * sin(2.0 * M_PI * x) * cos(2.0 * M_PI * y);
+        }
+    }
+}
+
+/* Localized disturbance on a rowlen^2 grid: the constant (MINVAL +
+   MAXVAL) / 2, which already solves the problem, except for a centred
+   patch of side rowlen / 8 that is uniform in [MINVAL, MAXVAL) */
+void local_fill(arr_ptr v, long int rowlen)
+{
+    long int side = rowlen / 8 > 1 ? rowlen / 8 : 1, p0 = (rowlen - side) / 2;
+    data_t *data = get_array_start(v);
+
+    for (long int p = 0; p < rowlen * rowlen; p++) data[p] = 0.5 * (MINVAL + MAXVAL);
+    crng_fill_rows(data + p0 * rowlen + p0, side, side, rowlen, side, 0,
+                   (uint64_t)rowlen, MINVAL, MAXVAL);
+    set_arr_rowlen(v, rowlen);
+}
+
+/* The CSR system, colouring and SELL copy for a rowlen^2 grid, rebuilt
+   only when the size changes */
+void sparse_setup(sor_job *job, long int rowlen)
+{
+    if (job->csr && job->csr->n == rowlen * rowlen) return;
+    free_sell(job->sell);
+    free_colours(job->colours);
+    free_csr(job->csr);
+    job->csr = grid_to_csr(rowlen);
+    job->colours = job->csr ? grid_colour_redblack(rowlen) : NULL;
+    job->sell = job->colours ? new_sell(job->csr, job->colours, SELL_SIGMA) : NULL;
+    if (!job->sell) {
+        fprintf(stderr, "could not build the sparse system for rowlen %ld\n", rowlen);
+        exit(-1);
+    }
+}
+
+/* bench_run() hooks */
+typedef struct {
+    const kernel_desc *k;
+    sor_job job;
+} bench_case;
+
+void bench_case_setup(void *arg)
+{
+    bench_case *bc = (bench_case *)arg;
+    long int n = bc->job.n;
+
+    if (TRACE) trace_reset(TRACE);     /* keep only the last run */
+    if (bc->k->uses_grid == 2) {
+        init_array3_rand(bc->job.v3, n + GHOST);
+    } else if (bc->k->uses_grid == 4) {
+        local_fill(bc->job.v, n + GHOST);
+    } else if (bc->k->uses_grid) {
+        init_array_rand(bc->job.v, n + GHOST);
+        set_arr_rowlen(bc->job.v, n + GHOST);
+        if (bc->k->uses_grid == 3) stencil_fill(bc->job.aux, n + GHOST);
+        if (bc->k->uses_grid == 5) sparse_setup(&bc->job, n + GHOST);
+    } else {
+        init_matrix_rand(bc->job.a, n);
+        set_matrix_rowlen(bc->job.b, n);
+        set_matrix_rowlen(bc->job.c, n);
+    }
+}
+
+void bench_case_run(void *arg)
+{
+    bench_case *bc = (bench_case *)arg;
+    bc->k->run(&bc->job);
+}
+
+/* A Stencil* kernel's iterations and final residual on the general
+   SOR_stencil() path, for checking the constant-coefficient fast paths */
+void stencil_reference_for(bench_case *bc, int *iters, double *residual)
+{
+    int fast = STENCIL_FAST;
+
+    STENCIL_FAST = 0;
+    bench_case_setup(bc);
+    bench_case_run(bc);
+    STENCIL_FAST = fast;
+    *iters = bc->job.iters;
+    *residual = stencil_residual(bc->job.v, &bc->job.st);
+}
+
+const kernel_desc *find_kernel(const char *name)
+{
+    for (int i = 0; i < NUM_KERNELS; i++) {
+        if (strcmp(kernels[i].name, name) == 0) return &kernels[i];
+    }
+    return NULL;
+}
+
+/* Parse "a,b,c" into out[]; returns the count, or -1 on a bad entry */
+int parse_long_list(const char *s, long int *out, int max)
+{
+    int count = 0;
+    char *end;
+
+    while (*s && count < max) {
+        out[count] = strtol(s, &end, 10);
+        if (end == s || out[count] <= 0) return -1;
+        count++;
+        if (*end == ',') end++;
+        else if (*end) return -1;
+        s = end;
+    }
+    return count;
+}
+
+/* SOR() (or SOR3d() for 3D kernels) iterations and final residual from
+   the kernel's starting grid for this size, computed once per size */
+void reference_for(sor_job *job, int dims, long int n, int *iters, double *residual)
+{
+    static long int ref_n[3 * MAX_LIST];
+    static int ref_dims[3 * MAX_LIST], ref_iters[3 * MAX_LIST], num_ref = 0;
+    static double ref_residual[3 * MAX_LIST];
+    int r;
+
+    for (r = 0; r < num_ref; r++) {
+        if (ref_n[r] == n && ref_dims[r] == dims) break;
+    }
+    if (r == num_ref) {
+        if (dims == 2) {
+            init_array3_rand(job->v3, n + GHOST);
+            SOR3d(job->v3, &ref_iters[r]);
+            ref_residual[r] = SOR3d_residual(job->v3);
+        } else {
+            if (dims == 4) {
+                local_fill(job->v, n + GHOST);
+            } else {
+                init_array_rand(job->v, n + GHOST);
+                set_arr_rowlen(job->v, n + GHOST);
+            }
+            SOR(job->v, &ref_iters[r]);
+            ref_residual[r] = SOR_residual(job->v);
+        }
+        ref_n[r] = n;
+        ref_dims[r] = dims;
+        num_ref++;
+    }
+    *iters = ref_iters[r];
+    *residual = ref_residual[r];
+}
+
+void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-k kernels|all] [-n sizes] [-N 3d sizes] [-t threads] [-w omega]\n"
+            "          [-e tol] [-b RxC] [-B YxX] [-c rows] [-d k] [-D depth] [-J weight]\n"
+            "          [-P omega] [-L omega] [-C sigma] [-r repeats] [-W warmup]\n"
+            "          [-o out.csv] [-j out.json] [-R] [-S baseline] [-G baseline]\n"
+            "          [-T pct] [-K k] [-I frac] [-s every] [-F raw|pgm] [-p prefix] [-x prefix] [-l]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[])
+{
+    const kernel_desc *sel[MAX_LIST];
+    long int sizes[MAX_LIST] = {32, 56, 96, 152, 224};
+    long int sizes3[MAX_LIST] = {14, 30, 46, 62, 94, 126};
+    long int threads[MAX_LIST] = {4};
+    int num_sel = 0, num_sizes = 5, num_sizes3 = 6, num_threads = 1;
+    const char *csv_path = getenv("BENCH_CSV"), *json_path = getenv("BENCH_JSON");
+    bench_cfg cfg = bench_cfg_from_env();
+    bench_out csv, json;
+    bench_stats st;
+    bench_case bc;
+    long int max_n = 0, max_n3 = 0, aux_len = 0;
+    char *kernel_list = NULL, *tok;
+    int roofline = 0;
+    const char *save_path = NULL, *gate_path = NULL;
+    double min_pct = 10.0, noise_k = 3.0, iter_tol = 0.5;
+    baseline_set baseline, gate;
+    baseline_rec now;
+    int failures = 0;
+    int snap_every = 0, snap_format = SNAP_RAW;
+    const char *snap_prefix = "snap";
+    snap_writer snap;
+    const char *trace_prefix = NULL;
+    trace_log trace;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:n:N:t:w:e:b:B:c:d:D:J:P:L:C:r:W:o:j:RS:G:T:K:I:s:F:p:x:lh")) != -1) {
+        switch (opt) {
+        case 'k': kernel_list = optarg; break;
+        case 'n':
+            if ((num_sizes = parse_long_list(optarg, sizes, MAX_LIST)) <= 0) usage(argv[0]);
+            break;
+        case 'N':
+            if ((num_sizes3 = parse_long_list(optarg, sizes3, MAX_LIST)) <= 0) usage(argv[0]);
+            break;
+        case 't':
+            if ((num_threads = parse_long_list(optarg, threads, MAX_LIST)) <= 0) usage(argv[0]);
+            break;
+        case 'w': OMEGA = atof(optarg); break;
+        case 'e': TOL = atof(optarg); break;
+        case 'b':
+            if (sscanf(optarg, "%ldx%ld", &BLOCK_ROWS, &BLOCK_COLS) != 2) usage(argv[0]);
+            break;
+        case 'B':
+            if (sscanf(optarg, "%ldx%ld", &BLOCK3_Y, &BLOCK3_X) != 2) usage(argv[0]);
+            break;
+        case 'c': SOR_CHUNK_ROWS = atol(optarg); break;
+        case 'd': RESID_EVERY = atoi(optarg); break;
+        case 'D': TASK_DEPTH = atoi(optarg); break;
+        case 'J': JACOBI_WEIGHT = atof(optarg); break;
+        case 'P': PCG_OMEGA = atof(optarg); break;
+        case 'L': LINE_OMEGA = atof(optarg); break;
+        case 'C': SELL_SIGMA = atol(optarg); break;
+        case 'r': cfg.repeats = atoi(optarg); break;
+        case 'W': cfg.warmup = atoi(optarg); break;
+        case 'o': csv_path = optarg; break;
+        case 'j': json_path = optarg; break;
+        case 'R': roofline = 1; break;
+        case 'S': save_path = optarg; break;
+        case 'G': gate_path = optarg; break;
+        case 'T': min_pct = atof(optarg); break;
+        case 'K': noise_k = atof(optarg); break;
+        case 'I': iter_tol = atof(optarg); break;
+        case 's': snap_every = atoi(optarg); break;
+        case 'F':
+            if (strcmp(optarg, "pgm") == 0) snap_format = SNAP_PGM;
+            else if (strcmp(optarg, "raw") == 0) snap_format = SNAP_RAW;
+            else usage(argv[0]);
+            break;
+        case 'p': snap_prefix = optarg; break;
+        case 'x': trace_prefix = optarg; break;
+        case 'l':
+            for (int i = 0; i < NUM_KERNELS; i++)
+                printf("%s%s\n", kernels[i].name, kernels[i].threaded ? " (threaded)" : "");
+            return 0;
+        default: usage(argv[0]);
+        }
+    }
+    if (cfg.repeats < 1 || cfg.repeats > BENCH_MAX_REPEATS || cfg.warmup < 0) usage(argv[0]);
+
+    if (!kernel_list || strcmp(kernel_list, "all") == 0) {
+        if (kernel_list) {
+            for (int i = 0; i < NUM_KERNELS; i++) sel[num_sel++] = &kernels[i];
+        } else {
+            sel[num_sel++] = find_kernel("SOR");
+        }
+    } else {
+        for (tok = strtok(kernel_list, ","); tok && num_sel < MAX_LIST; tok = strtok(NULL, ",")) {
+            if (!(sel[num_sel] = find_kernel(tok))) {
+                fprintf(stderr, "unknown kernel '%s' (use -l to list)\n", tok);
+                return EXIT_FAILURE;
+            }
+            num_sel++;
+        }
+    }
+
+    for (int s = 0; s < num_sizes; s++)
+        if (sizes[s] > max_n) max_n = sizes[s];
+    for (int k = 0; k < num_sel; k++) {
+        if (sel[k]->uses_grid != 2) continue;
+        for (int s = 0; s < num_sizes3; s++)
+            if (sizes3[s] > max_n3) max_n3 = sizes3[s];
+    }
+    bc.job.v3 = NULL;
+    if (max_n3 && !(bc.job.v3 = new_array3(max_n3 + GHOST, max_n3 + GHOST, max_n3 + GHOST))) {
+        fprintf(stderr, "could not allocate 3D grid for n = %ld\n", max_n3);
+        return EXIT_FAILURE;
+    }
+    for (int k = 0; k < num_sel; k++)
+        if (sel[k]->uses_grid == 3) aux_len = 7 * (max_n + GHOST) * (max_n + GHOST);
+    bc.job.aux = NULL;
+    if (aux_len && !(bc.job.aux = (data_t *)calloc(aux_len, sizeof(data_t)))) {
+        fprintf(stderr, "could not allocate stencil arrays for n = %ld\n", max_n);
+        return EXIT_FAILURE;
+    }
+    bc.job.v = new_array(max_n + GHOST);
+    bc.job.csr = NULL;
+    bc.job.colours = NULL;
+    bc.job.sell = NULL;
+    bc.job.batch = new_batch(max_n + GHOST);
+    bc.job.a = new_matrix(max_n);
+    bc.job.b = new_matrix(max_n);
+    bc.job.c = new_matrix(max_n);
+    if (!bc.job.v || !bc.job.batch || !bc.job.a || !bc.job.b || !bc.job.c) {
+        fprintf(stderr, "could not allocate grids for n = %ld\n", max_n);
+        return EXIT_FAILURE;
+    }
+    init_matrix_rand(bc.job.b, max_n);
+    zero_matrix(bc.job.c, max_n);
+    if (trace_prefix) {
+        long int max_threads = 1;
+        for (int t = 0; t < num_threads; t++)
+            if (threads[t] > max_threads) max_threads = threads[t];
+        if (!trace_open(&trace, (int)max_threads)) {
+            fprintf(stderr, "could not allocate trace rings for %ld threads\n", max_threads);
+            return EXIT_FAILURE;
+        }
+    }
+    if (snap_every && !snap_open(&snap, snap_prefix, snap_format, snap_every, max_n + GHOST)) {
+        fprintf(stderr, "could not set up snapshots every %d sweeps\n", snap_every);
+        return EXIT_FAILURE;
+    }
+
+    baseline_machine_key(now.machine, sizeof(now.machine));
+    if (!baseline_load(&baseline, save_path ? save_path : "/dev/null", 0) ||
+        !baseline_load(&gate, gate_path ? gate_path : "/dev/null", gate_path != NULL)) {
+        fprintf(stderr, "could not read baseline file\n");
+        return EXIT_FAILURE;
+    }
+    if (save_path || gate_path) printf("machine key: %s\n", now.machine);
+
+    bench_out_open(&csv, csv_path, BENCH_FMT_CSV);
+    bench_out_open(&json, json_path, BENCH_FMT_JSON);
+
+    if (roofline) {
+        for (int t = 0; t < num_threads; t++) {
+            printf("roofline, %ld threads: triad %.2f GB/s, peak %.2f GFLOP/s\n", threads[t],
+                   roof_stream_gbs((int)threads[t]), roof_peak_gflops((int)threads[t]));
+        }
+        printf("roofline, 1 thread: triad %.2f GB/s, peak %.2f GFLOP/s\n",
+               roof_stream_gbs(1), roof_peak_gflops(1));
+    }
+    cpu_dispatch_report(stdout);
+    if (max_n3) printf("3D block %ldx%ld\n", BLOCK3_Y, BLOCK3_X);
+    printf("OMEGA %.3f, TOL %g, block %ldx%ld, chunk %ld, warmup %d, repeats %d, TSC %.3f cycles/ns\n",
+           OMEGA, TOL, BLOCK_ROWS, BLOCK_COLS, SOR_CHUNK_ROWS, cfg.warmup, cfg.repeats, bench_cpns());
+    printf("kernel, size, threads, iters, median cycles, min cycles, stddev %%, rejected%s\n",
+           roofline ? ", GFLOP/s, GB/s, flops/byte, bound GFLOP/s, % of roof" : "");
+
+    for (int k = 0; k < num_sel; k++) {
+        bc.k = sel[k];
+        int dims = bc.k->uses_grid;
+        long int *sz = dims == 2 ? sizes3 : sizes;
+        for (int s = 0; s < (dims == 2 ? num_sizes3 : num_sizes); s++) {
+            long int grid = dims ? sz[s] + GHOST : sz[s];
+            for (int t = 0; t < (bc.k->threaded ? num_threads : 1); t++) {
+                bc.job.n = sz[s];
+                bc.job.threads = bc.k->threaded ? (int)threads[t] : 1;
+                if (snap_every) {
+                    char label[64];
+                    snprintf(label, sizeof(label), "%s_%ld_t%d", bc.k->name, grid, bc.job.threads);
+                    snap_label(&snap, label);
+                    SOR_HOOK = snap_offer;
+                    SOR_HOOK_ARG = &snap;
+                }
+                if (trace_prefix && bc.k->threaded) TRACE = &trace;
+                bench_run(&cfg, bench_case_setup, bench_case_run, &bc, &st);
+                SOR_HOOK = NULL;
+                printf("%s, %ld, %d, %d, %.4g, %.4g, %.1f, %d",
+                       bc.k->name, grid, bc.job.threads, bc.job.iters, st.cycles,
+                       st.min * 1.0e9 * bench_cpns(), 100.0 * st.stddev / st.median,
+                       st.rejected);
+                if (roofline) {
+                    /* pt_cb kernels report iters = 1, SOR kernels full sweeps */
+                    double points = (double)sz[s] * sz[s] * (dims == 2 ? sz[s] : 1) * bc.job.iters;
+                    double gflops = points * bc.k->flops_per_point / st.median * 1.0e-9;
+                    double gbs = points * bc.k->bytes_per_point / st.median * 1.0e-9;
+                    double ai = bc.k->flops_per_point / bc.k->bytes_per_point;
+                    printf(", %.3f, %.3f, %.3f, %.3f, %.1f", gflops, gbs, ai,
+                           roof_bound_gflops(ai, bc.job.threads),
+                           100.0 * roof_fraction(gflops, ai, bc.job.threads));
+                }
+                printf("\n");
+                if (bc.k->run == run_SOR_async) SOR_async_report(stdout);
+                if (snap_every) snap_report(&snap, stdout);
+                if (TRACE) {
+                    char path[256];
+                    FILE *fp;
+
+                    TRACE = NULL;
+                    snprintf(path, sizeof(path), "%s_%s_%ld_t%d_iters.csv", trace_prefix,
+                             bc.k->name, grid, bc.job.threads);
+                    fp = fopen(path, "w");
+                    trace_summary(&trace, stdout, fp);
+                    if (fp) fclose(fp);
+                    snprintf(path, sizeof(path), "%s_%s_%ld_t%d.json", trace_prefix,
+                             bc.k->name, grid, bc.job.threads);
+                    if (!trace_write_chrome(&trace, path))
+                        fprintf(stderr, "could not write trace %s\n", path);
+                }
+                fflush(stdout);
+
+                if (save_path || gate_path) {
+                    snprintf(now.kernel, sizeof(now.kernel), "%s", bc.k->name);
+                    now.size = grid;
+                    now.threads = bc.job.threads;
+                    now.median = st.median;
+                    now.stddev = st.stddev;
+                    now.iters = bc.job.iters;
+                    now.residual = dims == 3 ? stencil_residual(bc.job.v, &bc.job.st)
+                                 : dims == 2 ? SOR3d_residual(bc.job.v3)
+                                 : dims ? SOR_residual(bc.job.v) : 0.0;
+                    int ok = 1;
+
+                    if (dims) {
+                        int ref_iters;
+                        double ref_residual;
+                        if (dims == 3)
+                            stencil_reference_for(&bc, &ref_iters, &ref_residual);
+                        else
+                            reference_for(&bc.job, dims == 5 ? 1 : dims, sz[s], &ref_iters,
+                                          &ref_residual);
+                        if ((bc.k->sor_iters &&
+                             fabs((double)now.iters - ref_iters) > iter_tol * ref_iters) ||
+                            now.residual > fmax(RESID_FACTOR * ref_residual, TOL)) {
+                            printf("  NUMERICS FAIL %s n=%ld t=%d: %d iters, residual %.3g "
+                                   "(SOR: %d iters, residual %.3g)\n", now.kernel, grid,
+                                   now.threads, now.iters, now.residual, ref_iters, ref_residual);
+                            ok = 0;
+                            failures++;
+                        }
+                    }
+                    if (gate_path) {
+                        baseline_rec *base = baseline_find(&gate, now.machine, now.kernel,
+                                                           now.size, now.threads);
+                        double slowdown, limit;
+                        if (!base) {
+                            printf("  NO BASELINE %s n=%ld t=%d\n", now.kernel, grid, now.threads);
+                            failures++;
+                        } else if (baseline_regressed(base, &now, min_pct, noise_k, &slowdown, &limit)) {
+                            printf("  REGRESSION %s n=%ld t=%d: %+.1f%% (limit %.1f%%)\n",
+                                   now.kernel, grid, now.threads, 100.0 * slowdown, 100.0 * limit);
+                            failures++;
+                        } else {
+                            printf("  ok %s n=%ld t=%d: %+.1f%% (limit %.1f%%)\n",
+                                   now.kernel, grid, now.threads, 100.0 * slowdown, 100.0 * limit);
+                        }
+                    }
+                    if (save_path && ok) baseline_put(&baseline, &now);
+                }
+                bench_out_row(&csv, bc.k->name, grid, bc.job.threads, OMEGA, bc.job.iters, &st);
+                bench_out_row(&json, bc.k->name, grid, bc.job.threads, OMEGA, bc.job.iters, &st);
+            }
+        }
+    }
+
+    bench_out_close(&csv);
+    bench_out_close(&json);
+    if (save_path && !baseline_save(&baseline, save_path)) failures++;
+    baseline_free(&baseline);
+    baseline_free(&gate);
+    if (trace_prefix) trace_close(&trace);
+    if (snap_every) {
+        snap_close(&snap);      /* counters stay readable */
+        printf("  snapshots: %ld more written at exit, %ld failed\n", snap.written, snap.failed);
+    }
+    if (failures) printf("%d failure(s)\n", failures);
+    free_array(bc.job.v);
+    free_array3(bc.job.v3);
+    free(bc.job.aux);
+    free_batch(bc.job.batch);
+    free_sell(bc.job.sell);
+    free_colours(bc.job.colours);
+    free_csr(bc.job.csr);
+    free(bc.job.a->data); free(bc.job.a);
+    free(bc.job.b->data); free(bc.job.b);
+    free(bc.job.c->data); free(bc.job.c);
+    return failures ? EXIT_FAILURE : 0;
+}
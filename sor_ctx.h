@@ -0,0 +1,276 @@
+/* Reusable solver context: many solves, no allocation or thread creation
+   per solve.
+
+   The drivers build every solve from scratch: new_array(), an init, a
+   kernel that creates and joins its threads, and free. That is fine for
+   one large grid, but for thousands of small solves a second the
+   allocation and pthread_create() dominate. A sor_ctx owns everything a
+   solve needs, set up once by sor_ctx_create():
+
+     grid        room for grids up to max_n interior points a side
+     team        num_threads - 1 parked worker threads; the caller is
+                 thread 0, so one thread means no workers at all
+     scratch     one cache line per thread for the residual reduction
+     telemetry   solves, sweeps, time and the last residual (sor_ctx_stats)
+
+   sor_ctx_solve() then only copies (or generates) the starting grid,
+   releases the team with a barrier and runs strip SOR exactly as
+   SOR_thread_strip() does: same partition, same update order, same
+   thread-order reduction and convergence test. The result stays in the
+   context's grid (sor_ctx_grid()) unless the request names an output
+   array.
+
+   Warm start: for a sequence of related problems (the boundary drifts a
+   little between steps) set warm in the request. The solve then starts
+   from the grid the previous solve left, so only the change has to be
+   relaxed away. sor_ctx_set_boundary() rewrites just the ghost ring in
+   between. A warm request must keep the previous n.
+
+   A context is for one caller thread at a time; use one per service
+   thread.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _SOR_CTX_H_
+#define _SOR_CTX_H_
+
+#include <string.h>
+#include <time.h>
+
+#include "sor_mt.h"
+
+#define CTX_MAX_THREADS 64
+
+/* One solve. The grid is (n + GHOST)^2 including the boundary ring. */
+typedef struct {
+    long int n;                 /* interior points a side, <= max_n */
+    const data_t *init;         /* starting grid, or NULL to generate from seed */
+    uint64_t seed;              /* crng.h stream when init is NULL */
+    data_t *out;                /* copy the solution here, or NULL */
+    double omega, tol;          /* 0 = OMEGA / TOL */
+    int max_iters;              /* 0 = no limit */
+    int warm;                   /* start from the previous solution; init, seed ignored */
+} sor_request;
+
+typedef struct {
+    int iters;
+    double residual;            /* mean |change| of the last sweep */
+    double seconds;
+    int converged;
+} sor_result;
+
+typedef struct {
+    long int solves, sweeps;
+    double seconds;
+    double last_residual;
+} sor_ctx_stats;
+
+typedef struct {
+    double change;
+} __attribute__((aligned(64))) ctx_slot;
+
+typedef struct sor_ctx sor_ctx;
+
+typedef struct {
+    sor_ctx *ctx;
+    int id;
+} ctx_thread;
+
+struct sor_ctx {
+    long int max_n;
+    int num_threads;
+    arr_rec grid;
+    ctx_slot *slot;
+    pthread_t threads[CTX_MAX_THREADS];
+    ctx_thread args[CTX_MAX_THREADS];
+    pthread_barrier_t start, sweep;
+    int shutdown;
+    int have_grid;              /* the grid holds a solve or a boundary for grid.rowlen */
+    /* current solve, written by thread 0 before the start barrier */
+    const sor_request *req;
+    double omega, tol;
+    int iters;
+    double total_change;
+    sor_ctx_stats stats;
+};
+
+int sor_ctx_create(sor_ctx *ctx, long int max_n, int num_threads);
+int sor_ctx_solve(sor_ctx *ctx, const sor_request *req, sor_result *res);
+void sor_ctx_set_boundary(sor_ctx *ctx, long int n, const data_t *north, const data_t *south,
+                          const data_t *west, const data_t *east);
+arr_ptr sor_ctx_grid(sor_ctx *ctx);
+void sor_ctx_destroy(sor_ctx *ctx);
+
+/* Thread id's share of a solve: fill, then strip sweeps until converged */
+KERNEL_CLONES
+static void sor_ctx_run(sor_ctx *ctx, int id)
+{
+    const sor_request *req = ctx->req;
+    const int nt = ctx->num_threads;
+    long int rowlen = ctx->grid.rowlen, interior = rowlen - 2;
+    long int i0 = 1 + (id * interior) / nt, i1 = 1 + ((id + 1) * interior) / nt;
+    data_t *u = ctx->grid.data;
+    const double omega = ctx->omega, tol = ctx->tol;
+    const int max_iters = req->max_iters;
+    double change, total_change;
+    int iters = 0;
+
+    if (!req->init && !req->warm) {
+        crng_job jb = {u, (id * rowlen) / nt, ((id + 1) * rowlen) / nt, rowlen, rowlen,
+                       rowlen, 0, crng_mix(req->seed), MINVAL, MAXVAL - MINVAL};
+        crng_fill_range(&jb);
+        if (nt > 1) pthread_barrier_wait(&ctx->sweep);
+    }
+
+    do {
+        iters++;
+        total_change = 0;
+        for (long int i = i0; i < i1; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                change = u[i * rowlen + j] - 0.25 * (u[(i - 1) * rowlen + j] +
+                                                     u[(i + 1) * rowlen + j] +
+                                                     u[i * rowlen + j + 1] +
+                                                     u[i * rowlen + j - 1]);
+                u[i * rowlen + j] -= change * omega;
+                total_change += fabs(change);
+            }
+        }
+        if (nt > 1) {
+            ctx->slot[id].change = total_change;
+            pthread_barrier_wait(&ctx->sweep);
+            total_change = 0;
+            for (int t = 0; t < nt; t++) total_change += ctx->slot[t].change;
+            pthread_barrier_wait(&ctx->sweep);
+        }
+    } while ((total_change / (rowlen * rowlen)) > tol && (!max_iters || iters < max_iters));
+
+    if (id == 0) {
+        ctx->iters = iters;
+        ctx->total_change = total_change;
+    }
+}
+
+static void *sor_ctx_worker(void *arg)
+{
+    ctx_thread *th = (ctx_thread *)arg;
+    sor_ctx *ctx = th->ctx;
+
+    for (;;) {
+        pthread_barrier_wait(&ctx->start);
+        if (ctx->shutdown) break;
+        sor_ctx_run(ctx, th->id);
+    }
+    return NULL;
+}
+
+/* Allocate for grids up to max_n interior points a side and start the
+   team; 0 on failure */
+int sor_ctx_create(sor_ctx *ctx, long int max_n, int num_threads)
+{
+    long int rowlen = max_n + GHOST;
+
+    memset(ctx, 0, sizeof(*ctx));
+    if (max_n < 1 || num_threads < 1 || num_threads > CTX_MAX_THREADS) return 0;
+    ctx->max_n = max_n;
+    ctx->num_threads = num_threads;
+    if (posix_memalign((void **)&ctx->grid.data, CACHE_LINE, rowlen * rowlen * sizeof(data_t)))
+        return 0;
+    if (posix_memalign((void **)&ctx->slot, CACHE_LINE, num_threads * sizeof(ctx_slot))) {
+        free(ctx->grid.data);
+        return 0;
+    }
+    pthread_barrier_init(&ctx->start, NULL, num_threads);
+    pthread_barrier_init(&ctx->sweep, NULL, num_threads);
+    for (int t = 1; t < num_threads; t++) {
+        ctx->args[t].ctx = ctx;
+        ctx->args[t].id = t;
+        if (pthread_create(&ctx->threads[t], NULL, sor_ctx_worker, &ctx->args[t])) {
+            printf("ERROR; sor_ctx_create could not create thread %d\n", t);
+            exit(-1);
+        }
+    }
+    return 1;
+}
+
+/* Solve req on the context's grid; returns 1 if it converged. Does no
+   allocation and creates no threads. */
+int sor_ctx_solve(sor_ctx *ctx, const sor_request *req, sor_result *res)
+{
+    long int rowlen = req->n + GHOST;
+    struct timespec t0, t1;
+
+    if (req->n < 1 || req->n > ctx->max_n) {
+        fprintf(stderr, "sor_ctx_solve: n = %ld is outside 1..%ld\n", req->n, ctx->max_n);
+        exit(-1);
+    }
+    if (req->warm && (!ctx->have_grid || ctx->grid.rowlen != rowlen)) {
+        fprintf(stderr, "sor_ctx_solve: warm start needs a previous n = %ld solve\n", req->n);
+        exit(-1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ctx->grid.rowlen = rowlen;
+    ctx->req = req;
+    ctx->omega = req->omega > 0 ? req->omega : OMEGA;
+    ctx->tol = req->tol > 0 ? req->tol : TOL;
+    if (req->init && !req->warm) memcpy(ctx->grid.data, req->init, rowlen * rowlen * sizeof(data_t));
+
+    if (ctx->num_threads > 1) pthread_barrier_wait(&ctx->start);
+    sor_ctx_run(ctx, 0);
+
+    if (req->out) memcpy(req->out, ctx->grid.data, rowlen * rowlen * sizeof(data_t));
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ctx->have_grid = 1;
+    res->iters = ctx->iters;
+    res->residual = ctx->total_change / (double)(rowlen * rowlen);
+    res->converged = res->residual <= ctx->tol;
+    res->seconds = (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec - t0.tv_nsec);
+
+    ctx->stats.solves++;
+    ctx->stats.sweeps += res->iters;
+    ctx->stats.seconds += res->seconds;
+    ctx->stats.last_residual = res->residual;
+    return res->converged;
+}
+
+/* Overwrite the ghost ring for an n-point grid, leaving the interior as
+   the last solve left it. Each side has n + GHOST values: north and
+   south along j, west and east along i; NULL keeps that side. */
+void sor_ctx_set_boundary(sor_ctx *ctx, long int n, const data_t *north, const data_t *south,
+                          const data_t *west, const data_t *east)
+{
+    long int rowlen = n + GHOST;
+    data_t *u = ctx->grid.data;
+
+    if (n < 1 || n > ctx->max_n) {
+        fprintf(stderr, "sor_ctx_set_boundary: n = %ld is outside 1..%ld\n", n, ctx->max_n);
+        exit(-1);
+    }
+    if (ctx->grid.rowlen != rowlen) ctx->have_grid = 0;
+    ctx->grid.rowlen = rowlen;
+    if (north) memcpy(u, north, rowlen * sizeof(data_t));
+    if (south) memcpy(u + (rowlen - 1) * rowlen, south, rowlen * sizeof(data_t));
+    for (long int i = 0; i < rowlen; i++) {
+        if (west) u[i * rowlen] = west[i];
+        if (east) u[i * rowlen + rowlen - 1] = east[i];
+    }
+}
+
+/* The grid of the last solve, rowlen n + GHOST */
+arr_ptr sor_ctx_grid(sor_ctx *ctx) { return &ctx->grid; }
+
+/* Stop and join the team, free the buffers */
+void sor_ctx_destroy(sor_ctx *ctx)
+{
+    if (ctx->num_threads > 1) {
+        ctx->shutdown = 1;
+        pthread_barrier_wait(&ctx->start);
+    }
+    for (int t = 1; t < ctx->num_threads; t++) pthread_join(ctx->threads[t], NULL);
+    pthread_barrier_destroy(&ctx->start);
+    pthread_barrier_destroy(&ctx->sweep);
+    free(ctx->grid.data);
+    free(ctx->slot);
+}
+
+#endif /* _SOR_CTX_H_ */
@@ -0,0 +1,354 @@
+/* Domain-decomposed SOR across processes, with halo exchange through a
+   pluggable transport.
+
+   SOR_dd() splits the interior into a py x px grid of 2D blocks and forks
+   one process per block. Each process keeps its block in private memory
+   with a one-point ghost ring (the GHOST/2 layer of the full grid): the
+   ring holds the Dirichlet values on the outer edges of the domain and
+   halo copies of the neighbouring blocks' edge points everywhere else.
+
+   The sweep is red/black, colours as in SOR_redblack(). A point of one
+   colour depends only on points of the other, so a single exchange per
+   half-sweep keeps the halos exact and the grid values match
+   SOR_redblack() sweep for sweep. Only the residual sum is added in a
+   different order. Each half-sweep overlaps communication with work:
+
+       update this colour on the block's outer ring of points
+       post the four edges to the neighbours         (isend)
+       update this colour on the rest of the block   (no halo needed)
+       wait for the neighbours' edges into the ghost ring
+
+   After a full sweep the block residuals are summed in rank order by
+   allreduce_sum(), so every process takes the same exit decision.
+
+   Transport: dd_transport is the only way blocks talk, so a socket (or
+   MPI) transport can replace dd_shm later without touching the solver.
+   The shared-memory one keeps one single-producer/single-consumer mailbox
+   per (receiver, face) in a MAP_SHARED mapping, double-buffered so a post
+   never waits for a slow reader of the previous message. Sequence
+   counters use C11 acquire/release atomics, and waiting loops yield the
+   CPU, so oversubscribed runs still progress. The reduction uses a
+   process-shared pthread barrier. No MPI or other external library is
+   needed.
+
+   Header-only; include after sor.h from one .c file.
+*/
+
+#ifndef _SOR_DD_H_
+#define _SOR_DD_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include "apple_pthread_barrier.h"
+#endif /* __APPLE__ */
+
+#include "sor.h"
+
+#define DD_MAX_PROCS 64
+
+/* Block faces; the opposite of face f is f ^ 1 */
+#define DD_NORTH 0
+#define DD_SOUTH 1
+#define DD_WEST  2
+#define DD_EAST  3
+
+typedef struct dd_transport dd_transport;
+
+struct dd_transport {
+    int rank, size;
+    void *ctx;
+    /* Send n values to peer through this block's face; may return before
+       the peer has them, but buf is reusable on return */
+    void (*isend)(dd_transport *t, int peer, int face, const data_t *buf, long int n);
+    /* Block until peer's values arrive on this block's face */
+    void (*wait_recv)(dd_transport *t, int peer, int face, data_t *buf, long int n);
+    /* Sum of x over all ranks, added in rank order, returned to every rank */
+    double (*allreduce_sum)(dd_transport *t, double x);
+};
+
+void SOR_dd(arr_ptr v, int nprocs, int *iterations);
+
+/************************************/
+/* Shared-memory transport */
+
+typedef struct {
+    _Atomic long int posted;    /* messages written */
+    _Atomic long int taken;     /* messages read */
+    char pad[64 - 2 * sizeof(long int)];
+} dd_mailbox;
+
+/* Start of the MAP_SHARED region; mailboxes and the grid follow */
+typedef struct {
+    int size;
+    long int maxlen;            /* longest edge, values per message slot */
+    long int mailbox_bytes;     /* header + 2 slots, cache-line multiple */
+    long int grid_offset;       /* bytes from the region start */
+    pthread_barrier_t barrier;  /* PTHREAD_PROCESS_SHARED */
+    double partial[DD_MAX_PROCS];
+    int iterations;
+} dd_shm;
+
+static dd_mailbox *dd_shm_mailbox(dd_shm *shm, int rank, int face)
+{
+    return (dd_mailbox *)((char *)shm + sizeof(dd_shm) +
+                          (rank * 4 + face) * shm->mailbox_bytes);
+}
+
+static void dd_shm_isend(dd_transport *t, int peer, int face, const data_t *buf, long int n)
+{
+    dd_shm *shm = (dd_shm *)t->ctx;
+    dd_mailbox *mb = dd_shm_mailbox(shm, peer, face ^ 1);
+    long int seq = atomic_load_explicit(&mb->posted, memory_order_relaxed);
+
+    while (seq - atomic_load_explicit(&mb->taken, memory_order_acquire) >= 2) sched_yield();
+    memcpy((data_t *)(mb + 1) + (seq & 1) * shm->maxlen, buf, n * sizeof(data_t));
+    atomic_store_explicit(&mb->posted, seq + 1, memory_order_release);
+}
+
+static void dd_shm_wait_recv(dd_transport *t, int peer, int face, data_t *buf, long int n)
+{
+    dd_shm *shm = (dd_shm *)t->ctx;
+    dd_mailbox *mb = dd_shm_mailbox(shm, t->rank, face);
+    long int seq = atomic_load_explicit(&mb->taken, memory_order_relaxed);
+
+    (void)peer;                 /* one sender per (rank, face) */
+    while (atomic_load_explicit(&mb->posted, memory_order_acquire) <= seq) sched_yield();
+    memcpy(buf, (data_t *)(mb + 1) + (seq & 1) * shm->maxlen, n * sizeof(data_t));
+    atomic_store_explicit(&mb->taken, seq + 1, memory_order_release);
+}
+
+static double dd_shm_allreduce_sum(dd_transport *t, double x)
+{
+    dd_shm *shm = (dd_shm *)t->ctx;
+    double sum = 0;
+
+    shm->partial[t->rank] = x;
+    pthread_barrier_wait(&shm->barrier);
+    for (int r = 0; r < t->size; r++) sum += shm->partial[r];
+    pthread_barrier_wait(&shm->barrier);
+    return sum;
+}
+
+static dd_transport dd_shm_transport(dd_shm *shm, int rank)
+{
+    dd_transport t = {rank, shm->size, shm, dd_shm_isend, dd_shm_wait_recv,
+                      dd_shm_allreduce_sum};
+    return t;
+}
+
+/************************************/
+/* Solver */
+
+typedef struct {
+    long int rows, cols;        /* owned points */
+    long int i0, j0;            /* global index of owned point (1,1) */
+    long int ld;                /* local row length, cols + 2 */
+    data_t *u;                  /* (rows + 2) x ld */
+    int nbr[4];                 /* rank across each face, or -1 */
+    data_t *edge;               /* pack/unpack buffer, max(rows, cols) */
+} dd_block;
+
+/* py x px process grid, as square as nprocs allows */
+static void dd_dims(int nprocs, int *py, int *px)
+{
+    *py = 1;
+    for (int d = 1; d * d <= nprocs; d++)
+        if (nprocs % d == 0) *py = d;
+    *px = nprocs / *py;
+}
+
+/* Points of colour redblack in local rows [r0, r1), cols [c0, c1) */
+KERNEL_CLONES
+static double dd_update(dd_block *b, int redblack, long int r0, long int r1,
+                        long int c0, long int c1, double omega)
+{
+    long int ld = b->ld;
+    data_t *u = b->u;
+    double change, total_change = 0;
+
+    for (long int i = r0; i < r1; i++) {
+        /* SOR_redblack() colour: (global i + global j + redblack) odd */
+        long int j = c0 + (((b->i0 + i - 1) + (b->j0 + c0 - 1) + redblack + 1) & 1);
+        for (; j < c1; j += 2) {
+            change = u[i * ld + j] - 0.25 * (u[(i - 1) * ld + j] + u[(i + 1) * ld + j] +
+                                             u[i * ld + j + 1] + u[i * ld + j - 1]);
+            u[i * ld + j] -= change * omega;
+            total_change += fabs(change);
+        }
+    }
+    return total_change;
+}
+
+/* Copy an owned edge into b->edge, or b->edge into the halo on that face */
+static void dd_edge(dd_block *b, int face, int into_halo)
+{
+    long int ld = b->ld, n = (face < DD_WEST) ? b->cols : b->rows;
+    long int at, step;
+
+    switch (face) {
+    case DD_NORTH: at = (into_halo ? 0 : 1) * ld + 1; step = 1; break;
+    case DD_SOUTH: at = (into_halo ? b->rows + 1 : b->rows) * ld + 1; step = 1; break;
+    case DD_WEST:  at = ld + (into_halo ? 0 : 1); step = ld; break;
+    default:       at = ld + (into_halo ? b->cols + 1 : b->cols); step = ld; break;
+    }
+    for (long int k = 0; k < n; k++) {
+        if (into_halo) b->u[at + k * step] = b->edge[k];
+        else b->edge[k] = b->u[at + k * step];
+    }
+}
+
+/* One process's solve; returns 0 on success */
+static int dd_worker(dd_shm *shm, arr_ptr v, int rank, int py, int px)
+{
+    dd_transport t = dd_shm_transport(shm, rank);
+    long int rowlen = v->rowlen, n = rowlen - 2;
+    int bi = rank / px, bj = rank % px;
+    const double omega = OMEGA, tol = TOL;
+    double total_change;
+    dd_block b;
+    int iters = 0;
+
+    b.i0 = 1 + (bi * n) / py;
+    b.rows = 1 + ((bi + 1) * n) / py - b.i0;
+    b.j0 = 1 + (bj * n) / px;
+    b.cols = 1 + ((bj + 1) * n) / px - b.j0;
+    b.ld = b.cols + 2;
+    b.nbr[DD_NORTH] = bi > 0 ? rank - px : -1;
+    b.nbr[DD_SOUTH] = bi < py - 1 ? rank + px : -1;
+    b.nbr[DD_WEST] = bj > 0 ? rank - 1 : -1;
+    b.nbr[DD_EAST] = bj < px - 1 ? rank + 1 : -1;
+    b.u = (data_t *)malloc((b.rows + 2) * b.ld * sizeof(data_t));
+    b.edge = (data_t *)malloc((b.rows > b.cols ? b.rows : b.cols) * sizeof(data_t));
+    if (!b.u || !b.edge) return 1;
+
+    /* Block plus ring from the shared starting grid */
+    for (long int i = 0; i < b.rows + 2; i++)
+        memcpy(b.u + i * b.ld, v->data + (b.i0 - 1 + i) * rowlen + b.j0 - 1,
+               b.ld * sizeof(data_t));
+
+    do {
+        iters++;
+        total_change = 0;
+        for (int redblack = 0; redblack < 2; redblack++) {
+            /* Outer ring of owned points first: rows 1 and rows, then
+               cols 1 and cols of the rows in between */
+            total_change += dd_update(&b, redblack, 1, 2, 1, b.cols + 1, omega);
+            if (b.rows > 1)
+                total_change += dd_update(&b, redblack, b.rows, b.rows + 1, 1, b.cols + 1, omega);
+            if (b.rows > 2) {
+                total_change += dd_update(&b, redblack, 2, b.rows, 1, 2, omega);
+                if (b.cols > 1)
+                    total_change += dd_update(&b, redblack, 2, b.rows, b.cols, b.cols + 1, omega);
+            }
+            for (int f = 0; f < 4; f++) {
+                if (b.nbr[f] < 0) continue;
+                dd_edge(&b, f, 0);
+                t.isend(&t, b.nbr[f], f, b.edge, f < DD_WEST ? b.cols : b.rows);
+            }
+            /* Overlapped with the messages in flight */
+            if (b.rows > 2 && b.cols > 2)
+                total_change += dd_update(&b, redblack, 2, b.rows, 2, b.cols, omega);
+            for (int f = 0; f < 4; f++) {
+                if (b.nbr[f] < 0) continue;
+                t.wait_recv(&t, b.nbr[f], f, b.edge, f < DD_WEST ? b.cols : b.rows);
+                dd_edge(&b, f, 1);
+            }
+        }
+        total_change = t.allreduce_sum(&t, total_change);
+    } while ((total_change / (double)(rowlen * rowlen)) > tol);
+
+    for (long int i = 1; i <= b.rows; i++)
+        memcpy(v->data + (b.i0 - 1 + i) * rowlen + b.j0, b.u + i * b.ld + 1,
+               b.cols * sizeof(data_t));
+    if (rank == 0) shm->iterations = iters;
+    free(b.u);
+    free(b.edge);
+    return 0;
+}
+
+/* SOR on v split over nprocs forked processes */
+void SOR_dd(arr_ptr v, int nprocs, int *iterations)
+{
+    long int rowlen = v->rowlen, grid_bytes = rowlen * rowlen * sizeof(data_t);
+    pid_t pids[DD_MAX_PROCS];
+    pthread_barrierattr_t attr;
+    arr_rec shared;
+    dd_shm *shm;
+    int py, px, failed = 0;
+    size_t bytes;
+
+    dd_dims(nprocs, &py, &px);
+    if (nprocs < 1 || nprocs > DD_MAX_PROCS || py > rowlen - 2 || px > rowlen - 2) {
+        fprintf(stderr, "SOR_dd: cannot split %ld^2 points over %d processes\n",
+                rowlen - 2, nprocs);
+        exit(-1);
+    }
+
+    /* Region: dd_shm, 4 mailboxes per rank, then the grid */
+    long int maxlen = rowlen, mailbox_bytes = sizeof(dd_mailbox) + 2 * maxlen * sizeof(data_t);
+    mailbox_bytes = (mailbox_bytes + 63) & ~63L;
+    long int grid_offset = ((sizeof(dd_shm) + 4L * nprocs * mailbox_bytes) + 63) & ~63L;
+    bytes = grid_offset + grid_bytes;
+    shm = (dd_shm *)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) {
+        fprintf(stderr, "SOR_dd: could not map %zu shared bytes\n", bytes);
+        exit(-1);
+    }
+    shm->size = nprocs;
+    shm->maxlen = maxlen;
+    shm->mailbox_bytes = mailbox_bytes;
+    shm->grid_offset = grid_offset;
+    for (int r = 0; r < nprocs; r++)
+        for (int f = 0; f < 4; f++) {
+            atomic_init(&dd_shm_mailbox(shm, r, f)->posted, 0);
+            atomic_init(&dd_shm_mailbox(shm, r, f)->taken, 0);
+        }
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(&shm->barrier, &attr, nprocs);
+    pthread_barrierattr_destroy(&attr);
+    shared.rowlen = rowlen;
+    shared.data = (data_t *)((char *)shm + grid_offset);
+    memcpy(shared.data, v->data, grid_bytes);
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int r = 0; r < nprocs; r++) {
+        if ((pids[r] = fork()) == 0) _exit(dd_worker(shm, &shared, r, py, px));
+        if (pids[r] < 0) {
+            fprintf(stderr, "SOR_dd: could not fork process %d\n", r);
+            for (int k = 0; k < r; k++) kill(pids[k], SIGKILL);
+            exit(-1);
+        }
+    }
+    /* A process that dies leaves the others waiting on it; stop them */
+    for (int left = nprocs; left > 0; left--) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) break;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (!failed)
+                for (int r = 0; r < nprocs; r++) kill(pids[r], SIGKILL);
+            failed = 1;
+        }
+    }
+    if (failed) {
+        fprintf(stderr, "SOR_dd: a worker process failed\n");
+        exit(-1);
+    }
+
+    memcpy(v->data, shared.data, grid_bytes);
+    *iterations = shm->iterations;
+    pthread_barrier_destroy(&shm->barrier);
+    munmap(shm, bytes);
+}
+
+#endif /* _SOR_DD_H_ */
@@ -0,0 +1,191 @@
+/* Line SOR, zebra order: every interior row solved exactly at once.
+
+   Point SOR moves information about one cell per sweep, so its sweep
+   count grows with the grid. Here a row's values are solved together
+   from its neighbour rows,
+
+       4 u[i][j] - u[i][j-1] - u[i][j+1] = u[i-1][j] + u[i+1][j]
+
+   (ghost columns on the right-hand side), with the Thomas algorithm,
+   and the row is relaxed towards that solution:
+
+       change   = solution - u          u += LINE_OMEGA * change
+
+   Odd rows go first, then even rows (zebra), so all rows of one colour
+   are independent. The convergence test is SOR()'s on the sum |change|,
+   which is again the distance to the relaxation target, so sweep counts
+   and time-to-TOL compare directly.
+
+   The matrix is the same (-1, 4, -1) for every row, so the Thomas
+   multipliers are computed once per solve; only the right-hand side
+   differs. LINE_LANES rows of a colour are solved together: their
+   right-hand sides are transposed into a scratch block with the rows
+   side by side, so the forward and back recurrences run across rows with
+   unit stride, one SIMD vector per column. SOR_line_threaded() deals the
+   batches of each colour to the threads round-robin, with the
+   SOR_reduce_change() barriers between colours.
+
+   LINE_OMEGA = 0 picks the optimum for the 5-point Laplacian at this
+   size, 2 / (1 + sqrt(1 - rho^2)) with rho = cos(pi h) / (2 - cos(pi h))
+   the line Jacobi spectral radius.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _SOR_LINE_H_
+#define _SOR_LINE_H_
+
+#include "sor_mt.h"
+
+#define LINE_LANES 8    /* rows per batch: one AVX-512 vector, two AVX2 */
+
+double LINE_OMEGA = 0;  /* 0 = optimal for the grid size */
+
+double SOR_line_omega(long int rowlen);
+void SOR_line(arr_ptr v, int *iterations);
+void *SOR_line_thread(void *arg);
+void SOR_line_threaded(arr_ptr v, int num_threads, int *iterations);
+
+/* LINE_OMEGA, or the zebra line SOR optimum for a rowlen^2 grid */
+double SOR_line_omega(long int rowlen)
+{
+    double c = cos(M_PI / (rowlen - 1)), rho = c / (2.0 - c);
+
+    if (LINE_OMEGA > 0) return LINE_OMEGA;
+    return 2.0 / (1.0 + sqrt(1.0 - rho * rho));
+}
+
+/* Thomas multipliers for (-1, 4, -1) on n unknowns: m[j] = 1 / pivot j */
+static void SOR_line_pivots(double *m, long int n)
+{
+    double cp = 0;                  /* c'[j-1] */
+
+    for (long int j = 0; j < n; j++) {
+        m[j] = 1.0 / (4.0 + cp);
+        cp = -m[j];
+    }
+}
+
+/* Solve and relax rows i0, i0 + 2, ... (nrows <= LINE_LANES, one colour).
+   scratch holds n * LINE_LANES values; returns sum |change| */
+KERNEL_CLONES
+static double SOR_line_batch(data_t *u, long int rowlen, const double *m, long int i0, int nrows,
+                             double omega, double *restrict scratch)
+{
+    const long int n = rowlen - 2;
+    double total_change = 0, change;
+
+    /* Right-hand sides, rows side by side */
+    for (int l = 0; l < nrows; l++) {
+        const data_t *c = u + (i0 + 2 * l) * rowlen + 1;
+        for (long int j = 0; j < n; j++) scratch[j * LINE_LANES + l] = c[j - rowlen] + c[j + rowlen];
+        scratch[l] += c[-1];
+        scratch[(n - 1) * LINE_LANES + l] += c[n];
+    }
+    /* Forward elimination and back substitution, all lanes at once */
+    for (int l = 0; l < LINE_LANES; l++) scratch[l] *= m[0];
+    for (long int j = 1; j < n; j++) {
+        for (int l = 0; l < LINE_LANES; l++)
+            scratch[j * LINE_LANES + l] = (scratch[j * LINE_LANES + l] + scratch[(j - 1) * LINE_LANES + l]) * m[j];
+    }
+    for (long int j = n - 2; j >= 0; j--) {
+        for (int l = 0; l < LINE_LANES; l++)
+            scratch[j * LINE_LANES + l] += m[j] * scratch[(j + 1) * LINE_LANES + l];
+    }
+    /* Relax towards the solution */
+    for (int l = 0; l < nrows; l++) {
+        data_t *c = u + (i0 + 2 * l) * rowlen + 1;
+        for (long int j = 0; j < n; j++) {
+            change = scratch[j * LINE_LANES + l] - c[j];
+            c[j] += omega * change;
+            total_change += fabs(change);
+        }
+    }
+    return total_change;
+}
+
+/* One colour (first row 1 or 2), batches first, first + step, ... */
+static double SOR_line_colour(data_t *u, long int rowlen, const double *m, int colour,
+                              long int first, long int step, double omega, double *scratch)
+{
+    long int rows = (rowlen - 2 - colour + 1) / 2;      /* rows colour+1, colour+3, ... */
+    long int batches = (rows + LINE_LANES - 1) / LINE_LANES;
+    double total_change = 0;
+
+    for (long int b = first; b < batches; b += step) {
+        long int r0 = b * LINE_LANES;
+        int nrows = rows - r0 < LINE_LANES ? (int)(rows - r0) : LINE_LANES;
+        total_change += SOR_line_batch(u, rowlen, m, colour + 1 + 2 * r0, nrows, omega, scratch);
+    }
+    return total_change;
+}
+
+/* Pivots and scratch for one thread; calloc so unused lanes stay finite */
+static double *SOR_line_alloc(long int rowlen, double **scratch)
+{
+    double *m = (double *)malloc((rowlen - 2) * sizeof(double));
+
+    *scratch = (double *)calloc((rowlen - 2) * LINE_LANES, sizeof(double));
+    if (!m || !*scratch) {
+        fprintf(stderr, "SOR_line: could not allocate scratch for rowlen %ld\n", rowlen);
+        exit(-1);
+    }
+    SOR_line_pivots(m, rowlen - 2);
+    return m;
+}
+
+void SOR_line(arr_ptr v, int *iterations)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    const double omega = SOR_line_omega(rowlen), tol = TOL;
+    double total_change, *scratch, *m = SOR_line_alloc(rowlen, &scratch);
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = SOR_line_colour(data, rowlen, m, 0, 0, 1, omega, scratch) +
+                       SOR_line_colour(data, rowlen, m, 1, 0, 1, omega, scratch);
+        if (SOR_HOOK) SOR_HOOK(SOR_HOOK_ARG, v, iters);
+    } while ((total_change / (rowlen * rowlen)) > tol);
+
+    *iterations = iters;
+    free(m);
+    free(scratch);
+}
+
+/* Threaded zebra line SOR worker, for SOR_launch() */
+void *SOR_line_thread(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+    arr_ptr v = data->v;
+    long int rowlen = v->rowlen;
+    const double omega = SOR_line_omega(rowlen), tol = TOL;
+    double total_change, *scratch, *m = SOR_line_alloc(rowlen, &scratch);
+    int iters = 0;
+
+    do {
+        iters++;
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_BEGIN, iters);
+        total_change = SOR_line_colour(v->data, rowlen, m, 0, data->thread_id, data->num_threads,
+                                       omega, scratch);
+        /* Even rows read the odd rows just written */
+        pthread_barrier_wait(&barrier);
+        total_change += SOR_line_colour(v->data, rowlen, m, 1, data->thread_id, data->num_threads,
+                                        omega, scratch);
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_END, iters);
+        total_change = SOR_reduce_change(data, total_change);
+    } while ((total_change / (rowlen * rowlen)) > tol);
+
+    data->iterations = iters;
+    free(m);
+    free(scratch);
+    pthread_exit(NULL);
+}
+
+void SOR_line_threaded(arr_ptr v, int num_threads, int *iterations)
+{
+    SOR_threaded(v, num_threads, SOR_line_thread, iterations);
+}
+
+#endif /* _SOR_LINE_H_ */
@@ -0,0 +1,240 @@
+/* pthreads SOR kernels shared by test_SOR_mt.c and sor_bench.c.
+
+   Each worker sweeps its share of the rows, then all workers combine their
+   partial residuals through partial_change[] so every thread takes the
+   same exit decision (a thread deciding from its own strip alone can
+   leave the loop while the others block on the barrier forever).
+
+   Row distributions over the interior rows 1..rowlen-2 (the ghost rows
+   are never assigned):
+
+     strip        one contiguous band per thread
+     interleaved  row i to thread (i-1) % num_threads
+     cyclic       chunks of SOR_CHUNK_ROWS rows dealt round-robin; small
+                  chunks balance load, large ones share fewer halo rows
+
+   Cyclic chunk boundaries are moved down to the next row that starts on
+   a cache line, when some row does, so two threads never write the same
+   line at a boundary. Chunks can then differ by up to 7 rows, or come
+   out empty when SOR_CHUNK_ROWS is below the alignment period.
+
+   With TRACE set (trace.h) the workers record sweep begin/end and
+   SOR_reduce_change() barrier arrival/release per thread.
+
+   Header-only; include after sor.h from one .c file.
+*/
+
+#ifndef _SOR_MT_H_
+#define _SOR_MT_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __APPLE__
+#include "apple_pthread_barrier.h"
+#endif /* __APPLE__ */
+
+#include "sor.h"
+#include "trace.h"
+
+#define MAX_THREADS 8 /* Maximum number of threads */
+#define CACHE_LINE 64
+
+long int SOR_CHUNK_ROWS = 8;    /* SOR_thread_cyclic() chunk height */
+
+typedef struct {
+    int thread_id;
+    int num_threads;
+    arr_ptr v;
+    int start_row;
+    int end_row;
+    int iterations;
+    double *partial_change;  /* one slot per thread, shared */
+    data_t *buf;             /* second grid for double-buffered kernels */
+} thread_data_t;
+
+pthread_barrier_t barrier;
+
+void *SOR_thread_strip(void *arg);
+void *SOR_thread_interleaved(void *arg);
+void *SOR_thread_cyclic(void *arg);
+void SOR_threaded(arr_ptr v, int num_threads, void *(*worker)(void *),
+                  int *iterations);
+void SOR_launch(arr_ptr v, int num_threads, void *(*worker)(void *),
+                data_t *buf, int *iterations);
+
+/* Publish this thread's residual and return the global one. The sum runs
+   in thread order in every thread, so all of them see the same value. */
+static double SOR_reduce_change(thread_data_t *data, double my_change) {
+    double total_change = 0;
+
+    data->partial_change[data->thread_id] = my_change;
+    TRACE_EVENT(data->thread_id, TRACE_BARRIER_ARRIVE, -1);
+    pthread_barrier_wait(&barrier);
+    for (int t = 0; t < data->num_threads; t++) {
+        total_change += data->partial_change[t];
+    }
+    /* Nobody may overwrite partial_change[] until everyone has summed */
+    pthread_barrier_wait(&barrier);
+    TRACE_EVENT(data->thread_id, TRACE_BARRIER_RELEASE, -1);
+    return total_change;
+}
+
+/* Strip-based Multithreaded SOR */
+KERNEL_CLONES
+void *SOR_thread_strip(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    arr_ptr v = data->v;
+    long int rowlen = v->rowlen;
+    const double omega = OMEGA, tol = TOL;
+    double change, total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_BEGIN, iters);
+        for (long int i = data->start_row; i < data->end_row; i++) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                change = v->data[i * rowlen + j] - 0.25 * (v->data[(i - 1) * rowlen + j] +
+                                                           v->data[(i + 1) * rowlen + j] +
+                                                           v->data[i * rowlen + j + 1] +
+                                                           v->data[i * rowlen + j - 1]);
+                v->data[i * rowlen + j] -= change * omega;
+                total_change += fabs(change);
+            }
+        }
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_END, iters);
+        total_change = SOR_reduce_change(data, total_change);
+    } while ((total_change / (rowlen * rowlen)) > tol);
+
+    data->iterations = iters;
+    pthread_exit(NULL);
+}
+
+/* Interleaved Row Multithreaded SOR */
+KERNEL_CLONES
+void *SOR_thread_interleaved(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    arr_ptr v = data->v;
+    long int rowlen = v->rowlen;
+    const double omega = OMEGA, tol = TOL;
+    double change, total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_BEGIN, iters);
+        for (long int i = data->thread_id + 1; i < rowlen - 1; i += data->num_threads) {
+            for (long int j = 1; j < rowlen - 1; j++) {
+                change = v->data[i * rowlen + j] - 0.25 * (v->data[(i - 1) * rowlen + j] +
+                                                           v->data[(i + 1) * rowlen + j] +
+                                                           v->data[i * rowlen + j + 1] +
+                                                           v->data[i * rowlen + j - 1]);
+                v->data[i * rowlen + j] -= change * omega;
+                total_change += fabs(change);
+            }
+        }
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_END, iters);
+        total_change = SOR_reduce_change(data, total_change);
+    } while ((total_change / (rowlen * rowlen)) > tol);
+
+    data->iterations = iters;
+    pthread_exit(NULL);
+}
+
+/* First row of cyclic chunk c: row 1 + c chunk, moved down to the next
+   cache-line-aligned row start if one is within the alignment period.
+   Chunk 0 always starts at row 1. */
+static long int SOR_chunk_start(arr_ptr v, long int c, long int chunk)
+{
+    long int rowlen = v->rowlen, first = 1 + c * chunk;
+
+    if (c == 0) return 1;
+    if (first >= rowlen - 1) return rowlen - 1;
+    for (long int i = first; i < first + CACHE_LINE / (long int)sizeof(data_t) && i < rowlen - 1; i++) {
+        if ((uintptr_t)(v->data + i * rowlen) % CACHE_LINE == 0) return i;
+    }
+    return first;
+}
+
+/* Block-cyclic Multithreaded SOR */
+KERNEL_CLONES
+void *SOR_thread_cyclic(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    arr_ptr v = data->v;
+    long int rowlen = v->rowlen;
+    const long int chunk = SOR_CHUNK_ROWS;
+    const double omega = OMEGA, tol = TOL;
+    double change, total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_BEGIN, iters);
+        for (long int c = data->thread_id; SOR_chunk_start(v, c, chunk) < rowlen - 1;
+             c += data->num_threads) {
+            long int iend = SOR_chunk_start(v, c + 1, chunk);
+            for (long int i = SOR_chunk_start(v, c, chunk); i < iend; i++) {
+                for (long int j = 1; j < rowlen - 1; j++) {
+                    change = v->data[i * rowlen + j] - 0.25 * (v->data[(i - 1) * rowlen + j] +
+                                                               v->data[(i + 1) * rowlen + j] +
+                                                               v->data[i * rowlen + j + 1] +
+                                                               v->data[i * rowlen + j - 1]);
+                    v->data[i * rowlen + j] -= change * omega;
+                    total_change += fabs(change);
+                }
+            }
+        }
+        TRACE_EVENT(data->thread_id, TRACE_SWEEP_END, iters);
+        total_change = SOR_reduce_change(data, total_change);
+    } while ((total_change / (rowlen * rowlen)) > tol);
+
+    data->iterations = iters;
+    pthread_exit(NULL);
+}
+
+/* Launch num_threads copies of worker over v and wait for them */
+void SOR_threaded(arr_ptr v, int num_threads, void *(*worker)(void *),
+                  int *iterations) {
+    SOR_launch(v, num_threads, worker, NULL, iterations);
+}
+
+/* As SOR_threaded(), also handing every worker a second buffer */
+void SOR_launch(arr_ptr v, int num_threads, void *(*worker)(void *),
+                data_t *buf, int *iterations) {
+    long int interior = v->rowlen - 2;  /* ghost rows 0 and rowlen-1 stay fixed */
+    pthread_t threads[num_threads];
+    thread_data_t thread_data[num_threads];
+    double partial_change[num_threads];
+    int rc;
+
+    if (worker == SOR_thread_cyclic && SOR_CHUNK_ROWS < 1) {
+        fprintf(stderr, "SOR_thread_cyclic: chunk of %ld rows is invalid\n", SOR_CHUNK_ROWS);
+        exit(-1);
+    }
+    pthread_barrier_init(&barrier, NULL, num_threads);
+    for (int i = 0; i < num_threads; i++) {
+        thread_data[i].thread_id = i;
+        thread_data[i].num_threads = num_threads;
+        thread_data[i].v = v;
+        thread_data[i].start_row = 1 + (i * interior) / num_threads;
+        thread_data[i].end_row = 1 + ((i + 1) * interior) / num_threads;
+        thread_data[i].partial_change = partial_change;
+        thread_data[i].buf = buf;
+        rc = pthread_create(&threads[i], NULL, worker, &thread_data[i]);
+        if (rc) {
+            printf("ERROR; return code from pthread_create() is %d\n", rc);
+            exit(-1);
+        }
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    *iterations = thread_data[0].iterations;
+}
+
+#endif /* _SOR_MT_H_ */
@@ -0,0 +1,534 @@
+/* SOR on a general sparse matrix, for meshes that are not a rowlen^2 grid.
+
+   The system is A x = rhs with A in CSR. Off-diagonal entries are in
+   rowptr/col/val and the diagonal is stored as 1/a_ii. Row i's update is
+   the SOR() one:
+
+       change = x[i] - inv_diag[i] * (rhs[i] - sum_j a_ij x[j])
+       x[i]  -= OMEGA * change
+
+   The test is SOR()'s, on sum |change| / n. Rows marked fixed (Dirichlet
+   nodes) are never updated, but other rows may read them.
+
+   Parallelism comes from a multicolouring: no two rows of one colour
+   reference each other, so a colour's rows can be updated in any order or
+   all at once. Red/black is the two-colour case of the grid.
+   csr_colour() is greedy first-fit in row order and walks the transpose
+   as well, so the pattern need not be symmetric. The threaded kernels
+   split each colour's rows among the threads, with a barrier between
+   colours.
+
+   SELL-C-sigma (new_sell()) is the SIMD layout. Each colour's rows are
+   sorted by length within windows of SELL_SIGMA rows and packed in
+   chunks of SELL_C. Entries are stored column-major in a chunk and padded
+   to its longest row. One SIMD vector then updates SELL_C rows of one
+   colour: it gathers x for each column and never needs a horizontal
+   sum. Padding entries are 0 * x[own row].
+
+   grid_to_csr() builds the 5-point Laplacian of a rowlen^2 grid with x
+   being the grid itself. The ghost ring is the fixed rows, and
+   each row lists N, S, E, W in SOR()'s summation order. With the red/black
+   colouring of grid_colour_redblack(), SOR_csr() and SOR_sell() do
+   SOR_redblack()'s arithmetic point for point, the same sweeps and grid
+   (up to FMA contraction in the KERNEL_CLONES bodies). That makes the
+   cost of going through the sparse format directly measurable.
+
+   Columns are int, so n < 2^31.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _SOR_SPARSE_H_
+#define _SOR_SPARSE_H_
+
+#include <string.h>
+
+#include "sor_mt.h"
+
+#define SELL_C 8                /* rows per chunk: one AVX-512 vector, two AVX2 */
+
+long int SELL_SIGMA = 256;      /* sorting window, rounded up to a multiple of SELL_C; 1 = no sort */
+
+typedef struct {
+    long int n;                 /* rows (= unknowns, fixed ones included) */
+    long int nnz;               /* off-diagonal entries */
+    long int *rowptr;           /* n + 1 */
+    int *col;
+    double *val;
+    double *inv_diag;           /* 1 / a_ii */
+    double *rhs;
+    unsigned char *fixed;       /* 1 = Dirichlet row, never updated */
+} csr_rec, *csr_ptr;
+
+typedef struct {
+    int num_colours;
+    long int *start;            /* colour c is rows[start[c] .. start[c+1]) */
+    long int *rows;             /* the free rows, colour by colour, ascending */
+} colour_rec, *colour_ptr;
+
+typedef struct {
+    long int n;
+    int num_colours;
+    long int *colour_chunk;     /* colour c is chunks colour_chunk[c] .. [c+1]) */
+    long int *chunk_ptr;        /* first entry of each chunk, chunks + 1 */
+    int *chunk_rows;            /* lanes in use, SELL_C but in a colour's last chunk */
+    long int *row;              /* row of each lane, chunks * SELL_C */
+    double *inv_diag, *rhs;     /* per lane */
+    int *col;                   /* entry k of lane l at chunk_ptr + k * SELL_C + l */
+    double *val;
+} sell_rec, *sell_ptr;
+
+csr_ptr new_csr(long int n, long int nnz);
+void free_csr(csr_ptr A);
+csr_ptr grid_to_csr(long int rowlen);
+colour_ptr csr_colour(csr_ptr A);
+colour_ptr grid_colour_redblack(long int rowlen);
+void free_colours(colour_ptr c);
+sell_ptr new_sell(csr_ptr A, colour_ptr c, long int sigma);
+void free_sell(sell_ptr S);
+void SOR_csr(csr_ptr A, colour_ptr c, data_t *x, int *iterations);
+void SOR_sell(sell_ptr S, data_t *x, int *iterations);
+void SOR_csr_threaded(csr_ptr A, colour_ptr c, data_t *x, int num_threads, int *iterations);
+void SOR_sell_threaded(sell_ptr S, data_t *x, int num_threads, int *iterations);
+
+/* Room for n rows and nnz off-diagonal entries; rhs zero, nothing fixed */
+csr_ptr new_csr(long int n, long int nnz)
+{
+    csr_ptr A = (csr_ptr)calloc(1, sizeof(csr_rec));
+    if (!A) return NULL;
+    A->n = n;
+    A->nnz = nnz;
+    A->rowptr = (long int *)calloc(n + 1, sizeof(long int));
+    A->col = (int *)malloc((nnz ? nnz : 1) * sizeof(int));
+    A->val = (double *)malloc((nnz ? nnz : 1) * sizeof(double));
+    A->inv_diag = (double *)malloc(n * sizeof(double));
+    A->rhs = (double *)calloc(n, sizeof(double));
+    A->fixed = (unsigned char *)calloc(n, 1);
+    if (!A->rowptr || !A->col || !A->val || !A->inv_diag || !A->rhs || !A->fixed) {
+        free_csr(A);
+        return NULL;
+    }
+    return A;
+}
+
+void free_csr(csr_ptr A)
+{
+    if (!A) return;
+    free(A->rowptr);
+    free(A->col);
+    free(A->val);
+    free(A->inv_diag);
+    free(A->rhs);
+    free(A->fixed);
+    free(A);
+}
+
+/* 5-point Laplacian on a rowlen^2 grid, unknown i * rowlen + j; the
+   ghost ring is fixed and the off-diagonals go N, S, E, W as in SOR() */
+csr_ptr grid_to_csr(long int rowlen)
+{
+    long int inner = rowlen - 2, e = 0;
+    csr_ptr A = new_csr(rowlen * rowlen, 4 * inner * inner);
+
+    if (!A) return NULL;
+    for (long int i = 0; i < rowlen; i++) {
+        for (long int j = 0; j < rowlen; j++) {
+            long int p = i * rowlen + j;
+            const long int nbr[4] = {p - rowlen, p + rowlen, p + 1, p - 1};
+
+            A->rowptr[p] = e;
+            A->inv_diag[p] = 0.25;
+            if (i == 0 || i == rowlen - 1 || j == 0 || j == rowlen - 1) {
+                A->fixed[p] = 1;
+                continue;
+            }
+            for (int k = 0; k < 4; k++) {
+                A->col[e] = (int)nbr[k];
+                A->val[e++] = -1.0;
+            }
+        }
+    }
+    A->rowptr[rowlen * rowlen] = e;
+    return A;
+}
+
+static colour_ptr new_colours(int num_colours, long int rows)
+{
+    colour_ptr c = (colour_ptr)malloc(sizeof(colour_rec));
+    if (!c) return NULL;
+    c->num_colours = num_colours;
+    c->start = (long int *)calloc(num_colours + 1, sizeof(long int));
+    c->rows = (long int *)malloc((rows ? rows : 1) * sizeof(long int));
+    if (!c->start || !c->rows) {
+        free_colours(c);
+        return NULL;
+    }
+    return c;
+}
+
+void free_colours(colour_ptr c)
+{
+    if (!c) return;
+    free(c->start);
+    free(c->rows);
+    free(c);
+}
+
+/* Greedy first-fit colouring of the free rows in row order. A row avoids
+   the colours of the rows it reads and of the rows that read it, so any
+   pattern, symmetric or not, is coloured safely. */
+colour_ptr csr_colour(csr_ptr A)
+{
+    long int n = A->n, free_rows = 0;
+    long int *tptr = (long int *)calloc(n + 1, sizeof(long int));
+    long int *tcol = (long int *)malloc((A->nnz ? A->nnz : 1) * sizeof(long int));
+    int *colour = (int *)malloc((n ? n : 1) * sizeof(int));
+    long int *seen = NULL;
+    int num_colours = 0, max_degree = 0;
+    colour_ptr c = NULL;
+
+    if (!tptr || !tcol || !colour) goto out;
+    /* Transpose pattern: tcol[tptr[j] ..) are the rows that read j */
+    for (long int e = 0; e < A->nnz; e++) tptr[A->col[e] + 1]++;
+    for (long int j = 0; j < n; j++) tptr[j + 1] += tptr[j];
+    for (long int i = 0; i < n; i++) {
+        for (long int e = A->rowptr[i]; e < A->rowptr[i + 1]; e++) tcol[tptr[A->col[e]]++] = i;
+    }
+    for (long int j = n; j > 0; j--) tptr[j] = tptr[j - 1];
+    tptr[0] = 0;
+    for (long int i = 0; i < n; i++) {
+        long int d = (A->rowptr[i + 1] - A->rowptr[i]) + (tptr[i + 1] - tptr[i]);
+        if (d > max_degree) max_degree = (int)d;
+    }
+
+    /* seen[k] == i: colour k is taken by a neighbour of row i */
+    if (!(seen = (long int *)malloc((max_degree + 1) * sizeof(long int)))) goto out;
+    for (int k = 0; k <= max_degree; k++) seen[k] = -1;
+    for (long int i = 0; i < n; i++) {
+        int k = 0;
+
+        colour[i] = -1;
+        if (A->fixed[i]) continue;
+        for (long int e = A->rowptr[i]; e < A->rowptr[i + 1]; e++)
+            if (A->col[e] < i && colour[A->col[e]] >= 0) seen[colour[A->col[e]]] = i;
+        for (long int e = tptr[i]; e < tptr[i + 1]; e++)
+            if (tcol[e] < i && colour[tcol[e]] >= 0) seen[colour[tcol[e]]] = i;
+        while (seen[k] == i) k++;
+        colour[i] = k;
+        if (k + 1 > num_colours) num_colours = k + 1;
+        free_rows++;
+    }
+
+    if (!(c = new_colours(num_colours, free_rows))) goto out;
+    for (long int i = 0; i < n; i++)
+        if (colour[i] >= 0) c->start[colour[i] + 1]++;
+    for (int k = 0; k < num_colours; k++) c->start[k + 1] += c->start[k];
+    for (int k = 0; k <= max_degree; k++) seen[k] = k < num_colours ? c->start[k] : 0;
+    for (long int i = 0; i < n; i++)
+        if (colour[i] >= 0) c->rows[seen[colour[i]]++] = i;
+out:
+    free(tptr);
+    free(tcol);
+    free(colour);
+    free(seen);
+    return c;
+}
+
+/* SOR_redblack()'s colours: i + j odd first, then i + j even */
+colour_ptr grid_colour_redblack(long int rowlen)
+{
+    long int inner = rowlen - 2, r = 0;
+    colour_ptr c = new_colours(2, inner * inner);
+
+    if (!c) return NULL;
+    for (int redblack = 0; redblack < 2; redblack++) {
+        c->start[redblack] = r;
+        for (long int i = 1; i < rowlen - 1; i++) {
+            for (long int j = 1 + ((i ^ redblack) & 1); j < rowlen - 1; j += 2)
+                c->rows[r++] = i * rowlen + j;
+        }
+    }
+    c->start[2] = r;
+    return c;
+}
+
+typedef struct {
+    long int row, len;
+} sell_key;
+
+/* Longest first; ties in row order, so equal rows keep the colour's order */
+static int sell_key_cmp(const void *a, const void *b)
+{
+    const sell_key *x = (const sell_key *)a, *y = (const sell_key *)b;
+
+    if (x->len != y->len) return x->len > y->len ? -1 : 1;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+/* Longest row of the chunk at keys[r .. r + rows) */
+static long int sell_chunk_len(const sell_key *keys, long int r, long int rows)
+{
+    long int len = 0;
+
+    for (long int l = 0; l < rows; l++) len = keys[r + l].len > len ? keys[r + l].len : len;
+    return len;
+}
+
+/* SELL-SELL_C-sigma copy of A, chunks within colours. A sigma above 1 is
+   rounded up to a multiple of SELL_C so no chunk straddles two windows. */
+sell_ptr new_sell(csr_ptr A, colour_ptr c, long int sigma)
+{
+    long int chunks = 0, entries = 0, total_rows = c->start[c->num_colours];
+    sell_key *keys = (sell_key *)malloc((total_rows ? total_rows : 1) * sizeof(sell_key));
+    sell_ptr S = (sell_ptr)calloc(1, sizeof(sell_rec));
+
+    if (sigma > 1) sigma = (sigma + SELL_C - 1) / SELL_C * SELL_C;
+    else sigma = 1;
+    if (!keys || !S) goto fail;
+    S->n = A->n;
+    S->num_colours = c->num_colours;
+
+    /* Sort each colour in sigma windows, then count chunks and entries */
+    for (int k = 0; k < c->num_colours; k++) {
+        for (long int r = c->start[k]; r < c->start[k + 1]; r++) {
+            long int i = c->rows[r];
+            keys[r].row = i;
+            keys[r].len = A->rowptr[i + 1] - A->rowptr[i];
+        }
+        for (long int r = c->start[k]; r < c->start[k + 1]; r += sigma) {
+            long int w = c->start[k + 1] - r < sigma ? c->start[k + 1] - r : sigma;
+            qsort(keys + r, w, sizeof(sell_key), sell_key_cmp);
+        }
+        for (long int r = c->start[k]; r < c->start[k + 1]; r += SELL_C) {
+            long int rows = c->start[k + 1] - r < SELL_C ? c->start[k + 1] - r : SELL_C;
+            entries += sell_chunk_len(keys, r, rows) * SELL_C;
+            chunks++;
+        }
+    }
+
+    S->colour_chunk = (long int *)calloc(c->num_colours + 1, sizeof(long int));
+    S->chunk_ptr = (long int *)malloc((chunks + 1) * sizeof(long int));
+    S->chunk_rows = (int *)malloc((chunks ? chunks : 1) * sizeof(int));
+    S->row = (long int *)malloc((chunks ? chunks : 1) * SELL_C * sizeof(long int));
+    S->inv_diag = (double *)calloc((chunks ? chunks : 1) * SELL_C, sizeof(double));
+    S->rhs = (double *)calloc((chunks ? chunks : 1) * SELL_C, sizeof(double));
+    S->col = (int *)malloc((entries ? entries : 1) * sizeof(int));
+    S->val = (double *)malloc((entries ? entries : 1) * sizeof(double));
+    if (!S->colour_chunk || !S->chunk_ptr || !S->chunk_rows || !S->row || !S->inv_diag ||
+        !S->rhs || !S->col || !S->val)
+        goto fail;
+
+    chunks = 0;
+    entries = 0;
+    for (int k = 0; k < c->num_colours; k++) {
+        S->colour_chunk[k] = chunks;
+        for (long int r = c->start[k]; r < c->start[k + 1]; r += SELL_C, chunks++) {
+            int rows = c->start[k + 1] - r < SELL_C ? (int)(c->start[k + 1] - r) : SELL_C;
+            long int len = sell_chunk_len(keys, r, rows);
+
+            S->chunk_ptr[chunks] = entries;
+            S->chunk_rows[chunks] = rows;
+            for (int l = 0; l < SELL_C; l++) {
+                /* Unused lanes repeat lane 0's row with zero weights */
+                long int i = keys[r + (l < rows ? l : 0)].row;
+                long int e0 = A->rowptr[i], e1 = A->rowptr[i + 1];
+
+                S->row[chunks * SELL_C + l] = l < rows ? i : -1;
+                S->inv_diag[chunks * SELL_C + l] = l < rows ? A->inv_diag[i] : 0.0;
+                S->rhs[chunks * SELL_C + l] = l < rows ? A->rhs[i] : 0.0;
+                for (long int e = 0; e < len; e++) {
+                    int used = l < rows && e0 + e < e1;
+                    S->col[entries + e * SELL_C + l] = used ? A->col[e0 + e] : (int)i;
+                    S->val[entries + e * SELL_C + l] = used ? A->val[e0 + e] : 0.0;
+                }
+            }
+            entries += len * SELL_C;
+        }
+    }
+    S->colour_chunk[c->num_colours] = chunks;
+    S->chunk_ptr[chunks] = entries;
+    free(keys);
+    return S;
+
+fail:
+    free(keys);
+    free_sell(S);
+    return NULL;
+}
+
+void free_sell(sell_ptr S)
+{
+    if (!S) return;
+    free(S->colour_chunk);
+    free(S->chunk_ptr);
+    free(S->chunk_rows);
+    free(S->row);
+    free(S->inv_diag);
+    free(S->rhs);
+    free(S->col);
+    free(S->val);
+    free(S);
+}
+
+/* Update rows[r0 .. r1) of one colour; returns sum |change| */
+KERNEL_CLONES
+static double csr_sweep(csr_ptr A, data_t *x, const long int *rows, long int r0, long int r1,
+                        double omega)
+{
+    const long int *rowptr = A->rowptr;
+    const int *col = A->col;
+    const double *val = A->val;
+    double change, s, total_change = 0;
+
+    for (long int r = r0; r < r1; r++) {
+        long int i = rows[r];
+
+        s = A->rhs[i];
+        for (long int e = rowptr[i]; e < rowptr[i + 1]; e++) s -= val[e] * x[col[e]];
+        change = x[i] - A->inv_diag[i] * s;
+        x[i] -= change * omega;
+        total_change += fabs(change);
+    }
+    return total_change;
+}
+
+/* Update chunks k0 .. k1) of one colour, SELL_C rows at a time */
+KERNEL_CLONES
+static double sell_sweep(sell_ptr S, data_t *x, long int k0, long int k1, double omega)
+{
+    double change, s[SELL_C], total_change = 0;
+
+    for (long int k = k0; k < k1; k++) {
+        const long int len = (S->chunk_ptr[k + 1] - S->chunk_ptr[k]) / SELL_C;
+        const int *col = S->col + S->chunk_ptr[k];
+        const double *val = S->val + S->chunk_ptr[k];
+        const long int *row = S->row + k * SELL_C;
+
+        for (int l = 0; l < SELL_C; l++) s[l] = S->rhs[k * SELL_C + l];
+        for (long int e = 0; e < len; e++) {
+            for (int l = 0; l < SELL_C; l++) s[l] -= val[e * SELL_C + l] * x[col[e * SELL_C + l]];
+        }
+        for (int l = 0; l < S->chunk_rows[k]; l++) {
+            change = x[row[l]] - S->inv_diag[k * SELL_C + l] * s[l];
+            x[row[l]] -= change * omega;
+            total_change += fabs(change);
+        }
+    }
+    return total_change;
+}
+
+void SOR_csr(csr_ptr A, colour_ptr c, data_t *x, int *iterations)
+{
+    const double omega = OMEGA, tol = TOL;
+    double total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        for (int k = 0; k < c->num_colours; k++)
+            total_change += csr_sweep(A, x, c->rows, c->start[k], c->start[k + 1], omega);
+    } while ((total_change / (double)A->n) > tol);
+    *iterations = iters;
+}
+
+void SOR_sell(sell_ptr S, data_t *x, int *iterations)
+{
+    const double omega = OMEGA, tol = TOL;
+    double total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        for (int k = 0; k < S->num_colours; k++)
+            total_change += sell_sweep(S, x, S->colour_chunk[k], S->colour_chunk[k + 1], omega);
+    } while ((total_change / (double)S->n) > tol);
+    *iterations = iters;
+}
+
+/* Worker argument; td first so SOR_reduce_change() can take it */
+typedef struct {
+    thread_data_t td;
+    csr_ptr A;
+    colour_ptr c;
+    sell_ptr S;                 /* NULL = CSR */
+    data_t *x;
+} sparse_thread_t;
+
+/* Each colour's rows (or chunks) split in contiguous shares */
+static void *SOR_sparse_thread(void *arg)
+{
+    sparse_thread_t *st = (sparse_thread_t *)arg;
+    thread_data_t *data = &st->td;
+    const int t = data->thread_id, nt = data->num_threads;
+    const int colours = st->S ? st->S->num_colours : st->c->num_colours;
+    const long int *start = st->S ? st->S->colour_chunk : st->c->start;
+    const long int n = st->S ? st->S->n : st->A->n;
+    const double omega = OMEGA, tol = TOL;
+    double total_change;
+    int iters = 0;
+
+    do {
+        iters++;
+        total_change = 0;
+        TRACE_EVENT(t, TRACE_SWEEP_BEGIN, iters);
+        for (int k = 0; k < colours; k++) {
+            long int len = start[k + 1] - start[k];
+            long int r0 = start[k] + t * len / nt, r1 = start[k] + (t + 1) * len / nt;
+
+            /* The next colour reads this one; the last is covered by the reduction */
+            if (k) pthread_barrier_wait(&barrier);
+            total_change += st->S ? sell_sweep(st->S, st->x, r0, r1, omega)
+                                  : csr_sweep(st->A, st->x, st->c->rows, r0, r1, omega);
+        }
+        TRACE_EVENT(t, TRACE_SWEEP_END, iters);
+        total_change = SOR_reduce_change(data, total_change);
+    } while ((total_change / (double)n) > tol);
+
+    data->iterations = iters;
+    pthread_exit(NULL);
+}
+
+static void SOR_sparse_launch(csr_ptr A, colour_ptr c, sell_ptr S, data_t *x, int num_threads,
+                              int *iterations)
+{
+    pthread_t threads[num_threads];
+    sparse_thread_t thread_data[num_threads];
+    double partial_change[num_threads];
+    int rc;
+
+    pthread_barrier_init(&barrier, NULL, num_threads);
+    for (int i = 0; i < num_threads; i++) {
+        memset(&thread_data[i], 0, sizeof(sparse_thread_t));
+        thread_data[i].td.thread_id = i;
+        thread_data[i].td.num_threads = num_threads;
+        thread_data[i].td.partial_change = partial_change;
+        thread_data[i].A = A;
+        thread_data[i].c = c;
+        thread_data[i].S = S;
+        thread_data[i].x = x;
+        rc = pthread_create(&threads[i], NULL, SOR_sparse_thread, &thread_data[i]);
+        if (rc) {
+            printf("ERROR; return code from pthread_create() is %d\n", rc);
+            exit(-1);
+        }
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    *iterations = thread_data[0].td.iterations;
+}
+
+void SOR_csr_threaded(csr_ptr A, colour_ptr c, data_t *x, int num_threads, int *iterations)
+{
+    SOR_sparse_launch(A, c, NULL, x, num_threads, iterations);
+}
+
+void SOR_sell_threaded(sell_ptr S, data_t *x, int num_threads, int *iterations)
+{
+    SOR_sparse_launch(NULL, NULL, S, x, num_threads, iterations);
+}
+
+#endif /* _SOR_SPARSE_H_ */
@@ -0,0 +1,304 @@
+/* Dataflow tile scheduler for blocked SOR, on a work-stealing pool.
+
+   SOR_blocked() visits BLOCK_ROWS x BLOCK_COLS tiles in row-major order.
+   Here each (tile, iteration) pair is a task. Tile (ti,tj) of iteration k
+   may run once
+
+       (ti-1,tj) and (ti,tj-1) have finished iteration k     (new N, W)
+       (ti+1,tj) and (ti,tj+1) have finished iteration k-1   (old S, E)
+
+   Together with the tile's own iteration k-1, these are exactly the
+   values SOR_blocked() would read, and they also guarantee that nothing
+   overwrites a value before its last reader has run. So every sweep
+   produces SOR_blocked()'s grid bit for bit, while tiles of several
+   iterations run concurrently as a diagonal wavefront. There are no
+   barriers: a finishing task decrements its dependants' counters and
+   pushes the ones that reach zero.
+
+   Convergence: every tile of iteration k is an ancestor of the
+   bottom-right tile of iteration k, so when that tile finishes the
+   iteration is complete. It then sums the per-tile |change| in tile
+   order (deterministic) and applies SOR()'s test. Tile (0,0) of
+   iteration k also waits for iteration k-TASK_DEPTH to complete without
+   converging, which bounds the iterations in flight. Iterations already
+   started when convergence is found still finish, so the result is
+   SOR_blocked()'s grid after *iterations sweeps, up to TASK_DEPTH-1 more
+   than SOR_blocked() would do.
+
+   Pool: one deque per worker. The owner pushes and pops at the tail
+   (LIFO, so the tile it just enabled is still in cache); idle workers
+   steal from other deques' heads. A short mutex guards each deque.
+   Every tile has at most one pending task, so a deque never holds more
+   than ntiles entries.
+
+   Header-only; include after sor_mt.h from one .c file.
+*/
+
+#ifndef _SOR_TASKS_H_
+#define _SOR_TASKS_H_
+
+#include <sched.h>
+#include <string.h>
+
+#include "sor_mt.h"
+
+#define TASK_MAX_THREADS 64
+
+int TASK_DEPTH = 3;             /* iterations in flight; 1 = no overlap */
+
+void SOR_tasks(arr_ptr v, int num_threads, int *iterations);
+
+typedef struct {
+    pthread_mutex_t lock;
+    int *task;                  /* tile ids, circular, capacity ntiles */
+    long int head, tail;        /* thieves take head, owner uses tail */
+} __attribute__((aligned(64))) task_deque;
+
+typedef struct {
+    data_t *data;
+    long int rowlen, brows, bcols;
+    int nti, ntj, ntiles, nthreads, depth;
+    int *pending;               /* unmet dependencies of each tile's next task */
+    int *iter;                  /* iteration each tile's next task is for */
+    double *tile_change;        /* (depth + 1) x ntiles */
+    task_deque *dq;
+    pthread_mutex_t gate;       /* tile (0,0) arming vs. iteration completion */
+    int gated;                  /* iteration (0,0) waits on the gate for, or 0 */
+    int done_iter;              /* last completed iteration */
+    int launched;               /* iterations whose (0,0) task was pushed */
+    int stop;
+    long int completed;         /* tasks finished */
+} task_graph;
+
+typedef struct {
+    task_graph *g;
+    int id;
+} task_worker;
+
+static void task_push(task_graph *g, int w, int tile)
+{
+    task_deque *d = &g->dq[w];
+
+    if (tile == 0) __atomic_add_fetch(&g->launched, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&d->lock);
+    d->task[d->tail++ % g->ntiles] = tile;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/* Owner pops the newest task; -1 if empty */
+static int task_pop(task_graph *g, int w)
+{
+    task_deque *d = &g->dq[w];
+    int tile = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) tile = d->task[--d->tail % g->ntiles];
+    pthread_mutex_unlock(&d->lock);
+    return tile;
+}
+
+/* Thief takes the oldest task; -1 if empty */
+static int task_steal(task_graph *g, int w)
+{
+    task_deque *d = &g->dq[w];
+    int tile = -1;
+
+    if (__atomic_load_n(&d->tail, __ATOMIC_RELAXED) <= __atomic_load_n(&d->head, __ATOMIC_RELAXED))
+        return -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) tile = d->task[d->head++ % g->ntiles];
+    pthread_mutex_unlock(&d->lock);
+    return tile;
+}
+
+/* One dependency of tile's next task met; run it when none are left */
+static void task_release(task_graph *g, int w, int tile)
+{
+    if (__atomic_sub_fetch(&g->pending[tile], 1, __ATOMIC_ACQ_REL) == 0) task_push(g, w, tile);
+}
+
+/* Dependencies of tile (ti,tj) for iteration k, excluding the gate */
+static int task_deps(const task_graph *g, int ti, int tj, int k)
+{
+    int n = (ti > 0) + (tj > 0);
+    if (k > 1) n += (ti < g->nti - 1) + (tj < g->ntj - 1);
+    return n;
+}
+
+/* Arm tile for iteration k; returns 1 if it is runnable right away */
+static int task_arm(task_graph *g, int tile, int k)
+{
+    int ti = tile / g->ntj, tj = tile % g->ntj;
+    int n = task_deps(g, ti, tj, k);
+
+    g->iter[tile] = k;
+    if (tile == 0) {
+        pthread_mutex_lock(&g->gate);
+        if (g->stop) {
+            /* Never runs again; keep later releases from reaching zero */
+            __atomic_store_n(&g->pending[0], 1 << 30, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&g->gate);
+            return 0;
+        }
+        if (k > g->depth && g->done_iter < k - g->depth) {
+            n++;
+            g->gated = k;
+        }
+        __atomic_store_n(&g->pending[0], n, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&g->gate);
+        return n == 0;
+    }
+    __atomic_store_n(&g->pending[tile], n, __ATOMIC_RELEASE);
+    return n == 0;
+}
+
+/* Iteration k is complete: test convergence, maybe open the gate */
+static void task_iteration_done(task_graph *g, int w, int k)
+{
+    const double *change = g->tile_change + (k % (g->depth + 1)) * g->ntiles;
+    double total_change = 0;
+    int open = 0;
+
+    for (int t = 0; t < g->ntiles; t++) total_change += change[t];
+    pthread_mutex_lock(&g->gate);
+    if (k > g->done_iter) g->done_iter = k;
+    if ((total_change / (double)(g->rowlen * g->rowlen)) <= TOL) {
+        __atomic_store_n(&g->stop, 1, __ATOMIC_RELEASE);
+    } else if (g->gated == k + g->depth) {
+        g->gated = 0;
+        open = 1;
+    }
+    pthread_mutex_unlock(&g->gate);
+    if (open) task_release(g, w, 0);
+}
+
+KERNEL_CLONES
+static void task_run(task_graph *g, int w, int tile)
+{
+    int ti = tile / g->ntj, tj = tile % g->ntj, k = g->iter[tile];
+    long int rowlen = g->rowlen;
+    long int ii = 1 + ti * g->brows, jj = 1 + tj * g->bcols;
+    long int iend = (ii + g->brows < rowlen - 1) ? ii + g->brows : rowlen - 1;
+    long int jend = (jj + g->bcols < rowlen - 1) ? jj + g->bcols : rowlen - 1;
+    data_t *data = g->data;
+    const double omega = OMEGA;
+    double change, total_change = 0;
+
+    for (long int i = ii; i < iend; i++) {
+        for (long int j = jj; j < jend; j++) {
+            change = data[i * rowlen + j] - .25 * (data[(i - 1) * rowlen + j] +
+                                                   data[(i + 1) * rowlen + j] +
+                                                   data[i * rowlen + j + 1] +
+                                                   data[i * rowlen + j - 1]);
+            data[i * rowlen + j] -= change * omega;
+            total_change += fabs(change);
+        }
+    }
+    g->tile_change[(k % (g->depth + 1)) * g->ntiles + tile] = total_change;
+
+    /* Before releasing anyone, so iteration k+1 cannot complete first */
+    if (tile == g->ntiles - 1) task_iteration_done(g, w, k);
+
+    /* Re-arm before releasing anyone: the releases for our next task can
+       only come from tasks that depend on this one */
+    if (task_arm(g, tile, k + 1)) task_push(g, w, tile);
+    if (tj < g->ntj - 1) task_release(g, w, tile + 1);           /* E, iteration k */
+    if (ti < g->nti - 1) task_release(g, w, tile + g->ntj);      /* S, iteration k */
+    if (ti > 0) task_release(g, w, tile - g->ntj);               /* N, iteration k+1 */
+    if (tj > 0) task_release(g, w, tile - 1);                    /* W, iteration k+1 */
+    __atomic_add_fetch(&g->completed, 1, __ATOMIC_RELEASE);
+}
+
+static void *task_worker_main(void *arg)
+{
+    task_worker *tw = (task_worker *)arg;
+    task_graph *g = tw->g;
+    int w = tw->id, tile;
+
+    for (;;) {
+        tile = task_pop(g, w);
+        for (int s = 1; tile < 0 && s < g->nthreads; s++)
+            tile = task_steal(g, (w + s) % g->nthreads);
+        if (tile >= 0) {
+            task_run(g, w, tile);
+            continue;
+        }
+        /* Idle: finished once stopped and every launched iteration is done */
+        if (__atomic_load_n(&g->stop, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&g->completed, __ATOMIC_ACQUIRE) ==
+            (long int)g->ntiles * __atomic_load_n(&g->launched, __ATOMIC_ACQUIRE))
+            break;
+        sched_yield();
+    }
+    pthread_exit(NULL);
+}
+
+/* Blocked SOR on v as a tile task graph over num_threads workers */
+void SOR_tasks(arr_ptr v, int num_threads, int *iterations)
+{
+    long int rowlen = v->rowlen, brows = BLOCK_ROWS, bcols = BLOCK_COLS;
+    pthread_t threads[TASK_MAX_THREADS];
+    task_worker workers[TASK_MAX_THREADS];
+    task_graph g;
+
+    if (brows < 1 || bcols < 1 || TASK_DEPTH < 1 ||
+        num_threads < 1 || num_threads > TASK_MAX_THREADS) {
+        fprintf(stderr, "SOR_tasks: block %ldx%ld, depth %d, %d threads is invalid\n",
+                brows, bcols, TASK_DEPTH, num_threads);
+        exit(-1);
+    }
+    memset(&g, 0, sizeof(g));
+    g.data = v->data;
+    g.rowlen = rowlen;
+    g.brows = brows;
+    g.bcols = bcols;
+    g.nti = (int)((rowlen - 2 + brows - 1) / brows);
+    g.ntj = (int)((rowlen - 2 + bcols - 1) / bcols);
+    g.ntiles = g.nti * g.ntj;
+    g.nthreads = num_threads;
+    g.depth = TASK_DEPTH;
+    g.pending = (int *)calloc(g.ntiles, sizeof(int));
+    g.iter = (int *)calloc(g.ntiles, sizeof(int));
+    g.tile_change = (double *)calloc((g.depth + 1) * g.ntiles, sizeof(double));
+    g.dq = NULL;
+    if (posix_memalign((void **)&g.dq, 64, num_threads * sizeof(task_deque)) ||
+        !g.pending || !g.iter || !g.tile_change) {
+        fprintf(stderr, "SOR_tasks: could not allocate the task graph\n");
+        exit(-1);
+    }
+    for (int w = 0; w < num_threads; w++) {
+        pthread_mutex_init(&g.dq[w].lock, NULL);
+        g.dq[w].head = g.dq[w].tail = 0;
+        if (!(g.dq[w].task = (int *)malloc(g.ntiles * sizeof(int)))) {
+            fprintf(stderr, "SOR_tasks: could not allocate the task graph\n");
+            exit(-1);
+        }
+    }
+    pthread_mutex_init(&g.gate, NULL);
+
+    for (int t = 0; t < g.ntiles; t++) task_arm(&g, t, 1);
+    task_push(&g, 0, 0);
+
+    for (int w = 0; w < num_threads; w++) {
+        workers[w].g = &g;
+        workers[w].id = w;
+        if (pthread_create(&threads[w], NULL, task_worker_main, &workers[w])) {
+            printf("ERROR; SOR_tasks could not create thread %d\n", w);
+            exit(-1);
+        }
+    }
+    for (int w = 0; w < num_threads; w++) pthread_join(threads[w], NULL);
+
+    *iterations = g.launched;
+    for (int w = 0; w < num_threads; w++) {
+        pthread_mutex_destroy(&g.dq[w].lock);
+        free(g.dq[w].task);
+    }
+    pthread_mutex_destroy(&g.gate);
+    free(g.dq);
+    free(g.pending);
+    free(g.iter);
+    free(g.tile_change);
+}
+
+#endif /* _SOR_TASKS_H_ */
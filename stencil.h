@@ -0,0 +1,246 @@
+/* Generic stencil SOR engine: right-hand side, variable coefficients,
+   5- and 9-point stencils, on the usual arr_rec grid.
+
+   Every other kernel hard-codes Laplace (A u = 0 with the 5-point
+   operator). Here a stencil_rec describes the linear system
+
+       diag(p) u(p) - sum_k c_k(p) u(p + off_k) = f(p)
+
+   over the interior points, neighbours k in the order N S E W, then
+   NE NW SE SW for 9 points. The ghost ring supplies Dirichlet values as
+   before. Each coefficient is either a constant (w[k], centre) or a
+   per-point array laid out like the grid (coef[k], diag); f is optional
+   and is taken as already scaled by h^2. The update and the convergence
+   test are SOR()'s with the general Gauss-Seidel value:
+
+       change = u - (f + sum_k c_k u_k) / diag
+       u     -= change * OMEGA
+       stop when sum|change| / rowlen^2 <= TOL
+
+   With all coefficients constant, SOR_stencil() runs a fast path: the
+   weights are pre-divided by the centre and one loop is compiled for each
+   combination of 5/9 points, isotropic weights and source term. It keeps
+   SOR_blocked()'s tiling, and for stencil_laplace5() without f it does the
+   same arithmetic, so the results are bitwise identical and it runs at the
+   same speed. Any per-point array, or STENCIL_FAST = 0, selects the
+   general path.
+
+   Header-only; include after sor.h from one .c file.
+*/
+
+#ifndef _STENCIL_H_
+#define _STENCIL_H_
+
+#include <string.h>
+
+#include "sor.h"
+
+#define STENCIL_5PT 5
+#define STENCIL_9PT 9
+
+typedef struct {
+    int points;                 /* STENCIL_5PT or STENCIL_9PT */
+    double w[8];                /* constant neighbour weights, N S E W NE NW SE SW */
+    double centre;              /* constant centre weight */
+    const data_t *coef[8];      /* per-point neighbour weights, or NULL for w[k] */
+    const data_t *diag;         /* per-point centre weight, or NULL for centre */
+    const data_t *f;            /* right-hand side, or NULL for 0 */
+} stencil_rec, *stencil_ptr;
+
+int STENCIL_FAST = 1;           /* 0 forces the general per-point path */
+
+void stencil_laplace5(stencil_ptr s);
+void stencil_laplace9(stencil_ptr s);
+void stencil_set_source(stencil_ptr s, const data_t *f);
+void stencil_set_diffusion(stencil_ptr s, const data_t *k, long int rowlen, data_t *coefs);
+double stencil_residual(arr_ptr v, const stencil_rec *s);
+void SOR_stencil(arr_ptr v, const stencil_rec *s, int *iterations);
+
+/* 4u - (N + S + E + W) = f; SOR()'s operator */
+void stencil_laplace5(stencil_ptr s)
+{
+    memset(s, 0, sizeof(*s));
+    s->points = STENCIL_5PT;
+    for (int k = 0; k < 4; k++) s->w[k] = 1.0;
+    s->centre = 4.0;
+}
+
+/* 20u - 4(N + S + E + W) - (NE + NW + SE + SW) = f, the compact 4th-order
+   ("Mehrstellen") Laplacian; f is then 6h^2 times the smoothed source */
+void stencil_laplace9(stencil_ptr s)
+{
+    memset(s, 0, sizeof(*s));
+    s->points = STENCIL_9PT;
+    for (int k = 0; k < 4; k++) s->w[k] = 4.0;
+    for (int k = 4; k < 8; k++) s->w[k] = 1.0;
+    s->centre = 20.0;
+}
+
+void stencil_set_source(stencil_ptr s, const data_t *f) { s->f = f; }
+
+/* 5-point -div(k grad u) for a conductivity k given at every grid point
+   (ghosts included); face weights are the mean of the two points' k.
+   coefs must hold 5 rowlen^2 arrays: N, S, E, W weights, then diag. */
+void stencil_set_diffusion(stencil_ptr s, const data_t *k, long int rowlen, data_t *coefs)
+{
+    const long int N = rowlen * rowlen;
+    const long int off[4] = {-rowlen, rowlen, 1, -1};
+    data_t *diag = coefs + 4 * N;
+
+    stencil_laplace5(s);
+    memset(coefs, 0, 5 * N * sizeof(data_t));
+    for (long int i = 1; i < rowlen - 1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            long int p = i * rowlen + j;
+            for (int d = 0; d < 4; d++) {
+                coefs[d * N + p] = 0.5 * (k[p] + k[p + off[d]]);
+                diag[p] += coefs[d * N + p];
+            }
+        }
+    }
+    for (int d = 0; d < 4; d++) s->coef[d] = coefs + d * N;
+    s->diag = diag;
+}
+
+/* Gauss-Seidel value at p, any mix of constant and per-point coefficients */
+static inline double stencil_gs_general(const stencil_rec *s, const data_t *u,
+                                        long int p, long int rowlen)
+{
+    const long int off[8] = {-rowlen, rowlen, 1, -1,
+                             -rowlen + 1, -rowlen - 1, rowlen + 1, rowlen - 1};
+    double sum = s->f ? s->f[p] : 0.0;
+
+    for (int k = 0; k < s->points - 1; k++)
+        sum += (s->coef[k] ? s->coef[k][p] : s->w[k]) * u[p + off[k]];
+    return sum / (s->diag ? s->diag[p] : s->centre);
+}
+
+/* Mean |change| of a further sweep, without modifying the grid */
+KERNEL_CLONES
+double stencil_residual(arr_ptr v, const stencil_rec *s)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    double total_change = 0;
+
+    for (long int i = 1; i < rowlen - 1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            long int p = i * rowlen + j;
+            total_change += fabs(data[p] - stencil_gs_general(s, data, p, rowlen));
+        }
+    }
+    return total_change / (double)(rowlen * rowlen);
+}
+
+/* One general sweep, lexicographic order */
+KERNEL_CLONES
+static double stencil_sweep_general(data_t *u, long int rowlen, const stencil_rec *s,
+                                    double omega)
+{
+    double change, total_change = 0;
+
+    for (long int i = 1; i < rowlen - 1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            long int p = i * rowlen + j;
+            change = u[p] - stencil_gs_general(s, u, p, rowlen);
+            u[p] -= change * omega;
+            total_change += fabs(change);
+        }
+    }
+    return total_change;
+}
+
+/* One constant-coefficient sweep in SOR_blocked() tiles. w[] is already
+   divided by the centre weight; nine, iso and has_f are literals at every
+   call site, so each combination inlines into its own branch-free loop. */
+static inline __attribute__((always_inline))
+double stencil_sweep_const(data_t *u, const data_t *f, long int rowlen, const double *w,
+                           double inv_c, double omega, int nine, int iso, int has_f)
+{
+    const long int brows = BLOCK_ROWS, bcols = BLOCK_COLS;
+    double gs, change, total_change = 0;
+
+    for (long int ii = 1; ii < rowlen - 1; ii += brows) {
+        long int iend = (ii + brows < rowlen - 1) ? ii + brows : rowlen - 1;
+        for (long int jj = 1; jj < rowlen - 1; jj += bcols) {
+            long int jend = (jj + bcols < rowlen - 1) ? jj + bcols : rowlen - 1;
+            for (long int i = ii; i < iend; i++) {
+                for (long int j = jj; j < jend; j++) {
+                    long int p = i * rowlen + j;
+                    if (iso) {
+                        gs = w[0] * (u[p - rowlen] + u[p + rowlen] + u[p + 1] + u[p - 1]);
+                        if (nine)
+                            gs += w[4] * (u[p - rowlen + 1] + u[p - rowlen - 1] +
+                                          u[p + rowlen + 1] + u[p + rowlen - 1]);
+                    } else {
+                        gs = w[0] * u[p - rowlen] + w[1] * u[p + rowlen] +
+                             w[2] * u[p + 1] + w[3] * u[p - 1];
+                        if (nine)
+                            gs += w[4] * u[p - rowlen + 1] + w[5] * u[p - rowlen - 1] +
+                                  w[6] * u[p + rowlen + 1] + w[7] * u[p + rowlen - 1];
+                    }
+                    if (has_f) gs += inv_c * f[p];
+                    change = u[p] - gs;
+                    u[p] -= change * omega;
+                    total_change += fabs(change);
+                }
+            }
+        }
+    }
+    return total_change;
+}
+
+/* SOR on A u = f as described by s */
+KERNEL_CLONES
+void SOR_stencil(arr_ptr v, const stencil_rec *s, int *iterations)
+{
+    long int rowlen = get_arr_rowlen(v);
+    data_t *data = get_array_start(v);
+    const double omega = OMEGA, tol = TOL;
+    const data_t *f = s->f;
+    double w[8], inv_c, total_change = 1.0e10;
+    int nine = s->points == STENCIL_9PT, iso = 1, general = !STENCIL_FAST;
+    int iters = 0;
+
+    if (s->points != STENCIL_5PT && s->points != STENCIL_9PT) {
+        fprintf(stderr, "SOR_stencil: %d-point stencils are not supported\n", s->points);
+        exit(-1);
+    }
+    if (!s->diag && s->centre == 0.0) {
+        fprintf(stderr, "SOR_stencil: centre weight is zero\n");
+        exit(-1);
+    }
+    if (BLOCK_ROWS < 1 || BLOCK_COLS < 1) {
+        fprintf(stderr, "SOR_stencil: block shape %ldx%ld is invalid\n", BLOCK_ROWS, BLOCK_COLS);
+        exit(-1);
+    }
+
+    if (s->diag) general = 1;
+    for (int k = 0; k < s->points - 1; k++) {
+        if (s->coef[k]) general = 1;
+        if (s->w[k] != s->w[k < 4 ? 0 : 4]) iso = 0;
+    }
+    inv_c = s->diag ? 0.0 : 1.0 / s->centre;
+    for (int k = 0; k < 8; k++) w[k] = (k < s->points - 1) ? s->w[k] * inv_c : 0.0;
+
+    while ((total_change / (double)(rowlen * rowlen)) > tol) {
+        iters++;
+        if (general) {
+            total_change = stencil_sweep_general(data, rowlen, s, omega);
+            continue;
+        }
+        switch ((nine << 2) | (iso << 1) | (f != NULL)) {
+        case 0: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 0, 0, 0); break;
+        case 1: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 0, 0, 1); break;
+        case 2: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 0, 1, 0); break;
+        case 3: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 0, 1, 1); break;
+        case 4: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 1, 0, 0); break;
+        case 5: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 1, 0, 1); break;
+        case 6: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 1, 1, 0); break;
+        default: total_change = stencil_sweep_const(data, f, rowlen, w, inv_c, omega, 1, 1, 1); break;
+        }
+    }
+    *iterations = iters;
+}
+
+#endif /* _STENCIL_H_ */
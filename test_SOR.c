@@ -5,302 +5,355 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
 #include <pthread.h>
 
-#ifdef __APPLE__
-#include "apple_pthread_barrier.h"
-#endif /* __APPLE__ */
+#include "bench_harness.h"
+#include "sor.h"
+#include "sor_line.h"
+#include "sor_sparse.h"
 
-#define CPNS 2.0    /* Cycles per nanosecond - adjust for your CPU frequency */
-#define GHOST 2     /* Extra rows/columns for "ghost zone" */
 #define A   8       /* Coefficient of x^2 */
 #define B   16      /* Coefficient of x */
 #define C   32      /* Constant term */
 #define NUM_TESTS 5 /* Number of different array sizes to test */
-#define BLOCK_SIZE 8 /* Optimal block size determined experimentally */
-#define OPTIONS 4   /* Number of SOR implementations */
-#define MINVAL 0.0
-#define MAXVAL 10.0
-#define TOL 0.00001
-#define OMEGA 1.75  /* Best performing relaxation parameter from Part 1 */
-
-typedef double data_t;
+#define OPTIONS 10  /* Number of SOR implementations */
 
+/* One (kernel, grid size) measurement, passed to the bench_run() hooks */
 typedef struct {
-    long int rowlen;
-    data_t *data;
-} arr_rec, *arr_ptr;
+    arr_ptr v;
+    long int row_len;
+    int option;
+    int iters;
+    csr_ptr csr;            /* options 8 and 9: the grid as a sparse system */
+    colour_ptr colours;
+    sell_ptr sell;
+} sor_case;
+
+/* grid_to_csr() with SOR_redblack()'s colours, for a new grid size only */
+void sor_case_sparse(sor_case *sc)
+{
+    if (sc->csr && sc->csr->n == sc->row_len * sc->row_len) return;
+    free_sell(sc->sell);
+    free_colours(sc->colours);
+    free_csr(sc->csr);
+    sc->csr = grid_to_csr(sc->row_len);
+    sc->colours = sc->csr ? grid_colour_redblack(sc->row_len) : NULL;
+    sc->sell = sc->colours ? new_sell(sc->csr, sc->colours, SELL_SIGMA) : NULL;
+    if (!sc->sell) {
+        fprintf(stderr, "test_SOR: could not build the sparse system for %ld^2\n", sc->row_len);
+        exit(-1);
+    }
+}
 
-/* Function Prototypes */
-arr_ptr new_array(long int row_len);
-int set_arr_rowlen(arr_ptr v, long int index);
-long int get_arr_rowlen(arr_ptr v);
-int init_array_rand(arr_ptr v, long int row_len);
-data_t *get_array_start(arr_ptr v);
-void SOR(arr_ptr v, int *iterations);
-void SOR_redblack(arr_ptr v, int *iterations);
-void SOR_ji(arr_ptr v, int *iterations);
-void SOR_blocked(arr_ptr v, int *iterations);
+/* The grid's interior as a sparse system of its own: the ghost ring is
+   folded into rhs, so rows next to it are shorter (2 or 3 entries) */
+csr_ptr interior_csr(const data_t *grid, long int rowlen)
+{
+    long int inner = rowlen - 2, e = 0;
+    csr_ptr M = new_csr(inner * inner, 4 * inner * inner);
+
+    if (!M) return NULL;
+    for (long int i = 1; i < rowlen - 1; i++) {
+        for (long int j = 1; j < rowlen - 1; j++) {
+            long int p = (i - 1) * inner + (j - 1);
+            const long int ni[4] = {i - 1, i + 1, i, i}, nj[4] = {j, j, j + 1, j - 1};
+
+            M->rowptr[p] = e;
+            M->inv_diag[p] = 0.25;
+            for (int k = 0; k < 4; k++) {
+                if (ni[k] == 0 || ni[k] == rowlen - 1 || nj[k] == 0 || nj[k] == rowlen - 1) {
+                    M->rhs[p] += grid[ni[k] * rowlen + nj[k]];
+                } else {
+                    M->col[e] = (int)((ni[k] - 1) * inner + (nj[k] - 1));
+                    M->val[e++] = -1.0;
+                }
+            }
+        }
+    }
+    M->rowptr[inner * inner] = e;
+    M->nnz = e;
+    return M;
+}
 
-double interval(struct timespec start, struct timespec end)
+/* SOR_sell() against SOR_csr() on interior_csr(), whose rows differ in
+   length, for the unsorted layout, a window that is not a multiple of
+   SELL_C and SELL_SIGMA; returns the number of mismatches */
+int sell_irregular_check(arr_ptr v, long int rowlen)
 {
-    struct timespec temp;
-    temp.tv_sec = end.tv_sec - start.tv_sec;
-    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
-    if (temp.tv_nsec < 0) {
-        temp.tv_sec -= 1;
-        temp.tv_nsec += 1000000000;
+    const long int sigmas[3] = {1, SELL_C + SELL_C / 2, SELL_SIGMA};
+    long int inner = rowlen - 2, N = inner * inner;
+    data_t *x_csr = (data_t *)malloc(N * sizeof(data_t)), *x_sell = (data_t *)malloc(N * sizeof(data_t));
+    csr_ptr M;
+    colour_ptr colours;
+    int csr_iters, sell_iters, mismatches = 0;
+
+    init_array_rand(v, rowlen);
+    M = interior_csr(v->data, rowlen);
+    colours = M ? csr_colour(M) : NULL;
+    if (!x_csr || !x_sell || !colours) {
+        fprintf(stderr, "test_SOR: could not build the %ld^2 interior system\n", inner);
+        exit(-1);
+    }
+    for (long int i = 0; i < inner; i++)
+        memcpy(x_csr + i * inner, v->data + (i + 1) * rowlen + 1, inner * sizeof(data_t));
+    memcpy(x_sell, x_csr, N * sizeof(data_t));
+    SOR_csr(M, colours, x_csr, &csr_iters);
+
+    printf("\nSELL vs. CSR on the %ld^2 interior system (rows of 2-4 entries):\n", inner);
+    printf("Sigma, CSR iters, SELL iters, Max |diff|\n");
+    for (int k = 0; k < 3; k++) {
+        sell_ptr S = new_sell(M, colours, sigmas[k]);
+        double diff = 0;
+
+        if (!S) {
+            fprintf(stderr, "test_SOR: could not build SELL-%d-%ld\n", SELL_C, sigmas[k]);
+            exit(-1);
+        }
+        for (long int i = 0; i < inner; i++)
+            memcpy(x_sell + i * inner, v->data + (i + 1) * rowlen + 1, inner * sizeof(data_t));
+        SOR_sell(S, x_sell, &sell_iters);
+        for (long int p = 0; p < N; p++) diff = fmax(diff, fabs(x_sell[p] - x_csr[p]));
+        printf("%4ld, %5d, %5d, %.3g\n", sigmas[k], csr_iters, sell_iters, diff);
+        if (sell_iters != csr_iters || diff > TOL) {
+            printf("MISMATCH sigma=%ld: SELL %d sweeps, CSR %d, max |diff| %.3g\n", sigmas[k],
+                   sell_iters, csr_iters, diff);
+            mismatches++;
+        }
+        free_sell(S);
+    }
+    free_colours(colours);
+    free_csr(M);
+    free(x_csr);
+    free(x_sell);
+    return mismatches;
+}
+
+/* init_array_rand() with CRNG_PAR_MIN = 1, so even a 1-CPU host takes
+   the threaded path, at several thread counts against one thread: the
+   grids must be bitwise identical. 1027 is odd, so the thread row splits
+   are uneven and each row ends in a scalar tail. Returns the number of
+   mismatches */
+int crng_thread_check(void)
+{
+    const long int rowlen = 1027;
+    const int counts[] = {2, 3, 4, 7, 13};
+    const int saved_threads = CRNG_THREADS;
+    const long int saved_min = CRNG_PAR_MIN;
+    arr_ptr ref = new_array(rowlen), v = new_array(rowlen);
+    int mismatches = 0;
+
+    if (!ref || !v) {
+        fprintf(stderr, "test_SOR: could not allocate %ld^2 grids\n", rowlen);
+        exit(-1);
+    }
+    CRNG_PAR_MIN = 1;
+    CRNG_THREADS = 1;
+    init_array_rand(ref, rowlen);
+    printf("\nCounter-based init, %ld^2 grid, threads vs. 1 thread:\n", rowlen);
+    for (int k = 0; k < 5; k++) {
+        CRNG_THREADS = counts[k];
+        memset(v->data, 0, rowlen * rowlen * sizeof(data_t));
+        init_array_rand(v, rowlen);
+        if (memcmp(v->data, ref->data, rowlen * rowlen * sizeof(data_t)) != 0) {
+            printf("MISMATCH crng: %d threads fill a different grid\n", counts[k]);
+            mismatches++;
+        } else {
+            printf("%d threads: identical\n", counts[k]);
+        }
+    }
+    CRNG_THREADS = saved_threads;
+    CRNG_PAR_MIN = saved_min;
+    free_array(ref);
+    free_array(v);
+    return mismatches;
+}
+
+void sor_case_setup(void *arg)
+{
+    sor_case *sc = (sor_case *)arg;
+    init_array_rand(sc->v, sc->row_len);
+    set_arr_rowlen(sc->v, sc->row_len);
+    if (sc->option >= 8) sor_case_sparse(sc);
+}
+
+void sor_case_run(void *arg)
+{
+    sor_case *sc = (sor_case *)arg;
+    switch (sc->option) {
+        case 0: SOR(sc->v, &sc->iters); break;
+        case 1: SOR_redblack(sc->v, &sc->iters); break;
+        case 2: SOR_ji(sc->v, &sc->iters); break;
+        case 3: SOR_blocked(sc->v, &sc->iters); break;
+        case 4: SOR_deferred(sc->v, &sc->iters); break;
+        case 5: SOR_blocked_deferred(sc->v, &sc->iters); break;
+        case 6: SOR_oblivious(sc->v, &sc->iters); break;
+        case 7: SOR_line(sc->v, &sc->iters); break;
+        case 8: SOR_csr(sc->csr, sc->colours, sc->v->data, &sc->iters); break;
+        case 9: SOR_sell(sc->sell, sc->v->data, &sc->iters); break;
     }
-    return (((double)temp.tv_sec) + ((double)temp.tv_nsec) * 1.0e-9);
 }
 
 /*****************************************************************************/
 int main(int argc, char *argv[])
 {
     int OPTION;
-    struct timespec time_start, time_stop;
-    double time_stamp[OPTIONS][NUM_TESTS];
+    bench_stats stats[OPTIONS][NUM_TESTS];
     int convergence[OPTIONS][NUM_TESTS];
-    int *iterations;
+    bench_stats opt_stats[NUM_TESTS];   /* SOR() at its optimal omega */
+    int opt_iters[NUM_TESTS];
+    double omega_fixed = OMEGA;
+    int mismatches = 0;
+    const char *option_names[] = {"Standard SOR", "Red/Black SOR", "Reversed Indices SOR", "Blocked SOR",
+                                  "Deferred-Residual SOR", "Deferred-Residual Blocked SOR",
+                                  "Cache-Oblivious SOR", "Zebra Line SOR", "Sparse CSR SOR",
+                                  "Sparse SELL-C-sigma SOR"};
+    const char *kernel_names[] = {"SOR", "SOR_redblack", "SOR_ji", "SOR_blocked",
+                                  "SOR_deferred", "SOR_blocked_deferred", "SOR_oblivious",
+                                  "SOR_line", "SOR_csr", "SOR_sell"};
+    bench_cfg cfg = bench_cfg_from_env();
+    bench_out csv, json;
+    sor_case sc;
 
     long int x, n;
     long int alloc_size = GHOST + A * (NUM_TESTS - 1) * (NUM_TESTS - 1) + B * (NUM_TESTS - 1) + C;
 
     printf("SOR Serial Optimizations Benchmark\n");
     printf("Using OMEGA = %0.2f\n", OMEGA);
+    printf("Warmup %d, repeats %d, TSC %.3f cycles/ns\n", cfg.warmup, cfg.repeats, bench_cpns());
+    cpu_dispatch_report(stdout);
+    bench_out_from_env(&csv, &json);
 
-    arr_ptr v0 = new_array(alloc_size);
-    iterations = (int *)malloc(sizeof(int));
+    arr_ptr v0 = new_array(alloc_size), v1 = new_array(alloc_size);
+    sc.v = v0;
+    sc.csr = NULL;
+    sc.colours = NULL;
+    sc.sell = NULL;
 
     for (OPTION = 0; OPTION < OPTIONS; OPTION++) {
-        const char *option_names[] = {"Standard SOR", "Red/Black SOR", "Reversed Indices SOR", "Blocked SOR"};
         printf("\nOPTION %d: %s\n", OPTION, option_names[OPTION]);
 
         for (x = 0; x < NUM_TESTS && (n = A * x * x + B * x + C) <= alloc_size; x++) {
             printf("  Test %ld: Grid Size = %ld\n", x, (long)(GHOST + n));
-            init_array_rand(v0, GHOST + n);
-            set_arr_rowlen(v0, GHOST + n);
-
-            clock_gettime(CLOCK_REALTIME, &time_start);
-            switch (OPTION) {
-                case 0: SOR(v0, iterations); break;
-                case 1: SOR_redblack(v0, iterations); break;
-                case 2: SOR_ji(v0, iterations); break;
-                case 3: SOR_blocked(v0, iterations); break;
-            }
-            clock_gettime(CLOCK_REALTIME, &time_stop);
-
-            time_stamp[OPTION][x] = interval(time_start, time_stop);
-            convergence[OPTION][x] = *iterations;
+            sc.row_len = GHOST + n;
+            sc.option = OPTION;
+            bench_run(&cfg, sor_case_setup, sor_case_run, &sc, &stats[OPTION][x]);
+            convergence[OPTION][x] = sc.iters;
+            bench_out_row(&csv, kernel_names[OPTION], GHOST + n, 1, OMEGA, sc.iters, &stats[OPTION][x]);
+            bench_out_row(&json, kernel_names[OPTION], GHOST + n, 1, OMEGA, sc.iters, &stats[OPTION][x]);
         }
     }
 
+    /* Point SOR at its own optimum for each size, so the zebra table
+       compares the two solvers each at their best omega */
+    for (x = 0; x < NUM_TESTS && (n = A * x * x + B * x + C) <= alloc_size; x++) {
+        OMEGA = 2.0 / (1.0 + sin(M_PI / (GHOST + n - 1)));
+        printf("\nStandard SOR at omega %.3f, Grid Size = %ld\n", OMEGA, (long)(GHOST + n));
+        sc.row_len = GHOST + n;
+        sc.option = 0;
+        bench_run(&cfg, sor_case_setup, sor_case_run, &sc, &opt_stats[x]);
+        opt_iters[x] = sc.iters;
+    }
+    OMEGA = omega_fixed;
+
     /* Output results */
-    printf("\nFinal Results (Time in ns, Iterations to Convergence):\n");
-    printf("Size, SOR Time, SOR Iters, Red/Black Time, Red/Black Iters, Reversed Time, Reversed Iters, Blocked Time, Blocked Iters\n");
+    printf("\nFinal Results (median cycles +- stddev %%, Iterations to Convergence):\n");
+    printf("Size, SOR Time, SOR Iters, Red/Black Time, Red/Black Iters, Reversed Time, Reversed Iters, "
+           "Blocked Time, Blocked Iters, Deferred Time, Deferred Iters, Deferred Blocked Time, "
+           "Deferred Blocked Iters, Oblivious Time, Oblivious Iters, Line Time, Line Iters, "
+           "CSR Time, CSR Iters, SELL Time, SELL Iters\n");
     for (int i = 0; i < NUM_TESTS; i++) {
         printf("%4ld", A * i * i + B * i + C);
         for (OPTION = 0; OPTION < OPTIONS; OPTION++) {
-            printf(", %10.4g", (double)CPNS * 1.0e9 * time_stamp[OPTION][i]);
+            printf(", %10.4g +-%4.1f%%", stats[OPTION][i].cycles,
+                   100.0 * stats[OPTION][i].stddev / stats[OPTION][i].median);
             printf(", %4d", convergence[OPTION][i]);
         }
         printf("\n");
     }
 
-    free(iterations);
-    return 0;
-}
-
-/*********************************/
-
-/* Function Definitions */
-arr_ptr new_array(long int row_len)
-{
-    arr_ptr result = (arr_ptr)malloc(sizeof(arr_rec));
-    if (!result) return NULL;
-    result->rowlen = row_len;
-    result->data = (data_t *)calloc(row_len * row_len, sizeof(data_t));
-    if (!result->data) {
-        free(result);
-        return NULL;
+    /* Deferred residual vs. the same sweep order measured every sweep */
+    printf("\nTime saved by deferring the residual (%% of median):\n");
+    printf("Size, SOR, Blocked SOR\n");
+    for (int i = 0; i < NUM_TESTS; i++) {
+        printf("%4ld, %5.1f%%, %5.1f%%\n", (long)(A * i * i + B * i + C),
+               100.0 * (1.0 - stats[4][i].median / stats[0][i].median),
+               100.0 * (1.0 - stats[5][i].median / stats[3][i].median));
     }
-    return result;
-}
-
-int set_arr_rowlen(arr_ptr v, long int row_len) { v->rowlen = row_len; return 1; }
-long int get_arr_rowlen(arr_ptr v) { return v->rowlen; }
-data_t *get_array_start(arr_ptr v) { return v->data; }
 
-int init_array_rand(arr_ptr v, long int row_len)
-{
-    srandom(row_len);
-    for (long int i = 0; i < row_len * row_len; i++) {
-        v->data[i] = ((double)random() / RAND_MAX) * (MAXVAL - MINVAL) + MINVAL;
+    /* No block size to tune: per-sweep time against SOR_blocked() */
+    printf("\nCache-oblivious vs. blocked (%ldx%ld), cycles per sweep:\n", BLOCK_ROWS, BLOCK_COLS);
+    printf("Size, Blocked, Oblivious, Speedup\n");
+    for (int i = 0; i < NUM_TESTS; i++) {
+        double blocked = stats[3][i].cycles / convergence[3][i];
+        double oblivious = stats[6][i].cycles / convergence[6][i];
+        printf("%4ld, %10.4g, %10.4g, %5.2f\n", (long)(A * i * i + B * i + C), blocked, oblivious,
+               blocked / oblivious);
     }
-    return 1;
-}
-
-/************************************/
 
-/* Standard SOR */
-void SOR(arr_ptr v, int *iterations) {
-    long int rowlen = get_arr_rowlen(v);
-    data_t *data = get_array_start(v);
-    double change, total_change = 1.0e10;
-    int iters = 0;
-
-    while ((total_change / (rowlen * rowlen)) > TOL) {
-        iters++;
-        total_change = 0;
-        for (long int i = 1; i < rowlen - 1; i++) {
-            for (long int j = 1; j < rowlen - 1; j++) {
-                change = data[i * rowlen + j] - 0.25 * (data[(i - 1) * rowlen + j] +
-                                                        data[(i + 1) * rowlen + j] +
-                                                        data[i * rowlen + j + 1] +
-                                                        data[i * rowlen + j - 1]);
-                data[i * rowlen + j] -= change * OMEGA;
-                total_change += fabs(change);
-            }
-        }
+    /* Whole rows per update: far fewer sweeps, each a tridiagonal solve */
+    printf("\nZebra line SOR vs. point SOR at OMEGA %.2f and at its optimum, time to TOL:\n", OMEGA);
+    printf("Size, Line omega, Line iters, Line cycles, Point iters, Point cycles, Speedup, "
+           "Point opt omega, Point opt iters, Point opt cycles, Speedup vs. opt\n");
+    for (int i = 0; i < NUM_TESTS; i++) {
+        long int n = A * i * i + B * i + C;
+        printf("%4ld, %.3f, %5d, %10.4g, %5d, %10.4g, %5.2f, %.3f, %5d, %10.4g, %5.2f\n", n,
+               SOR_line_omega(GHOST + n), convergence[7][i], stats[7][i].cycles,
+               convergence[0][i], stats[0][i].cycles, stats[0][i].cycles / stats[7][i].cycles,
+               2.0 / (1.0 + sin(M_PI / (GHOST + n - 1))), opt_iters[i], opt_stats[i].cycles,
+               opt_stats[i].cycles / stats[7][i].cycles);
     }
-    *iterations = iters;
-}
-
-/* SOR red/black */
-void SOR_redblack(arr_ptr v, int *iterations)
-{
-  int i, j, redblack;
-  long int ti;
-  long int rowlen = get_arr_rowlen(v);
-  data_t *data = get_array_start(v);
-  double change, total_change = 1.0e10;   /* start w/ something big */
-  int iters = 0;
 
-  ti = 0;
-  redblack = 0;
-  /* The while condition here tests the tolerance limit *only* when
-     redblack is 0, which ensures we exit only after having done a
-     full update (red + black) */
-  while ((redblack == 1)
-        || ((total_change/(double)(rowlen*rowlen)) > (double)TOL) )
-  {
-    /* Reset sum of total change only when starting a black scan. */
-    if (redblack == 0) {
-      total_change = 0;
-    }
-    for (i = 1; i < rowlen-1; i++) {
-      /* The j loop needs to start at j=1 on row 0 and all even rows,
-         and start at j=2 on odd rows; but when redblack is true it does
-         just the opposite; and it always increments by 2. */
-      for (j = 1 + ((i^redblack)&1); j < rowlen-1; j+=2) {
-        change = data[i*rowlen+j] - .25 * (data[(i-1)*rowlen+j] +
-                                          data[(i+1)*rowlen+j] +
-                                          data[i*rowlen+j+1] +
-                                          data[i*rowlen+j-1]);
-        data[i*rowlen+j] -= change * OMEGA;
-        if (change < 0) {
-          change = -change;
+    /* Same sweeps as red/black through the sparse formats: the price of
+       the indirection, and a check that the final grids agree. The greedy
+       colouring a mesh would get should also find the grid's two colours. */
+    printf("\nSparse CSR / SELL-%d-%ld vs. red/black, cycles per sweep:\n", SELL_C, SELL_SIGMA);
+    printf("Size, Greedy colours, Red/Black, CSR, SELL, CSR overhead, SELL overhead, "
+           "CSR max |diff|, SELL max |diff|\n");
+    for (int i = 0; i < NUM_TESTS; i++) {
+        long int n = A * i * i + B * i + C, N = (GHOST + n) * (GHOST + n);
+        double rb = stats[1][i].cycles / convergence[1][i];
+        double csr = stats[8][i].cycles / convergence[8][i];
+        double sell = stats[9][i].cycles / convergence[9][i];
+        double diff_csr = 0, diff_sell = 0;
+        colour_ptr greedy;
+        int rb_iters, csr_iters, sell_iters;
+
+        sc.row_len = GHOST + n;
+        sor_case_sparse(&sc);
+        if (!(greedy = csr_colour(sc.csr))) {
+            fprintf(stderr, "test_SOR: could not colour the %ld^2 system\n", sc.row_len);
+            exit(-1);
         }
-        total_change += change;
-        ti++;
-      }
-    }
-    if (abs(data[(rowlen-2)*(rowlen-2)]) > 10.0*(MAXVAL - MINVAL)) {
-      printf("SOR: SUSPECT DIVERGENCE iter = %ld\n", iters);
-      break;
-    }
-    redblack ^= 1;
-    iters++;
-  }
-  /* A "red scan" only updates half of the array, and likewise for a
-     "black scan"; so we need to divide iters by 2 to convert our count of
-     "reds+blacks" to a count of "full scans" */
-  iters /= 2;
-  *iterations = iters;
-  printf("    SOR_redblack() done after %d iters\n", iters);
-  /* printf("ti == %ld, per iter %ld\n", ti, ti/iters); */
-} /* End of SOR_redblack */
-
-/* SOR with reversed indices */
-void SOR_ji(arr_ptr v, int *iterations)
-{
-  long int i, j;
-  long int rowlen = get_arr_rowlen(v);
-  data_t *data = get_array_start(v);
-  double change, total_change = 1.0e10;   /* start w/ something big */
-  int iters = 0;
-
-  while ((total_change/(double)(rowlen*rowlen)) > (double)TOL) {
-    iters++;
-    total_change = 0;
-    for (j = 1; j < rowlen-1; j++) {
-      for (i = 1; i < rowlen-1; i++) {
-        change = data[i*rowlen+j] - .25 * (data[(i-1)*rowlen+j] +
-                                          data[(i+1)*rowlen+j] +
-                                          data[i*rowlen+j+1] +
-                                          data[i*rowlen+j-1]);
-        data[i*rowlen+j] -= change * OMEGA;
-        if (change < 0){
-          change = -change;
+        init_array_rand(v1, GHOST + n);
+        set_arr_rowlen(v1, GHOST + n);
+        SOR_redblack(v1, &rb_iters);
+        init_array_rand(v0, GHOST + n);
+        SOR_csr(sc.csr, sc.colours, v0->data, &csr_iters);
+        for (long int p = 0; p < N; p++) diff_csr = fmax(diff_csr, fabs(v0->data[p] - v1->data[p]));
+        init_array_rand(v0, GHOST + n);
+        SOR_sell(sc.sell, v0->data, &sell_iters);
+        for (long int p = 0; p < N; p++) diff_sell = fmax(diff_sell, fabs(v0->data[p] - v1->data[p]));
+        printf("%4ld, %d, %10.4g, %10.4g, %10.4g, %5.2f, %5.2f, %.3g, %.3g\n", n, greedy->num_colours,
+               rb, csr, sell, csr / rb, sell / rb, diff_csr, diff_sell);
+        if (csr_iters != rb_iters || sell_iters != rb_iters || diff_csr > TOL || diff_sell > TOL) {
+            printf("MISMATCH n=%ld: red/black %d sweeps, CSR %d, SELL %d, max |diff| %.3g, %.3g\n",
+                   n, rb_iters, csr_iters, sell_iters, diff_csr, diff_sell);
+            mismatches++;
         }
-        total_change += change;
-      }
+        free_colours(greedy);
     }
-    if (abs(data[(rowlen-2)*(rowlen-2)]) > 10.0*(MAXVAL - MINVAL)) {
-      printf("SOR_ji: SUSPECT DIVERGENCE iter = %d\n", iters);
-      break;
-    }
-  }
-  *iterations = iters;
-  printf("    SOR_ji() done after %d iters\n", iters);
+    mismatches += sell_irregular_check(v1, GHOST + C);
+    mismatches += crng_thread_check();
+
+    bench_out_close(&csv);
+    bench_out_close(&json);
+    free_sell(sc.sell);
+    free_colours(sc.colours);
+    free_csr(sc.csr);
+    free_array(v0);
+    free_array(v1);
+    return mismatches ? EXIT_FAILURE : 0;
 }
-
-/* SOR w/ blocking */
-void SOR_blocked(arr_ptr v, int *iterations)
-{
-  long int i, j, ii, jj;
-  long int rowlen = get_arr_rowlen(v);
-  data_t *data = get_array_start(v);
-  double change, total_change = 1.0e10;
-  int iters = 0;
-  int k;
-
-  if ((rowlen-2) % (BLOCK_SIZE)) {
-    fprintf(stderr,
-"SOR_blocked: Total array size must be 2 more than a multiple of BLOCK_SIZE\n"
-"(because the top/right/left/bottom rows are not scanned)\n"
-"Make sure all coefficients A, B, and C are multiples of %d\n", BLOCK_SIZE);
-    exit(-1);
-  }
-
-  while ((total_change/(double)(rowlen*rowlen)) > (double)TOL) {
-    iters++;
-    total_change = 0;
-    for (ii = 1; ii < rowlen-1; ii+=BLOCK_SIZE) {
-      for (jj = 1; jj < rowlen-1; jj+=BLOCK_SIZE) {
-        for (i = ii; i < ii+BLOCK_SIZE; i++) {
-          for (j = jj; j < jj+BLOCK_SIZE; j++) {
-            change = data[i*rowlen+j] - .25 * (data[(i-1)*rowlen+j] +
-                                              data[(i+1)*rowlen+j] +
-                                              data[i*rowlen+j+1] +
-                                              data[i*rowlen+j-1]);
-            data[i*rowlen+j] -= change * OMEGA;
-            if (change < 0){
-              change = -change;
-            }
-            total_change += change;
-          }
-        }
-      }
-    }
-    if (abs(data[(rowlen-2)*(rowlen-2)]) > 10.0*(MAXVAL - MINVAL)) {
-      printf("SOR_blocked: SUSPECT DIVERGENCE iter = %d\n", iters);
-      break;
-    }
-  }
-  *iterations = iters;
-  printf("    SOR_blocked() done after %d iters\n", iters);
-} /* End of SOR_blocked */
-
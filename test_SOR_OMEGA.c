@@ -1,6 +1,6 @@
 /*****************************************************************************
 
-   gcc -O1 test_SOR_OMEGA.c -lm -o test_SOR_OMEGA
+   gcc -O1 -pthread test_SOR_OMEGA.c -lm -o test_SOR_OMEGA
 
  */
 
@@ -10,6 +10,9 @@
  #include <stdio.h>
  #include <stdlib.h>
  
+ #include "bench_harness.h"
+ #include "crng.h"
+ 
  #define MINVAL   0.0
  #define MAXVAL  100.0
  
@@ -36,7 +39,6 @@
  int init_array(arr_ptr v, long int row_len);
  int init_array_rand(arr_ptr v, long int row_len);
  int print_array(arr_ptr v);
- double fRand(double fMin, double fMax);
  void SOR(arr_ptr v, int *iterations);
  
  /* Define different array sizes for testing */
@@ -51,8 +53,12 @@
      double convergence[O_ITERS][NUM_ARRAY_SIZES];  
      int *iterations;
      long int i, j, k;
+     double trial_time[PER_O_TRIALS], t0;
+     bench_stats stats;
+     bench_out csv, json;
  
      printf("SOR OMEGA test\n");
+     bench_out_from_env(&csv, &json);
  
      /* Allocate memory for iterations count */
      iterations = (int *) malloc(sizeof(int));
@@ -74,12 +80,19 @@
              double acc = 0.0;
              for (j = 0; j < PER_O_TRIALS; j++) {
                  init_array_rand(v0, current_size);
+                 t0 = bench_now();
                  SOR(v0, iterations);
+                 trial_time[j] = bench_now() - t0;
                  acc += (double)(*iterations);
                  printf(", %d", *iterations);
              }
              printf("\n");
              convergence[i][k] = acc / (double)(PER_O_TRIALS);
+             /* Trials start from different random grids, so keep every
+                sample (no outlier rejection) */
+             bench_summarize(trial_time, PER_O_TRIALS, 0.0, &stats);
+             bench_out_row(&csv, "SOR", current_size, 1, OMEGA, convergence[i][k], &stats);
+             bench_out_row(&json, "SOR", current_size, 1, OMEGA, convergence[i][k], &stats);
              OMEGA += OMEGA_INC;
          }
  
@@ -102,6 +115,8 @@
          OMEGA += OMEGA_INC;
      }
  
+     bench_out_close(&csv);
+     bench_out_close(&json);
      free(iterations);
      return 0;
  }
@@ -158,27 +173,19 @@
      return 0;
  }
  
- /* initialize array with random numbers */
+ /* initialize array with random numbers; every call (trial) gets the
+    next crng.h stream, so trials differ but each run repeats exactly */
  int init_array_rand(arr_ptr v, long int row_len)
  {
-     long int i;
+     static uint64_t trial = 0;
      if (row_len > 0) {
          v->rowlen = row_len;
-         for (i = 0; i < row_len * row_len; i++) {
-             v->data[i] = (data_t)(fRand((double)(MINVAL), (double)(MAXVAL)));
-         }
+         crng_fill_square(v->data, row_len, trial++, MINVAL, MAXVAL);
          return 1;
      }
      return 0;
  }
  
- /* Generate a random double in range */
- double fRand(double fMin, double fMax)
- {
-     double f = (double)rand() / RAND_MAX;
-     return fMin + f * (fMax - fMin);
- }
- 
  /* print all elements of an array */
  int print_array(arr_ptr v)
  {
@@ -8,197 +8,191 @@
 #include <pthread.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
+
+#include "bench_harness.h"
+#include "sor_mt.h"
+#include "jacobi.h"
+#include "pcg.h"
+#include "sor_async.h"
 
-#define CPNS 2.0    /* Cycles per nanosecond - adjust for CPU frequency */
-#define GHOST 2     /* Extra rows/columns for ghost zone */
 #define A 20        /* Adjusted coefficient to avoid powers of 2 */
 #define B 50
 #define C 70
 #define NUM_TESTS 5 /* Number of different array sizes to test */
-#define MAX_THREADS 8 /* Maximum number of threads */
-#define MINVAL 0.0
-#define MAXVAL 10.0
-#define TOL 0.00001
-#define OMEGA 1.75  /* Best relaxation parameter from Part 1 */
-
-typedef double data_t;
+#define XOVER_SWEEPS 500    /* Jacobi sweep budget in the crossover table */
+#define XOVER_MAX_COUNTS 16
 
+/* One grid-size measurement, passed to the bench_run() hooks */
 typedef struct {
-    long int rowlen;
-    data_t *data;
-} arr_rec, *arr_ptr;
-
-typedef struct {
-    int thread_id;
     arr_ptr v;
-    int start_row;
-    int end_row;
-    int iterations;
-} thread_data_t;
-
-pthread_barrier_t barrier;
-
-/* Function Prototypes */
-arr_ptr new_array(long int row_len);
-void init_array_rand(arr_ptr v, long int row_len);
-void SOR_serial(arr_ptr v, int *iterations);
-void *SOR_thread_strip(void *arg);
-void *SOR_thread_interleaved(void *arg);
-double interval(struct timespec start, struct timespec end);
-
-/* Timer function */
-double interval(struct timespec start, struct timespec end) {
-    struct timespec temp;
-    temp.tv_sec = end.tv_sec - start.tv_sec;
-    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
-    if (temp.tv_nsec < 0) {
-        temp.tv_sec -= 1;
-        temp.tv_nsec += 1000000000;
-    }
-    return ((double)temp.tv_sec + (double)temp.tv_nsec * 1.0e-9);
+    long int size;
+    int num_threads;
+    int iters;
+} mt_case;
+
+void mt_case_setup(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    init_array_rand(mc->v, mc->size);
 }
 
-/* Create and initialize an array */
-arr_ptr new_array(long int row_len) {
-    arr_ptr result = (arr_ptr)malloc(sizeof(arr_rec));
-    if (!result) return NULL;
-    result->rowlen = row_len;
-    result->data = (data_t *)calloc(row_len * row_len, sizeof(data_t));
-    return result;
+void mt_case_serial(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    SOR(mc->v, &mc->iters);
 }
 
-void init_array_rand(arr_ptr v, long int row_len) {
-    srandom(row_len);
-    for (long int i = 0; i < row_len * row_len; i++) {
-        v->data[i] = ((double)random() / RAND_MAX) * (MAXVAL - MINVAL) + MINVAL;
-    }
+void mt_case_strip(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    SOR_threaded(mc->v, mc->num_threads, SOR_thread_strip, &mc->iters);
 }
 
-/* Standard Serial SOR */
-void SOR_serial(arr_ptr v, int *iterations) {
-    long int rowlen = v->rowlen;
-    data_t *data = v->data;
-    double change, total_change = 1.0e10;
-    int iters = 0;
-
-    while ((total_change / (rowlen * rowlen)) > TOL) {
-        iters++;
-        total_change = 0;
-        for (long int i = 1; i < rowlen - 1; i++) {
-            for (long int j = 1; j < rowlen - 1; j++) {
-                change = data[i * rowlen + j] - 0.25 * (data[(i - 1) * rowlen + j] +
-                                                        data[(i + 1) * rowlen + j] +
-                                                        data[i * rowlen + j + 1] +
-                                                        data[i * rowlen + j - 1]);
-                data[i * rowlen + j] -= change * OMEGA;
-                total_change += fabs(change);
-            }
-        }
-    }
-    *iterations = iters;
+void mt_case_interleaved(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    SOR_threaded(mc->v, mc->num_threads, SOR_thread_interleaved, &mc->iters);
 }
 
-/* Strip-based Multithreaded SOR */
-void *SOR_thread_strip(void *arg) {
-    thread_data_t *data = (thread_data_t *)arg;
-    arr_ptr v = data->v;
-    long int rowlen = v->rowlen;
-    double change, total_change;
-    int iters = 0;
-
-    do {
-        iters++;
-        total_change = 0;
-        for (long int i = data->start_row; i < data->end_row; i++) {
-            for (long int j = 1; j < rowlen - 1; j++) {
-                change = v->data[i * rowlen + j] - 0.25 * (v->data[(i - 1) * rowlen + j] +
-                                                           v->data[(i + 1) * rowlen + j] +
-                                                           v->data[i * rowlen + j + 1] +
-                                                           v->data[i * rowlen + j - 1]);
-                v->data[i * rowlen + j] -= change * OMEGA;
-                total_change += fabs(change);
-            }
-        }
-        pthread_barrier_wait(&barrier);
-    } while ((total_change / (rowlen * rowlen)) > TOL);
+void mt_case_cyclic(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    SOR_threaded(mc->v, mc->num_threads, SOR_thread_cyclic, &mc->iters);
+}
 
-    data->iterations = iters;
-    pthread_exit(NULL);
+void mt_case_jacobi(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    Jacobi_threaded(mc->v, mc->num_threads, &mc->iters);
 }
 
-/* Interleaved Row Multithreaded SOR */
-void *SOR_thread_interleaved(void *arg) {
-    thread_data_t *data = (thread_data_t *)arg;
-    arr_ptr v = data->v;
-    long int rowlen = v->rowlen;
-    double change, total_change;
-    int iters = 0;
-
-    do {
-        iters++;
-        total_change = 0;
-        for (long int i = data->thread_id + 1; i < rowlen - 1; i += MAX_THREADS) {
-            for (long int j = 1; j < rowlen - 1; j++) {
-                change = v->data[i * rowlen + j] - 0.25 * (v->data[(i - 1) * rowlen + j] +
-                                                           v->data[(i + 1) * rowlen + j] +
-                                                           v->data[i * rowlen + j + 1] +
-                                                           v->data[i * rowlen + j - 1]);
-                v->data[i * rowlen + j] -= change * OMEGA;
-                total_change += fabs(change);
-            }
-        }
-        pthread_barrier_wait(&barrier);
-    } while ((total_change / (rowlen * rowlen)) > TOL);
+void mt_case_async(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    SOR_async(mc->v, mc->num_threads, &mc->iters);
+}
 
-    data->iterations = iters;
-    pthread_exit(NULL);
+void mt_case_pcg(void *arg) {
+    mt_case *mc = (mt_case *)arg;
+    PCG_threaded(mc->v, mc->num_threads, PCG_SSOR, &mc->iters);
+}
+
+/* Sweeps Jacobi needs to reach TOL, given residual r after `done` sweeps:
+   the rest at its asymptotic rate 1 - w(1 - cos(pi h)) per sweep */
+double jacobi_projected_sweeps(long int rowlen, int done, double r) {
+    double rate = 1.0 - JACOBI_WEIGHT * (1.0 - cos(M_PI / (rowlen - 1)));
+
+    if (r <= TOL) return done;
+    return done + log(TOL / r) / log(rate);
 }
 
 /* Main Function */
 int main(int argc, char *argv[]) {
-    struct timespec time_start, time_stop;
-    double serial_time, strip_time, interleaved_time;
-    int serial_iterations, strip_iterations, interleaved_iterations;
+    bench_cfg cfg = bench_cfg_from_env();
+    bench_out csv, json;
+    bench_stats serial_stats, strip_stats, cyclic_stats, nobarrier_stats, jacobi_stats, pcg_stats;
+    mt_case mc;
+    int crossover_threads[XOVER_MAX_COUNTS], num_crossover = 0;
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long int chunk_rows[] = {1, 4, 16, 64};
+    int strip_iters;
 
     long int array_sizes[] = {512, 2048};  // One in L3 cache, one larger than L3
     int num_threads = 4;
 
+    /* 1, 2, 4, ... and every online CPU */
+    if (cpus < 1) cpus = 1;
+    for (int t = 1; t < cpus && num_crossover < XOVER_MAX_COUNTS - 1; t *= 2)
+        crossover_threads[num_crossover++] = t;
+    crossover_threads[num_crossover++] = cpus;
+
+    printf("Warmup %d, repeats %d, TSC %.3f cycles/ns\n", cfg.warmup, cfg.repeats, bench_cpns());
+    cpu_dispatch_report(stdout);
+    bench_out_from_env(&csv, &json);
+
     for (int s = 0; s < 2; s++) {
         long int size = array_sizes[s];
         printf("\nTesting SOR on Grid Size: %ld\n", size);
         arr_ptr v0 = new_array(size);
-        init_array_rand(v0, size);
+        mc.v = v0;
+        mc.size = size;
+        mc.num_threads = num_threads;
 
         /* Serial SOR */
-        clock_gettime(CLOCK_REALTIME, &time_start);
-        SOR_serial(v0, &serial_iterations);
-        clock_gettime(CLOCK_REALTIME, &time_stop);
-        serial_time = interval(time_start, time_stop);
-        printf("Serial SOR: %lf seconds, %d iterations\n", serial_time, serial_iterations);
+        bench_run(&cfg, mt_case_setup, mt_case_serial, &mc, &serial_stats);
+        printf("Serial SOR: %lf seconds (min %lf, stddev %lf), %d iterations\n",
+               serial_stats.median, serial_stats.min, serial_stats.stddev, mc.iters);
+        bench_out_row(&csv, "SOR_serial", size, 1, OMEGA, mc.iters, &serial_stats);
+        bench_out_row(&json, "SOR_serial", size, 1, OMEGA, mc.iters, &serial_stats);
 
         /* Strip-based Multithreaded SOR */
-        pthread_t threads[num_threads];
-        thread_data_t thread_data[num_threads];
-        pthread_barrier_init(&barrier, NULL, num_threads);
-
-        clock_gettime(CLOCK_REALTIME, &time_start);
-        for (int i = 0; i < num_threads; i++) {
-            thread_data[i].thread_id = i;
-            thread_data[i].v = v0;
-            thread_data[i].start_row = (i * size) / num_threads;
-            thread_data[i].end_row = ((i + 1) * size) / num_threads;
-            pthread_create(&threads[i], NULL, SOR_thread_strip, &thread_data[i]);
+        bench_run(&cfg, mt_case_setup, mt_case_strip, &mc, &strip_stats);
+        printf("Strip-Based SOR: %lf seconds (min %lf, stddev %lf)\n",
+               strip_stats.median, strip_stats.min, strip_stats.stddev);
+        bench_out_row(&csv, "SOR_thread_strip", size, num_threads, OMEGA, mc.iters, &strip_stats);
+        bench_out_row(&json, "SOR_thread_strip", size, num_threads, OMEGA, mc.iters, &strip_stats);
+
+        /* Row i to thread (i-1) % threads: best balance, every row a halo */
+        bench_run(&cfg, mt_case_setup, mt_case_interleaved, &mc, &cyclic_stats);
+        printf("Interleaved SOR: %lf seconds (min %lf, stddev %lf), %d iterations\n",
+               cyclic_stats.median, cyclic_stats.min, cyclic_stats.stddev, mc.iters);
+        bench_out_row(&csv, "SOR_thread_interleaved", size, num_threads, OMEGA, mc.iters, &cyclic_stats);
+        bench_out_row(&json, "SOR_thread_interleaved", size, num_threads, OMEGA, mc.iters, &cyclic_stats);
+
+        /* Block-cyclic: chunk height trades load balance against shared halo rows */
+        printf("Chunk rows, Cyclic SOR seconds, iters\n");
+        for (int c = 0; c < 4; c++) {
+            char row[32];
+
+            SOR_CHUNK_ROWS = chunk_rows[c];
+            bench_run(&cfg, mt_case_setup, mt_case_cyclic, &mc, &cyclic_stats);
+            printf("%ld, %lf, %d\n", SOR_CHUNK_ROWS, cyclic_stats.median, mc.iters);
+            snprintf(row, sizeof(row), "SOR_thread_cyclic_c%ld", SOR_CHUNK_ROWS);
+            bench_out_row(&csv, row, size, num_threads, OMEGA, mc.iters, &cyclic_stats);
+            bench_out_row(&json, row, size, num_threads, OMEGA, mc.iters, &cyclic_stats);
         }
-        for (int i = 0; i < num_threads; i++) {
-            pthread_join(threads[i], NULL);
+
+        /* Same strips without the per-sweep barrier */
+        bench_run(&cfg, mt_case_setup, mt_case_async, &mc, &nobarrier_stats);
+        printf("Async SOR: %lf seconds (min %lf, stddev %lf), %d iterations\n",
+               nobarrier_stats.median, nobarrier_stats.min, nobarrier_stats.stddev, mc.iters);
+        SOR_async_report(stdout);
+        bench_out_row(&csv, "SOR_async", size, num_threads, OMEGA, mc.iters, &nobarrier_stats);
+        bench_out_row(&json, "SOR_async", size, num_threads, OMEGA, mc.iters, &nobarrier_stats);
+
+        /* SSOR-preconditioned CG, same threads and convergence test */
+        bench_run(&cfg, mt_case_setup, mt_case_pcg, &mc, &pcg_stats);
+        printf("PCG (block SSOR): %lf seconds (min %lf, stddev %lf), %d iterations\n",
+               pcg_stats.median, pcg_stats.min, pcg_stats.stddev, mc.iters);
+        bench_out_row(&csv, "PCG_ssor", size, num_threads, PCG_OMEGA, mc.iters, &pcg_stats);
+        bench_out_row(&json, "PCG_ssor", size, num_threads, PCG_OMEGA, mc.iters, &pcg_stats);
+
+        /* Jacobi needs more sweeps but scales without intra-sweep
+           dependences; find the thread count where it overtakes SOR.
+           Jacobi to TOL costs ~n^4 (hours at 2048), so it runs
+           XOVER_SWEEPS sweeps and its time to TOL is projected */
+        printf("Threads, Strip SOR seconds, SOR iters, Jacobi seconds/sweep, "
+               "Jacobi projected iters, Jacobi projected seconds, Faster\n");
+        JACOBI_MAX_SWEEPS = XOVER_SWEEPS;
+        for (int t = 0; t < num_crossover; t++) {
+            double sweeps, projected;
+
+            mc.num_threads = crossover_threads[t];
+            bench_run(&cfg, mt_case_setup, mt_case_strip, &mc, &strip_stats);
+            strip_iters = mc.iters;
+            bench_run(&cfg, mt_case_setup, mt_case_jacobi, &mc, &jacobi_stats);
+            sweeps = jacobi_projected_sweeps(size, mc.iters, SOR_residual(mc.v));
+            projected = jacobi_stats.median / mc.iters * sweeps;
+            printf("%d, %lf, %d, %.3g, %.0f, %lf, %s\n", mc.num_threads,
+                   strip_stats.median, strip_iters, jacobi_stats.median / mc.iters, sweeps,
+                   projected, projected < strip_stats.median ? "Jacobi" : "SOR");
+            bench_out_row(&csv, "SOR_thread_strip_xover", size, mc.num_threads, OMEGA, strip_iters,
+                          &strip_stats);
+            bench_out_row(&json, "SOR_thread_strip_xover", size, mc.num_threads, OMEGA, strip_iters,
+                          &strip_stats);
+            bench_out_row(&csv, "Jacobi", size, mc.num_threads, JACOBI_WEIGHT, mc.iters, &jacobi_stats);
+            bench_out_row(&json, "Jacobi", size, mc.num_threads, JACOBI_WEIGHT, mc.iters, &jacobi_stats);
         }
-        clock_gettime(CLOCK_REALTIME, &time_stop);
-        strip_time = interval(time_start, time_stop);
-        pthread_barrier_destroy(&barrier);
-        printf("Strip-Based SOR: %lf seconds\n", strip_time);
+        JACOBI_MAX_SWEEPS = 0;
 
-        free(v0);
+        free_array(v0);
     }
 
+    bench_out_close(&csv);
+    bench_out_close(&json);
     return 0;
 }
@@ -10,8 +10,8 @@
 #include <time.h>
 #include <math.h>
 
-#define CPNS 2.0    /* Cycles per nanosecond -- Adjust to your computer,
-                       for example a 3.2 GhZ GPU, this would be 3.2 */
+#include "bench_harness.h"
+#include "pt_cb.h"
 
 #define A   1   /* coefficient of x^2 */
 #define B   1   /* coefficient of x */
@@ -20,42 +20,6 @@
 #define NUM_TESTS 10
 
 #define OPTIONS 3        // Current setting, vary as you wish!
-#define IDENT 0
-
-#define INIT_LOW -10.0
-#define INIT_HIGH 10.0
-
-typedef double data_t;
-
-/* Create abstract data type for matrix */
-typedef struct {
-  long int rowlen;
-  data_t *data;
-} matrix_rec, *matrix_ptr;
-
-int NUM_THREADS = 4;
-
-/* used to pass parameters to worker threads */
-struct thread_data{
-  int thread_id;
-  matrix_ptr a;
-  matrix_ptr b;
-  matrix_ptr c;
-  matrix_ptr d;
-};
-
-/* prototypes */
-matrix_ptr new_matrix(long int row_len);
-int set_matrix_rowlen(matrix_ptr m, long int index);
-long int get_matrix_rowlen(matrix_ptr m);
-int init_matrix(matrix_ptr m, long int row_len);
-int init_matrix_rand(matrix_ptr m, long int row_len);
-int init_matrix_rand_grad(matrix_ptr m, long int row_len);
-int zero_matrix(matrix_ptr m, long int len);
-void pt_cb_base(matrix_ptr a, matrix_ptr b, matrix_ptr c);
-void pt_cb_pthr(matrix_ptr a, matrix_ptr b, matrix_ptr c);
-void pt_mb(matrix_ptr a, matrix_ptr b, matrix_ptr c, matrix_ptr d);
-void pt_ob(matrix_ptr a, matrix_ptr b, matrix_ptr c);
 
 /* -=-=-=-=- Time measurement by clock_gettime() -=-=-=-=- */
 /*
@@ -118,12 +82,38 @@ double wakeup_delay()
   return quasi_random;
 }
 
+/* One pt_cb_*() measurement, passed to the bench_run() hooks */
+struct cb_case {
+  matrix_ptr a, b, c;
+  long int n;
+  int pthr;
+};
+
+void cb_case_setup(void *arg)
+{
+  struct cb_case *cc = (struct cb_case *) arg;
+  init_matrix_rand(cc->a, cc->n);
+  set_matrix_rowlen(cc->a, cc->n);
+  set_matrix_rowlen(cc->b, cc->n);
+  set_matrix_rowlen(cc->c, cc->n);
+}
+
+void cb_case_run(void *arg)
+{
+  struct cb_case *cc = (struct cb_case *) arg;
+  if (cc->pthr) pt_cb_pthr(cc->a, cc->b, cc->c);
+  else pt_cb_base(cc->a, cc->b, cc->c);
+}
+
 /*************************************************************************/
 int main(int argc, char *argv[])
 {
   int OPTION;
-  struct timespec time_start, time_stop;
-  double time_stamp[OPTIONS][NUM_TESTS];
+  bench_stats stats[OPTIONS][NUM_TESTS];
+  int option_threads[OPTIONS] = {1, 2, 4};
+  bench_cfg cfg = bench_cfg_from_env();
+  bench_out csv, json;
+  struct cb_case cc;
   double wd;
   long int x, n;
   long int alloc_size;
@@ -133,6 +123,10 @@ int main(int argc, char *argv[])
 
   printf("Test SOR pthreads\n");
   wd = wakeup_delay();
+  printf("Warmup %d, repeats %d, TSC %.3f cycles/ns\n",
+         cfg.warmup, cfg.repeats, bench_cpns());
+  cpu_dispatch_report(stdout);
+  bench_out_from_env(&csv, &json);
 
   /* declare and initialize the matrix structure */
   matrix_ptr a0 = new_matrix(alloc_size);
@@ -143,72 +137,33 @@ int main(int argc, char *argv[])
   zero_matrix(c0, alloc_size);
   matrix_ptr d0 = new_matrix(alloc_size);
   init_matrix_rand_grad(d0, alloc_size);
-
-  OPTION = 0;
-  printf("OPTION %d - pt_cb_base()\n", OPTION);
-  for (x=0; x<NUM_TESTS && (n = A*x*x + B*x + C, n<=alloc_size); x++) {
-    init_matrix_rand(a0, n);
-    set_matrix_rowlen(a0, n);
-    set_matrix_rowlen(b0, n);
-    set_matrix_rowlen(c0, n);
-    clock_gettime(CLOCK_REALTIME, &time_start);
-    pt_cb_base(a0, b0, c0);
-    clock_gettime(CLOCK_REALTIME, &time_stop);
-    time_stamp[OPTION][x] = interval(time_start, time_stop);
-    printf("iter %d done\n", x);
-  }
-
-  NUM_THREADS = 2;
-  OPTION++;
-  printf("OPTION %d: pt_cb_pthr() with %d threads\n", OPTION, NUM_THREADS);
-  for (x=0; x<NUM_TESTS && (n = A*x*x + B*x + C, n<=alloc_size); x++) {
-    init_matrix_rand(a0, n);
-    set_matrix_rowlen(a0, n);
-    set_matrix_rowlen(b0, n);
-    set_matrix_rowlen(c0, n);
-    clock_gettime(CLOCK_REALTIME, &time_start);
-    pt_cb_pthr(a0, b0, c0);
-    clock_gettime(CLOCK_REALTIME, &time_stop);
-    time_stamp[OPTION][x] = interval(time_start, time_stop);
-    printf("iter %d done\n", x);
-  }
-
-  NUM_THREADS = 4;
-  OPTION++;
-  printf("OPTION %d: pt_cb_pthr() with %d threads\n", OPTION, NUM_THREADS);
-  for (x=0; x<NUM_TESTS && (n = A*x*x + B*x + C, n<=alloc_size); x++) {
-    init_matrix_rand(a0, n);
-    set_matrix_rowlen(a0, n);
-    set_matrix_rowlen(b0, n);
-    set_matrix_rowlen(c0, n);
-    clock_gettime(CLOCK_REALTIME, &time_start);
-    pt_cb_pthr(a0, b0, c0);
-    clock_gettime(CLOCK_REALTIME, &time_stop);
-    time_stamp[OPTION][x] = interval(time_start, time_stop);
-    printf("iter %d done\n", x);
-  }
-
-  /* enable this to try the experiment on a machine with 8+ cores, and don't
-     forget to also change OPTIONS definition at top! */
-  /*
-  NUM_THREADS = 8;
-  OPTION++;
-  printf("OPTION %d: pt_cb_pthr() with %d threads\n", OPTION, NUM_THREADS);
-  for (x=0; x<NUM_TESTS && (n = A*x*x + B*x + C, n<=alloc_size); x++) {
-    init_matrix_rand(a0, n);
-    set_matrix_rowlen(a0, n);
-    set_matrix_rowlen(b0, n);
-    set_matrix_rowlen(c0, n);
-    clock_gettime(CLOCK_REALTIME, &time_start);
-    pt_cb_pthr(a0, b0, c0);
-    clock_gettime(CLOCK_REALTIME, &time_stop);
-    time_stamp[OPTION][x] = interval(time_start, time_stop);
-    printf("iter %d done\n", x);
+  cc.a = a0;
+  cc.b = b0;
+  cc.c = c0;
+
+  /* OPTION 0 is pt_cb_base(); the rest are pt_cb_pthr() with the thread
+     counts in option_threads[]. To try 8+ threads, add to option_threads
+     and don't forget to also change OPTIONS definition at top! */
+  for (OPTION = 0; OPTION < OPTIONS; OPTION++) {
+    NUM_THREADS = option_threads[OPTION];
+    cc.pthr = (OPTION != 0);
+    if (cc.pthr)
+      printf("OPTION %d: pt_cb_pthr() with %d threads\n", OPTION, NUM_THREADS);
+    else
+      printf("OPTION %d - pt_cb_base()\n", OPTION);
+    for (x=0; x<NUM_TESTS && (n = A*x*x + B*x + C, n<=alloc_size); x++) {
+      cc.n = n;
+      bench_run(&cfg, cb_case_setup, cb_case_run, &cc, &stats[OPTION][x]);
+      bench_out_row(&csv, cc.pthr ? "pt_cb_pthr" : "pt_cb_base", n,
+                    NUM_THREADS, 0.0, 0, &stats[OPTION][x]);
+      bench_out_row(&json, cc.pthr ? "pt_cb_pthr" : "pt_cb_base", n,
+                    NUM_THREADS, 0.0, 0, &stats[OPTION][x]);
+      printf("iter %ld done\n", x);
+    }
   }
-  */
 
   printf("\n");
-  printf("All measurements are in cycles (if CPNS is set correctly in the code)\n");
+  printf("All measurements are median TSC cycles over %d runs\n", cfg.repeats);
   printf("row length, 1 thread, 2 threads, 4 threads\n");
   {
     int i, j;
@@ -216,213 +171,16 @@ int main(int argc, char *argv[])
       printf("%d, ", A*i*i + B*i + C);
       for (j = 0; j < OPTIONS; j++) {
         if (j != 0) printf(", ");
-        printf("%ld", (long int)((double)(CPNS) * 1.0e9 * time_stamp[j][i]));
+        printf("%ld", (long int)(stats[j][i].cycles));
       }
       printf("\n");
     }
   }
 
+  bench_out_close(&csv);
+  bench_out_close(&json);
   printf("test_pt done\n");
   printf("Wakeup delay calculated %f\n", wd);
 
   return 0;
 } /* end main */
-
-/**********************************************/
-/* Create matrix of specified row length */
-matrix_ptr new_matrix(long int row_len)
-{
-  long int i;
-
-  /* Allocate and declare header structure */
-  matrix_ptr result = (matrix_ptr) malloc(sizeof(matrix_rec));
-  if (!result) {
-    return NULL;  /* Couldn't allocate storage */
-  }
-  result->rowlen = row_len;
-
-  /* Allocate and declare array */
-  if (row_len > 0) {
-    data_t *data = (data_t *) calloc(row_len*row_len, sizeof(data_t));
-    if (!data) {
-	  free((void *) result);
-	  printf("COULDN'T ALLOCATE %ld bytes STORAGE \n",
-                                            row_len*row_len*sizeof(data_t));
-	  return NULL;  /* Couldn't allocate storage */
-	}
-	result->data = data;
-  }
-  else result->data = NULL;
-
-  return result;
-}
-
-/* Set row length of matrix */
-int set_matrix_rowlen(matrix_ptr m, long int row_len)
-{
-  m->rowlen = row_len;
-  return 1;
-}
-
-/* Return row length of matrix */
-long int get_matrix_rowlen(matrix_ptr m)
-{
-  return m->rowlen;
-}
-
-/* initialize matrix to consecutive numbers starting with 0 */
-int init_matrix(matrix_ptr m, long int row_len)
-{
-  long int i;
-
-  if (row_len > 0) {
-    m->rowlen = row_len;
-    for (i = 0; i < row_len*row_len; i++)
-      m->data[i] = (data_t)(i);
-    return 1;
-  }
-  else return 0;
-}
-
-/* initialize matrix to random values in [INIT_LOW, INIT_HIGH] */
-int init_matrix_rand(matrix_ptr m, long int row_len)
-{
-  long int i;
-  double fRand(double fMin, double fMax);
-
-  if (row_len > 0) {
-    m->rowlen = row_len;
-    for (i = 0; i < row_len*row_len; i++)
-      m->data[i] = (data_t)(fRand((double)(INIT_LOW),(double)(INIT_HIGH)));
-    return 1;
-  }
-  else return 0;
-}
-
-/* initialize matrix to random values bounded by a "gradient" envelope */
-int init_matrix_rand_grad(matrix_ptr m, long int row_len)
-{
-  long int i;
-  double fRand(double fMin, double fMax);
-
-  if (row_len > 0) {
-    m->rowlen = row_len;
-    for (i = 0; i < row_len*row_len; i++)
-      m->data[i] = (data_t)(fRand((double)(0.0),(double)(i)));
-    return 1;
-  }
-  else return 0;
-}
-
-/* initialize matrix */
-int zero_matrix(matrix_ptr m, long int row_len)
-{
-  long int i,j;
-
-  if (row_len > 0) {
-    m->rowlen = row_len;
-    for (i = 0; i < row_len*row_len; i++)
-      m->data[i] = (data_t)(IDENT);
-    return 1;
-  }
-  else return 0;
-}
-
-data_t *get_matrix_start(matrix_ptr m)
-{
-  return m->data;
-}
-
-/* print matrix */
-int print_matrix(matrix_ptr v)
-{
-  long int i, j, row_len;
-
-  row_len = v->rowlen;
-  for (i = 0; i < row_len; i++) {
-    printf("\n");
-    for (j = 0; j < row_len; j++)
-      printf("%.4f ", (data_t)(v->data[i*row_len+j]));
-  }
-}
-
-double fRand(double fMin, double fMax)
-{
-  double f = (double)random() / (double)(RAND_MAX);
-  return fMin + f * (fMax - fMin);
-}
-
-/*************************************************/
-/* CPU bound baseline - perform transcendental function on all elements */
-void pt_cb_base(matrix_ptr a, matrix_ptr b, matrix_ptr c)
-{
-  long int i, j, k;
-  long int rowlen = get_matrix_rowlen(a);
-  data_t *a0 = get_matrix_start(a);
-  data_t *b0 = get_matrix_start(b);
-  data_t *c0 = get_matrix_start(c);
-
-  for (i = 0; i < rowlen*rowlen; i++) {
-    c0[i] = (data_t)(cosh(tan(sqrt(cos(exp((double)(a0[i])))))));
-    //c0[i] = a0[i];
-  }
-}
-
-/***************************************************************************/
-/* CPU bound multithreaded code. Here we use pthreads to do the same thing */
-/* as pt_cb_base().  first, the worker thread function                     */
-void *cb_work(void *threadarg)
-{
-  long int i, j, k, low, high;
-  struct thread_data *my_data;
-  my_data = (struct thread_data *) threadarg;
-  int taskid = my_data->thread_id;
-  matrix_ptr a0 = my_data->a;
-  matrix_ptr b0 = my_data->b;
-  matrix_ptr c0 = my_data->c;
-  long int rowlen = get_matrix_rowlen(a0);
-  data_t *aM = get_matrix_start(a0);
-  data_t *bM = get_matrix_start(b0);
-  data_t *cM = get_matrix_start(c0);
-
-  low = (taskid * rowlen * rowlen)/NUM_THREADS;
-  high = ((taskid+1)* rowlen * rowlen)/NUM_THREADS;
-
-  for (i = low; i < high; i++) {
-    cM[i] = (data_t)(cosh(tan(sqrt(cos(exp((double)(aM[i])))))));
-    //cM[i] = aM[i];
-  }
-
-  pthread_exit(NULL);
-} /* End of cb_work */
-
-/* Now, the pthread calling function */
-void pt_cb_pthr(matrix_ptr a, matrix_ptr b, matrix_ptr c)
-{
-  long int i, j, k;
-  pthread_t threads[NUM_THREADS];
-  struct thread_data thread_data_array[NUM_THREADS];
-  int rc;
-  long t;
-
-  for (t = 0; t < NUM_THREADS; t++) {
-    thread_data_array[t].thread_id = t;
-    thread_data_array[t].a = a;
-    thread_data_array[t].b = b;
-    thread_data_array[t].c = c;
-    thread_data_array[t].d = 0;
-    rc = pthread_create(&threads[t], NULL, cb_work,
-			(void*) &thread_data_array[t]);
-    if (rc) {
-      printf("ERROR; return code from pthread_create() is %d\n", rc);
-      exit(-1);
-    }
-  }
-
-  for (t = 0; t < NUM_THREADS; t++) {
-    if (pthread_join(threads[t],NULL)){ 
-      printf("ERROR; code on return from join is %d\n", rc);
-      exit(-1);
-    }
-  }
-}
@@ -0,0 +1,248 @@
+/****************************************************************************
+   Compilation Command:
+   gcc -pthread -O2 -std=gnu11 test_scaling.c -lm -lrt -o test_scaling
+
+   Strong and weak scaling of the threaded solvers, from 1 thread up to
+   every logical CPU (SMT siblings included).
+
+   Grids are sized from the detected caches (cache_info.h) so the
+   single-thread working set lands in each level in turn:
+
+     L1     half the L1d           L3     half the L3
+     L2     half the L2            DRAM   4x the L3
+
+   Strong scaling keeps that grid and adds threads; weak scaling gives
+   every thread that many points, so t threads solve a grid sqrt(t) times
+   wider. The SOR kernel is strip SOR on a sor_ctx team (sor_ctx.h), so
+   thread creation is not in the timings. It runs a fixed number of
+   sweeps (SCALE_POINT_SWEEPS point updates, same count at every thread
+   count) rather than to TOL, which a DRAM grid would take hours to meet.
+   cb_work (pt_cb_pthr(), test_pt.c's kernel) is the compute-bound
+   reference, run at the L2 size only since it barely touches memory.
+
+   Speedup is T(1) / T(t); strong efficiency is speedup / t and weak
+   efficiency T(1) / T(t). The last column says where the threads run:
+   one per physical core (core), on SMT siblings too (smt), or more
+   threads than logical CPUs (over). A weak grid larger than a quarter of
+   physical memory is skipped.
+
+   Environment, besides the BENCH_* variables of bench_harness.h:
+
+     SCALING_MAX_THREADS=n   highest thread count     (default: CPUs online;
+                             at most CTX_MAX_THREADS, printed if clamped)
+
+   BENCH_CSV / BENCH_JSON rows are named <kernel>_<strong|weak>_<level>
+   with size = grid side and iters = sweeps; plots/scaling.py draws the
+   speedup and efficiency curves from them.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "bench_harness.h"
+#include "sor_mt.h"
+#include "sor_ctx.h"
+#include "pt_cb.h"
+#include "cache_info.h"
+
+#define SCALE_LEVELS 4
+#define SCALE_MAX_COUNTS 32
+#define SCALE_POINT_SWEEPS 2.0e8  /* point updates per timed SOR run */
+#define SCALE_MIN_SWEEPS 4
+#define SCALE_MAX_SWEEPS 2000
+#define SCALE_SOR 0
+#define SCALE_CB 1
+
+/* One (kernel, grid, threads) measurement, passed to the bench_run() hooks */
+typedef struct {
+    int kernel;
+    sor_ctx ctx;
+    matrix_ptr a, b, c;
+    long int n;             /* SOR interior points a side, or cb matrix side */
+    int num_threads;
+    int sweeps;
+} scale_case;
+
+/* A fresh random grid for the next timed run */
+void scale_case_setup(void *arg)
+{
+    scale_case *sc = (scale_case *)arg;
+    sor_request req = {sc->n, NULL, (uint64_t)sc->n, NULL, 0, 0, 1, 0};
+    sor_result res;
+
+    if (sc->kernel == SCALE_SOR) sor_ctx_solve(&sc->ctx, &req, &res);
+}
+
+/* SOR: exactly sc->sweeps sweeps from the grid setup left */
+void scale_case_run(void *arg)
+{
+    scale_case *sc = (scale_case *)arg;
+    sor_request req = {sc->n, NULL, 0, NULL, 0, 1.0e-300, sc->sweeps, 1};
+    sor_result res;
+
+    if (sc->kernel == SCALE_SOR) {
+        sor_ctx_solve(&sc->ctx, &req, &res);
+    } else {
+        NUM_THREADS = sc->num_threads;
+        pt_cb_pthr(sc->a, sc->b, sc->c);
+    }
+}
+
+/* Time the kernel on an n-side grid with t threads; median seconds */
+double scale_measure(const bench_cfg *cfg, scale_case *sc, long int n, int t, bench_stats *st)
+{
+    sc->n = n;
+    sc->num_threads = t;
+    if (sc->kernel == SCALE_SOR) {
+        if (!sor_ctx_create(&sc->ctx, n, t)) {
+            fprintf(stderr, "test_scaling: could not create a context for n = %ld, %d threads\n", n, t);
+            exit(-1);
+        }
+        bench_run(cfg, scale_case_setup, scale_case_run, sc, st);
+        sor_ctx_destroy(&sc->ctx);
+    } else {
+        if (!(sc->a = new_matrix(n)) || !(sc->b = new_matrix(n)) || !(sc->c = new_matrix(n))) {
+            fprintf(stderr, "test_scaling: could not allocate %ld^2 matrices\n", n);
+            exit(-1);
+        }
+        init_matrix_rand(sc->a, n);
+        bench_run(cfg, NULL, scale_case_run, sc, st);
+        free(sc->a->data);
+        free(sc->a);
+        free(sc->b->data);
+        free(sc->b);
+        free(sc->c->data);
+        free(sc->c);
+    }
+    return st->median;
+}
+
+/* 1, 2, 3, 4, then doubling, plus the core count and max; ascending */
+int scale_thread_counts(int max, int cores, int *out)
+{
+    int count = 0;
+
+    for (int t = 1; t <= max && count < SCALE_MAX_COUNTS - 2; t = t < 4 ? t + 1 : 2 * t)
+        out[count++] = t;
+    if (cores < max) out[count++] = cores;
+    out[count++] = max;
+    for (int i = 1; i < count; i++) {
+        for (int j = i; j > 0 && out[j - 1] > out[j]; j--) {
+            int tmp = out[j];
+            out[j] = out[j - 1];
+            out[j - 1] = tmp;
+        }
+    }
+    int uniq = 0;
+    for (int i = 0; i < count; i++)
+        if (!uniq || out[uniq - 1] != out[i]) out[uniq++] = out[i];
+    return uniq;
+}
+
+/* Where t threads run: one per core, on SMT siblings too, or oversubscribed */
+const char *scale_placement(int t, const cache_info *ci)
+{
+    return t <= ci->cores ? "core" : t <= ci->cpus ? "smt" : "over";
+}
+
+/* Strong then weak scaling of one kernel at one cache level */
+void scale_level(const bench_cfg *cfg, scale_case *sc, const char *name, const char *level,
+                 long int bytes, const int *counts, int num_counts, const cache_info *ci,
+                 long int mem_cap, bench_out *csv, bench_out *json)
+{
+    int sor = sc->kernel == SCALE_SOR;
+    long int point_bytes = sor ? sizeof(data_t) : 2 * sizeof(data_t);   /* cb: a and c */
+    long int side = (long int)sqrt((double)bytes / point_bytes);
+    long int n = sor ? side - GHOST : side;
+    double t1 = 0, secs;
+    bench_stats st;
+    char row[64];
+
+    if (n < 4) n = 4;
+    sc->sweeps = 1;
+    if (sor) {
+        double sw = SCALE_POINT_SWEEPS / ((double)n * n);
+        sc->sweeps = sw < SCALE_MIN_SWEEPS ? SCALE_MIN_SWEEPS : sw > SCALE_MAX_SWEEPS ? SCALE_MAX_SWEEPS : (int)sw;
+    }
+
+    side = sor ? n + GHOST : n;
+    printf("\nStrong scaling, %s, %s: %ld^2 grid, %.0f KB, %d %s\n", name, level, side,
+           (double)side * side * point_bytes / 1024, sc->sweeps, sor ? "sweeps" : "pass");
+    printf("Threads, Seconds, Speedup, Efficiency, Mpoints/s, Placement\n");
+    snprintf(row, sizeof(row), "%s_strong_%s", name, level);
+    for (int c = 0; c < num_counts; c++) {
+        secs = scale_measure(cfg, sc, n, counts[c], &st);
+        if (c == 0) t1 = secs;
+        printf("%d, %.6f, %.2f, %.2f, %.1f, %s\n", counts[c], secs, t1 / secs, t1 / secs / counts[c],
+               (double)n * n * sc->sweeps / secs * 1.0e-6, scale_placement(counts[c], ci));
+        bench_out_row(csv, row, side, counts[c], sor ? OMEGA : 0.0, sc->sweeps, &st);
+        bench_out_row(json, row, side, counts[c], sor ? OMEGA : 0.0, sc->sweeps, &st);
+    }
+
+    printf("\nWeak scaling, %s, %s: %ld^2 %s per thread\n", name, level, n,
+           sor ? "interior points" : "elements");
+    printf("Threads, Grid, Seconds, Efficiency, Mpoints/s, Placement\n");
+    snprintf(row, sizeof(row), "%s_weak_%s", name, level);
+    for (int c = 0; c < num_counts; c++) {
+        long int nt = (long int)(n * sqrt((double)counts[c]) + 0.5);
+        long int grid = sor ? nt + GHOST : nt;
+
+        if (grid * grid * point_bytes > mem_cap) {
+            printf("%d, %ld, skipped: %.0f MB is over the memory cap\n", counts[c], grid,
+                   (double)grid * grid * point_bytes / (1024 * 1024));
+            continue;
+        }
+        secs = scale_measure(cfg, sc, nt, counts[c], &st);
+        if (c == 0) t1 = secs;
+        printf("%d, %ld, %.6f, %.2f, %.1f, %s\n", counts[c], grid, secs, t1 / secs,
+               (double)nt * nt * sc->sweeps / secs * 1.0e-6, scale_placement(counts[c], ci));
+        bench_out_row(csv, row, grid, counts[c], sor ? OMEGA : 0.0, sc->sweeps, &st);
+        bench_out_row(json, row, grid, counts[c], sor ? OMEGA : 0.0, sc->sweeps, &st);
+    }
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[])
+{
+    bench_cfg cfg = bench_cfg_from_env();
+    bench_out csv, json;
+    cache_info ci;
+    scale_case sc;
+    int counts[SCALE_MAX_COUNTS], num_counts, max_threads, wanted_threads;
+    long int mem_cap = sysconf(_SC_PHYS_PAGES) / 4 * sysconf(_SC_PAGESIZE);
+    const char *levels[SCALE_LEVELS] = {"L1", "L2", "L3", "DRAM"};
+    long int bytes[SCALE_LEVELS];
+
+    cache_info_probe(&ci);
+    max_threads = bench_env_int("SCALING_MAX_THREADS", ci.cpus);
+    if (max_threads < 1) max_threads = 1;
+    wanted_threads = max_threads;
+    if (max_threads > CTX_MAX_THREADS) max_threads = CTX_MAX_THREADS;
+    num_counts = scale_thread_counts(max_threads, ci.cores, counts);
+    bytes[0] = ci.l1 / 2;
+    bytes[1] = ci.l2 / 2;
+    bytes[2] = ci.l3 / 2;
+    bytes[3] = 4 * ci.l3;
+
+    printf("Warmup %d, repeats %d, TSC %.3f cycles/ns\n", cfg.warmup, cfg.repeats, bench_cpns());
+    cpu_dispatch_report(stdout);
+    printf("%d CPUs online, %d physical cores; L1d %ld KB, L2 %ld KB, L3 %ld KB; threads up to %d\n",
+           ci.cpus, ci.cores, ci.l1 / 1024, ci.l2 / 1024, ci.l3 / 1024, max_threads);
+    if (wanted_threads > max_threads)
+        printf("thread sweep clamped from %d to CTX_MAX_THREADS = %d (sor_ctx.h)\n",
+               wanted_threads, max_threads);
+    bench_out_from_env(&csv, &json);
+
+    sc.kernel = SCALE_SOR;
+    for (int l = 0; l < SCALE_LEVELS; l++)
+        scale_level(&cfg, &sc, "SOR", levels[l], bytes[l], counts, num_counts, &ci,
+                    mem_cap, &csv, &json);
+    sc.kernel = SCALE_CB;
+    scale_level(&cfg, &sc, "cb", levels[1], bytes[1], counts, num_counts, &ci,
+                mem_cap, &csv, &json);
+
+    bench_out_close(&csv);
+    bench_out_close(&json);
+    return 0;
+}
@@ -0,0 +1,267 @@
+/****************************************************************************
+   Compilation Command:
+   gcc -pthread -O2 -std=gnu11 test_sor_ctx.c -lm -lrt -o test_sor_ctx
+
+   Small-grid throughput: solves per second through the sor_ctx API
+   (sor_ctx.h) against the usual per-solve setup of new_array(),
+   init_array_rand(), SOR() or SOR_threaded() and free_array(). Both start
+   from the same grids; serial solves must take the same number of sweeps,
+   threaded ones within THREAD_ITER_TOL. Strip edges race, so a single
+   threaded solve can vary by 2x; the threaded check compares the median
+   over every solve of the measurement. A mismatch fails the run. Heap
+   growth over the context's solves is reported; it should be 0.
+
+   Then a drifting-boundary sequence: DRIFT_STEPS problems whose ghost
+   ring is a smooth profile shifted a little each step. Each step is solved
+   cold (fresh random interior) and warm (the previous step's warm
+   solution, with only the boundary rewritten by sor_ctx_set_boundary()),
+   comparing sweeps and time to TOL. The cold solves run on a context of
+   their own, so the warm context only ever holds warm solutions.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+#include "bench_harness.h"
+#include "sor_mt.h"
+#include "sor_ctx.h"
+
+#define NUM_SIZES 4
+#define WORK_POINTS 4000000L  /* interior points per timed batch, all sizes */
+#define DRIFT_STEPS 20
+#define DRIFT 0.05            /* boundary phase shift per step, radians */
+#define DRIFT_MAX_N 254
+#define THREAD_ITER_TOL 0.1   /* allowed relative median sweep-count difference, threaded */
+
+/* One (mode, size, threads) measurement, passed to the bench_run() hooks */
+typedef struct {
+    sor_ctx *ctx;
+    long int n;
+    int num_threads;
+    int batch;
+    int iters;
+    int *sweeps;              /* every solve's sweep count, for the median */
+    long int logged;
+} ctx_case;
+
+int cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Median of the logged sweep counts; clears the log */
+int ctx_case_median(ctx_case *cc)
+{
+    int median;
+
+    qsort(cc->sweeps, cc->logged, sizeof(int), cmp_int);
+    median = cc->sweeps[cc->logged / 2];
+    cc->logged = 0;
+    return median;
+}
+
+/* Allocate, initialise, solve, free: what the drivers do per solve */
+void ctx_case_fresh(void *arg)
+{
+    ctx_case *cc = (ctx_case *)arg;
+
+    for (int b = 0; b < cc->batch; b++) {
+        arr_ptr v = new_array(cc->n + GHOST);
+        if (!v) {
+            fprintf(stderr, "test_sor_ctx: could not allocate n = %ld\n", cc->n);
+            exit(-1);
+        }
+        init_array_rand(v, cc->n + GHOST);
+        if (cc->num_threads > 1)
+            SOR_threaded(v, cc->num_threads, SOR_thread_strip, &cc->iters);
+        else
+            SOR(v, &cc->iters);
+        cc->sweeps[cc->logged++] = cc->iters;
+        free_array(v);
+    }
+}
+
+/* The same solves through a preallocated context */
+void ctx_case_ctx(void *arg)
+{
+    ctx_case *cc = (ctx_case *)arg;
+    sor_request req = {cc->n, NULL, (uint64_t)(cc->n + GHOST), NULL, 0, 0, 0, 0};
+    sor_result res;
+
+    for (int b = 0; b < cc->batch; b++) {
+        sor_ctx_solve(cc->ctx, &req, &res);
+        cc->iters = res.iters;
+        cc->sweeps[cc->logged++] = res.iters;
+    }
+}
+
+/* Batch timings to per-solve timings */
+void per_solve(bench_stats *st, int batch)
+{
+    st->median /= batch;
+    st->min /= batch;
+    st->mean /= batch;
+    st->stddev /= batch;
+    st->cycles /= batch;
+}
+
+/* Ghost ring of drift step `step`: side k (N, S, W, E) at position p in
+   [0, 1] is a sine between MINVAL and MAXVAL, phase-shifted per side */
+void drift_boundary(data_t side[4][DRIFT_MAX_N + GHOST], long int rowlen, int step)
+{
+    for (int k = 0; k < 4; k++) {
+        for (long int p = 0; p < rowlen; p++) {
+            double x = (double)p / (rowlen - 1);
+            side[k][p] = MINVAL + (MAXVAL - MINVAL) * 0.5 *
+                         (1.0 + sin(2.0 * M_PI * (x + 0.25 * k) + DRIFT * step));
+        }
+    }
+}
+
+/* Cold and warm solves of the drifting sequence on an n-point grid, on
+   separate contexts */
+void drift_sequence(sor_ctx *warm_ctx, sor_ctx *cold_ctx, arr_ptr cold, data_t *cold_out,
+                    long int n)
+{
+    static data_t side[4][DRIFT_MAX_N + GHOST];
+    long int rowlen = n + GHOST;
+    long int cold_iters = 0, warm_iters = 0;
+    double cold_s = 0, warm_s = 0, diff = 0;
+    sor_request req;
+    sor_result res;
+
+    for (int step = 0; step < DRIFT_STEPS; step++) {
+        drift_boundary(side, rowlen, step);
+
+        /* Cold: what every driver does today, plus the boundary */
+        init_array_rand(cold, rowlen);
+        set_arr_rowlen(cold, rowlen);
+        memcpy(cold->data, side[0], rowlen * sizeof(data_t));
+        memcpy(cold->data + (rowlen - 1) * rowlen, side[1], rowlen * sizeof(data_t));
+        for (long int i = 0; i < rowlen; i++) {
+            cold->data[i * rowlen] = side[2][i];
+            cold->data[i * rowlen + rowlen - 1] = side[3][i];
+        }
+        memset(&req, 0, sizeof(req));
+        req.n = n;
+        req.init = cold->data;
+        req.out = cold_out;
+        sor_ctx_solve(cold_ctx, &req, &res);
+        cold_iters += res.iters;
+        cold_s += res.seconds;
+
+        /* Warm: the first step has nothing to start from */
+        if (step == 0) {
+            req.out = NULL;
+            sor_ctx_solve(warm_ctx, &req, &res);
+        } else {
+            sor_ctx_set_boundary(warm_ctx, n, side[0], side[1], side[2], side[3]);
+            memset(&req, 0, sizeof(req));
+            req.n = n;
+            req.warm = 1;
+            sor_ctx_solve(warm_ctx, &req, &res);
+        }
+        warm_iters += res.iters;
+        warm_s += res.seconds;
+    }
+    for (long int p = 0; p < rowlen * rowlen; p++)
+        diff = fmax(diff, fabs(cold_out[p] - sor_ctx_grid(warm_ctx)->data[p]));
+    printf("%ld, %d, %.1f, %.1f, %.2f, %.3g, %.3g, %.3g\n", rowlen, DRIFT_STEPS,
+           (double)cold_iters / DRIFT_STEPS, (double)warm_iters / DRIFT_STEPS,
+           (double)cold_iters / warm_iters, cold_s / DRIFT_STEPS, warm_s / DRIFT_STEPS, diff);
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[])
+{
+    bench_cfg cfg = bench_cfg_from_env();
+    bench_out csv, json;
+    bench_stats fresh_stats, ctx_stats;
+    long int sizes[NUM_SIZES] = {8, 16, 32, 64};
+    int thread_counts[] = {1, 4};
+    sor_ctx ctx;
+    ctx_case cc;
+    int fresh_iters, mismatches = 0;
+
+    printf("Warmup %d, repeats %d, TSC %.3f cycles/ns\n", cfg.warmup, cfg.repeats, bench_cpns());
+    cpu_dispatch_report(stdout);
+    bench_out_from_env(&csv, &json);
+
+    /* The smallest size has the largest batch */
+    cc.batch = (int)(WORK_POINTS / (sizes[0] * sizes[0])) / 50 + 1;
+    cc.sweeps = (int *)malloc((long int)cc.batch * (cfg.warmup + cfg.repeats) * sizeof(int));
+    cc.logged = 0;
+    if (!cc.sweeps) {
+        fprintf(stderr, "test_sor_ctx: could not allocate the sweep log\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Size, Threads, Fresh iters, Context iters, Fresh solves/s, Context solves/s, Speedup, "
+           "Heap growth bytes\n");
+    for (int t = 0; t < 2; t++) {
+        if (!sor_ctx_create(&ctx, sizes[NUM_SIZES - 1], thread_counts[t])) {
+            fprintf(stderr, "test_sor_ctx: could not create a context\n");
+            return EXIT_FAILURE;
+        }
+        for (int s = 0; s < NUM_SIZES; s++) {
+            struct mallinfo2 before, after;
+
+            cc.ctx = &ctx;
+            cc.n = sizes[s];
+            cc.num_threads = thread_counts[t];
+            cc.batch = (int)(WORK_POINTS / (cc.n * cc.n)) / 50 + 1;
+
+            bench_run(&cfg, NULL, ctx_case_fresh, &cc, &fresh_stats);
+            fresh_iters = ctx_case_median(&cc);
+            before = mallinfo2();
+            bench_run(&cfg, NULL, ctx_case_ctx, &cc, &ctx_stats);
+            after = mallinfo2();
+            cc.iters = ctx_case_median(&cc);
+            if (cc.num_threads == 1 ? cc.iters != fresh_iters
+                : fabs((double)cc.iters - fresh_iters) > THREAD_ITER_TOL * fresh_iters) {
+                printf("MISMATCH n=%ld t=%d: context median %d sweeps, %s %d\n", cc.n,
+                       cc.num_threads, cc.iters,
+                       cc.num_threads == 1 ? "SOR()" : "SOR_thread_strip()", fresh_iters);
+                mismatches++;
+            }
+            per_solve(&fresh_stats, cc.batch);
+            per_solve(&ctx_stats, cc.batch);
+            printf("%ld, %d, %d, %d, %.0f, %.0f, %.2f, %ld\n", cc.n + GHOST, cc.num_threads,
+                   fresh_iters, cc.iters, 1.0 / fresh_stats.median, 1.0 / ctx_stats.median,
+                   fresh_stats.median / ctx_stats.median,
+                   (long)(after.uordblks - before.uordblks));
+            bench_out_row(&csv, "SOR_fresh", cc.n + GHOST, cc.num_threads, OMEGA, fresh_iters, &fresh_stats);
+            bench_out_row(&json, "SOR_fresh", cc.n + GHOST, cc.num_threads, OMEGA, fresh_iters, &fresh_stats);
+            bench_out_row(&csv, "SOR_ctx", cc.n + GHOST, cc.num_threads, OMEGA, cc.iters, &ctx_stats);
+            bench_out_row(&json, "SOR_ctx", cc.n + GHOST, cc.num_threads, OMEGA, cc.iters, &ctx_stats);
+        }
+        printf("context totals: %ld solves, %ld sweeps, %.3f s\n",
+               ctx.stats.solves, ctx.stats.sweeps, ctx.stats.seconds);
+        sor_ctx_destroy(&ctx);
+    }
+
+    /* Warm vs. cold start over a drifting boundary */
+    long int drift_sizes[] = {30, 62, 126, DRIFT_MAX_N};
+    arr_ptr cold = new_array(DRIFT_MAX_N + GHOST);
+    data_t *cold_out = (data_t *)malloc((DRIFT_MAX_N + GHOST) * (DRIFT_MAX_N + GHOST) * sizeof(data_t));
+    sor_ctx cold_ctx;
+    if (!cold || !cold_out || !sor_ctx_create(&ctx, DRIFT_MAX_N, 1) ||
+        !sor_ctx_create(&cold_ctx, DRIFT_MAX_N, 1)) {
+        fprintf(stderr, "test_sor_ctx: could not allocate the drift sequence\n");
+        return EXIT_FAILURE;
+    }
+    printf("\nDrifting boundary, %.2f rad per step\n", DRIFT);
+    printf("Size, Steps, Cold iters/step, Warm iters/step, Ratio, Cold s/step, Warm s/step, "
+           "Max |cold - warm| at last step\n");
+    for (int s = 0; s < 4; s++) drift_sequence(&ctx, &cold_ctx, cold, cold_out, drift_sizes[s]);
+    sor_ctx_destroy(&ctx);
+    sor_ctx_destroy(&cold_ctx);
+    free_array(cold);
+    free(cold_out);
+    free(cc.sweeps);
+
+    bench_out_close(&csv);
+    bench_out_close(&json);
+    return mismatches ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,281 @@
+/* Per-thread event trace for the threaded kernels: where a sweep's time
+   goes between work, waiting for the slowest thread, and the barrier
+   itself.
+
+   Every thread owns a ring of TRACE_EVENTS records {CLOCK_MONOTONIC ns,
+   iteration, kind} in its own cache lines and is the only writer of it,
+   so recording is a clock read and a store, with no locks or atomics.
+   When the ring is full the oldest records are overwritten. The rings
+   are read only after the traced threads have been joined.
+
+   Tracing is off while TRACE is NULL; each TRACE_EVENT() is then one
+   untaken branch. The kernels record
+
+     TRACE_SWEEP_BEGIN / END         around a thread's share of a sweep
+     TRACE_BARRIER_ARRIVE / RELEASE  around SOR_reduce_change()'s
+                                     barriers (sor_mt.h), and from the
+                                     end of cb_work() to the join
+
+   An event with iteration < 0 belongs to the thread's last sweep begin.
+
+   trace_write_chrome() exports the rings as Chrome trace-event JSON
+   (chrome://tracing, Perfetto): one track per thread, "sweep" and
+   "barrier" slices. Threads with empty rings (fewer ran than the log
+   was opened for) are left out of both. trace_summary() reports per
+   iteration, over the iterations every thread has complete:
+
+     imbalance   1 - mean / max of the threads' sweep times: the share of
+                 the slowest thread's time the others spend idle
+     wait        share of thread time between barrier arrival and release
+     barrier     last arrival to first release, the barrier's own cost
+
+   Header-only; included by sor_mt.h and pt_cb.h.
+*/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_SWEEP_BEGIN 0
+#define TRACE_SWEEP_END 1
+#define TRACE_BARRIER_ARRIVE 2
+#define TRACE_BARRIER_RELEASE 3
+#define TRACE_KINDS 4
+#define TRACE_MAX_THREADS 256
+
+long int TRACE_EVENTS = 1L << 16;  /* records per thread ring */
+
+typedef struct {
+    uint64_t ns;
+    int32_t iter;
+    int32_t kind;
+} trace_rec;
+
+/* One thread's ring; aligned so no two threads share a line */
+typedef struct {
+    trace_rec *rec;
+    uint64_t count;                 /* records ever written */
+    int32_t iter;                   /* iteration of the last sweep begin */
+} __attribute__((aligned(64))) trace_ring;
+
+typedef struct {
+    int num_threads;
+    long int cap;
+    trace_ring *ring;
+} trace_log;
+
+trace_log *TRACE = NULL;
+
+#define TRACE_EVENT(tid, kind, iter) \
+    do { if (TRACE) trace_event(TRACE, (tid), (kind), (iter)); } while (0)
+
+int trace_open(trace_log *tl, int num_threads);
+void trace_reset(trace_log *tl);
+int trace_write_chrome(const trace_log *tl, const char *path);
+void trace_summary(const trace_log *tl, FILE *fp, FILE *per_iter);
+void trace_close(trace_log *tl);
+
+static inline void trace_event(trace_log *tl, int tid, int kind, int iter)
+{
+    struct timespec t;
+    trace_ring *r;
+    trace_rec *e;
+
+    if (tid < 0 || tid >= tl->num_threads) return;
+    r = &tl->ring[tid];
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    if (kind == TRACE_SWEEP_BEGIN) r->iter = iter;
+    e = &r->rec[r->count % tl->cap];
+    e->ns = (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+    e->iter = iter < 0 ? r->iter : iter;
+    e->kind = kind;
+    r->count++;
+}
+
+/* Rings for threads 0..num_threads-1 of TRACE_EVENTS records; 0 on failure */
+int trace_open(trace_log *tl, int num_threads)
+{
+    memset(tl, 0, sizeof(*tl));
+    if (num_threads < 1 || num_threads > TRACE_MAX_THREADS || TRACE_EVENTS < TRACE_KINDS) return 0;
+    tl->num_threads = num_threads;
+    tl->cap = TRACE_EVENTS;
+    if (posix_memalign((void **)&tl->ring, 64, num_threads * sizeof(trace_ring))) return 0;
+    memset(tl->ring, 0, num_threads * sizeof(trace_ring));
+    for (int t = 0; t < num_threads; t++) {
+        if (!(tl->ring[t].rec = (trace_rec *)malloc(tl->cap * sizeof(trace_rec)))) {
+            trace_close(tl);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Forget everything recorded so far */
+void trace_reset(trace_log *tl)
+{
+    for (int t = 0; t < tl->num_threads; t++) {
+        tl->ring[t].count = 0;
+        tl->ring[t].iter = 0;
+    }
+}
+
+/* Index of thread t's oldest retained record, and how many there are */
+static void trace_span(const trace_log *tl, int t, uint64_t *first, uint64_t *n)
+{
+    uint64_t count = tl->ring[t].count;
+
+    *n = count < (uint64_t)tl->cap ? count : (uint64_t)tl->cap;
+    *first = count - *n;
+}
+
+static uint64_t trace_t0(const trace_log *tl)
+{
+    uint64_t t0 = UINT64_MAX, first, n;
+
+    for (int t = 0; t < tl->num_threads; t++) {
+        trace_span(tl, t, &first, &n);
+        if (n && tl->ring[t].rec[first % tl->cap].ns < t0) t0 = tl->ring[t].rec[first % tl->cap].ns;
+    }
+    return t0;
+}
+
+/* Chrome trace-event JSON of every ring; 0 on an I/O error. Records
+   before a thread's first sweep begin are dropped so slices nest. */
+int trace_write_chrome(const trace_log *tl, const char *path)
+{
+    static const char *slice[TRACE_KINDS] = {"sweep", "sweep", "barrier", "barrier"};
+    uint64_t t0 = trace_t0(tl), first, n;
+    int sep = 0;
+    FILE *fp;
+
+    if (!(fp = fopen(path, "w"))) return 0;
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for (int t = 0; t < tl->num_threads; t++) {
+        int open = 0;
+
+        trace_span(tl, t, &first, &n);
+        if (!n) continue;
+        fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"thread %d\"}}", sep ? ",\n" : "", t, t);
+        sep = 1;
+        for (uint64_t k = first; k < first + n; k++) {
+            const trace_rec *e = &tl->ring[t].rec[k % tl->cap];
+            int begin = e->kind == TRACE_SWEEP_BEGIN || e->kind == TRACE_BARRIER_ARRIVE;
+
+            if (!open && e->kind != TRACE_SWEEP_BEGIN) continue;
+            open = 1;
+            fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": 1, \"tid\": %d, "
+                    "\"ts\": %.3f, \"args\": {\"iter\": %d}}", slice[e->kind], begin ? 'B' : 'E',
+                    t, (e->ns - t0) * 1.0e-3, e->iter);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    return fclose(fp) == 0;
+}
+
+static int trace_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Imbalance, wait share and barrier cost over the iterations every
+   thread has all four events for; one line to fp, and one row per
+   iteration to per_iter if it is not NULL */
+void trace_summary(const trace_log *tl, FILE *fp, FILE *per_iter)
+{
+    int nt = 0, lo = INT32_MIN, hi = INT32_MAX, used = 0;
+    uint64_t first, n, *ts;
+    double *imb, sum_imb = 0, work = 0, wait = 0, barrier = 0;
+
+    /* Threads that ran are a prefix; iterations retained by all of them */
+    for (int t = 0; t < tl->num_threads; t++) {
+        trace_span(tl, t, &first, &n);
+        if (!n) break;
+        nt++;
+        int a = tl->ring[t].rec[first % tl->cap].iter, b = tl->ring[t].rec[(first + n - 1) % tl->cap].iter;
+        if (a > lo) lo = a;
+        if (b < hi) hi = b;
+    }
+    if (!nt || hi < lo) {
+        fprintf(fp, "  trace: no iteration common to all threads\n");
+        return;
+    }
+    /* ts[(iter - lo) * nt * 4 + t * 4 + kind]: first begin / arrive, last end / release */
+    ts = (uint64_t *)calloc((size_t)(hi - lo + 1) * nt * TRACE_KINDS, sizeof(uint64_t));
+    imb = (double *)malloc((hi - lo + 1) * sizeof(double));
+    if (!ts || !imb) {
+        fprintf(stderr, "trace_summary: could not allocate %d iterations\n", hi - lo + 1);
+        exit(-1);
+    }
+    for (int t = 0; t < nt; t++) {
+        trace_span(tl, t, &first, &n);
+        for (uint64_t k = first; k < first + n; k++) {
+            const trace_rec *e = &tl->ring[t].rec[k % tl->cap];
+            if (e->iter < lo || e->iter > hi) continue;
+            uint64_t *slot = &ts[((size_t)(e->iter - lo) * nt + t) * TRACE_KINDS + e->kind];
+            if (!*slot || e->kind == TRACE_SWEEP_END || e->kind == TRACE_BARRIER_RELEASE) *slot = e->ns;
+        }
+    }
+
+    if (per_iter) fprintf(per_iter, "iter,imbalance,wait,barrier_us\n");
+    for (int it = lo; it <= hi; it++) {
+        uint64_t *row = &ts[(size_t)(it - lo) * nt * TRACE_KINDS];
+        uint64_t last_arrive = 0, first_release = UINT64_MAX;
+        double max_w = 0, sum_w = 0, sum_span = 0, sum_wait = 0;
+        int complete = 1;
+
+        for (int t = 0; t < nt && complete; t++) {
+            uint64_t *e = &row[t * TRACE_KINDS];
+            if (!e[0] || !e[1] || !e[2] || !e[3] || e[1] < e[0] || e[3] < e[2]) complete = 0;
+        }
+        if (!complete) continue;
+        for (int t = 0; t < nt; t++) {
+            uint64_t *e = &row[t * TRACE_KINDS];
+            double w = (double)(e[TRACE_SWEEP_END] - e[TRACE_SWEEP_BEGIN]);
+            sum_w += w;
+            if (w > max_w) max_w = w;
+            sum_wait += (double)(e[TRACE_BARRIER_RELEASE] - e[TRACE_BARRIER_ARRIVE]);
+            sum_span += (double)(e[TRACE_BARRIER_RELEASE] - e[TRACE_SWEEP_BEGIN]);
+            if (e[TRACE_BARRIER_ARRIVE] > last_arrive) last_arrive = e[TRACE_BARRIER_ARRIVE];
+            if (e[TRACE_BARRIER_RELEASE] < first_release) first_release = e[TRACE_BARRIER_RELEASE];
+        }
+        double b = first_release > last_arrive ? (double)(first_release - last_arrive) : 0.0;
+        imb[used] = max_w > 0 ? 1.0 - sum_w / nt / max_w : 0.0;
+        sum_imb += imb[used];
+        work += sum_span;
+        wait += sum_wait;
+        barrier += b;
+        if (per_iter) fprintf(per_iter, "%d,%.4f,%.4f,%.3f\n", it, imb[used],
+                              sum_span > 0 ? sum_wait / sum_span : 0.0, b * 1.0e-3);
+        used++;
+    }
+    if (used) {
+        qsort(imb, used, sizeof(double), trace_cmp_double);
+        fprintf(fp, "  trace: %d threads, %d iterations; imbalance mean %.1f%%, median %.1f%%, "
+                "p95 %.1f%%, max %.1f%%; barrier wait %.1f%% of thread time, barrier %.2f us/iter\n",
+                nt, used, 100.0 * sum_imb / used, 100.0 * imb[used / 2],
+                100.0 * imb[(int)(0.95 * (used - 1))], 100.0 * imb[used - 1],
+                work > 0 ? 100.0 * wait / work : 0.0, barrier / used * 1.0e-3);
+    } else {
+        fprintf(fp, "  trace: no complete iteration\n");
+    }
+    free(ts);
+    free(imb);
+}
+
+void trace_close(trace_log *tl)
+{
+    if (tl->ring) {
+        for (int t = 0; t < tl->num_threads; t++) free(tl->ring[t].rec);
+        free(tl->ring);
+    }
+    tl->ring = NULL;
+}
+
+#endif /* _TRACE_H_ */